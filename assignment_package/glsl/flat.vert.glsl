@@ -4,7 +4,16 @@
 // Refer to the lambert shader files for useful comments
 
 uniform mat4 u_Model;
-uniform mat4 u_ViewProj;
+
+// Shared by every program and filled once per frame by FrameUniforms.
+// Must read the same in every shader that declares it.
+layout(std140) uniform PerFrame {
+    mat4 u_ViewProj;        // The matrix that defines the camera's transformation.
+    vec4 u_CameraPos;
+    vec4 u_LightDir;        // The direction of our virtual light, which is used to compute the shading of
+                            // the geometry in the fragment shader.
+    int u_Time;
+};
 
 in vec4 vs_Pos;
 in vec4 vs_Col;
@@ -7,33 +7,39 @@
 //This simultaneous transformation allows your program to run much faster, especially when rendering
 //geometry with millions of vertices.
 
-uniform mat4 u_ViewProj;    // The matrix that defines the camera's transformation.
-                            // We've written a static matrix for you to use for HW2,
-                            // but in HW3 you'll have to generate one yourself
+// Shared by every program and filled once per frame by FrameUniforms.
+// Must read the same in every shader that declares it.
+layout(std140) uniform PerFrame {
+    mat4 u_ViewProj;        // The matrix that defines the camera's transformation.
+    vec4 u_CameraPos;
+    vec4 u_LightDir;        // The direction of our virtual light, which is used to compute the shading of
+                            // the geometry in the fragment shader.
+    int u_Time;
+};
 
 in vec4 vs_Pos;             // The array of vertex positions passed to the shader
 in vec4 vs_Nor;             // The array of vertex normals passed to the shader
 
 in vec3 vs_ColInstanced;    // The array of vertex colors passed to the shader.
 in vec3 vs_OffsetInstanced; // Used to position each instance of the cube
+in vec3 vs_ScaleInstanced;  // Size of each instance along each axis
 
 out vec4 fs_Pos;
 out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
 out vec4 fs_LightVec;       // The direction in which our virtual light lies, relative to each vertex. This is implicitly passed to the fragment shader.
 out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
 
-const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));  // The direction of our virtual light, which is used to compute the shading of
-                                        // the geometry in the fragment shader.
-
 void main()
 {
-    vec4 offsetPos = vs_Pos + vec4(vs_OffsetInstanced, 0.);
+    vec4 offsetPos = vec4(vs_Pos.xyz * vs_ScaleInstanced + vs_OffsetInstanced, 1.);
     fs_Pos = offsetPos;
-    fs_Col = vec4(vs_ColInstanced, 1.);                         // Pass the vertex colors to the fragment shader for interpolation
+    // Shade here so the flat fragment shader can be used
+    float diffuse = clamp(dot(normalize(vs_Nor), u_LightDir), 0, 1);
+    fs_Col = vec4(vs_ColInstanced * (0.4 + 0.6 * diffuse), 1.);
 
     fs_Nor = vs_Nor;
 
-    fs_LightVec = (lightDir);  // Compute the direction in which the light source lies
+    fs_LightVec = u_LightDir;  // Compute the direction in which the light source lies
 
     gl_Position = u_ViewProj * offsetPos;// gl_Position is a built-in variable of OpenGL which is
                                              // used to render the final positions of the geometry's vertices
@@ -11,9 +11,17 @@
 // can compute what color to apply to its pixel based on things like vertex
 // position, light position, and vertex color.
 
-uniform int u_Time;
-
-uniform sampler2D u_Texture;
+// Shared by every program and filled once per frame by FrameUniforms.
+// Must read the same in every shader that declares it.
+layout(std140) uniform PerFrame {
+    mat4 u_ViewProj;        // The matrix that defines the camera's transformation.
+    vec4 u_CameraPos;
+    vec4 u_LightDir;        // The direction of our virtual light, which is used to compute the shading of
+                            // the geometry in the fragment shader.
+    int u_Time;
+};
+
+uniform sampler2DArray u_Texture;
 
 uniform vec4 u_Color; // The color with which to render this instance of geometry.
 
@@ -24,6 +32,9 @@ in vec4 fs_Nor;
 in vec4 fs_LightVec;
 in vec4 fs_Col;
 in vec2 fs_UV;
+flat in float fs_Layer;
+in vec2 fs_Light;
+in float fs_AO;
 
 layout(location = 0) out vec4 out_Col; // This is the final output color that you will see on your
                   // screen for the pixel that is currently being processed.
@@ -75,20 +86,20 @@ float fbm(vec3 p) {
 
 void main()
 {
-        // Apply timeshift if UV corresponds to water and lava UV
+        // Apply timeshift if the layer is one of the water and lava tiles
         vec2 alteredUV = fs_UV;
-        float uvUnit = 1 / 16.f;
+        int layer = int(fs_Layer);
         int divFactor = 5;
         int timeStep = u_Time % divFactor;
 
-        // Apply uv transformation
-        if ((alteredUV.x >= 13*uvUnit && alteredUV.y >= 1*uvUnit) &&
-            (alteredUV.x >= 13*uvUnit && alteredUV.y <= 5*uvUnit)) {
-            alteredUV.x += timeStep * (uvUnit / divFactor);
+        // Apply uv transformation. The texture repeats, so this scrolls
+        // within the tile.
+        if (layer % 16 >= 13 && layer / 16 >= 1 && layer / 16 <= 4) {
+            alteredUV.x += timeStep / float(divFactor);
         }
 
         // Material base color (before shading)
-        vec4 diffuseColor = texture(u_Texture, alteredUV);
+        vec4 diffuseColor = texture(u_Texture, vec3(alteredUV, fs_Layer));
         //diffuseColor = diffuseColor * (0.5 * fbm(fs_Pos.xyz) + 0.5);
 
         // Calculate the diffuse term for Lambert shading
@@ -98,10 +109,21 @@ void main()
 
         float ambientTerm = 0.2;
 
-        float lightIntensity = diffuseTerm + ambientTerm;   //Add a small float value to the color multiplier
+        // Only faces that can see the sky get the sun's diffuse light
+        float skyLight = fs_Light.x;
+        float blockLight = fs_Light.y;
+        float lightIntensity = diffuseTerm * skyLight + ambientTerm;   //Add a small float value to the color multiplier
                                                             //to simulate ambient lighting. This ensures that faces that are not
                                                             //lit by our point light are not completely black.
 
+        // Each level of voxel light is a bit dimmer than the one above it,
+        // with a little left over so caves are not pitch black
+        float voxelLight = max(skyLight, blockLight);
+        lightIntensity *= mix(0.05, 1.0, pow(0.8, 15.0 * (1.0 - voxelLight)));
+
+        // Darken corners tucked against other blocks
+        lightIntensity *= mix(0.45, 1.0, fs_AO);
+
         // Compute final shaded color
         out_Col = vec4(diffuseColor.rgb * lightIntensity, diffuseColor.a);
 }
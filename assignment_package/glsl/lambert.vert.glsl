@@ -16,9 +16,15 @@ uniform mat4 u_ModelInvTr;  // The inverse transpose of the model matrix.
                             // This allows us to transform the object's normals properly
                             // if the object has been non-uniformly scaled.
 
-uniform mat4 u_ViewProj;    // The matrix that defines the camera's transformation.
-                            // We've written a static matrix for you to use for HW2,
-                            // but in HW3 you'll have to generate one yourself
+// Shared by every program and filled once per frame by FrameUniforms.
+// Must read the same in every shader that declares it.
+layout(std140) uniform PerFrame {
+    mat4 u_ViewProj;        // The matrix that defines the camera's transformation.
+    vec4 u_CameraPos;
+    vec4 u_LightDir;        // The direction of our virtual light, which is used to compute the shading of
+                            // the geometry in the fragment shader.
+    int u_Time;
+};
 
 uniform vec4 u_Color;       // When drawing the cube instance, we'll set our uniform color to represent different block types.
 
@@ -28,20 +34,25 @@ in vec4 vs_Nor;             // The array of vertex normals passed to the shader
 
 in vec4 vs_Col;             // The array of vertex colors passed to the shader.
 
-in vec2 vs_UV;
+in vec4 vs_UV;              // xy is the texture coordinate within the tile, z the tile's
+                            // layer in the texture array, and w the light of the block
+                            // this face looks into, packed as sky * 16 + block
 
 out vec4 fs_Pos;
 out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
 out vec4 fs_LightVec;       // The direction in which our virtual light lies, relative to each vertex. This is implicitly passed to the fragment shader.
 out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
 out vec2 fs_UV;
-
-const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));  // The direction of our virtual light, which is used to compute the shading of
-                                        // the geometry in the fragment shader.
+flat out float fs_Layer;
+out vec2 fs_Light;
+out float fs_AO;            // Ambient occlusion baked into the normal's w by the mesher
 
 void main()
 {
-    fs_UV = vs_UV;
+    fs_UV = vs_UV.xy;
+    fs_Layer = vs_UV.z;
+    fs_Light = vec2(floor(vs_UV.w / 16.0), mod(vs_UV.w, 16.0)) / 15.0;
+    fs_AO = vs_Nor.w;
     fs_Pos = vs_Pos;
     fs_Col = vs_Col;//u_Color;                         // Pass the vertex colors to the fragment shader for interpolation
 
@@ -55,7 +66,7 @@ void main()
 
     vec4 modelposition = u_Model * vs_Pos;   // Temporarily store the transformed vertex positions for use below
 
-    fs_LightVec = (lightDir);  // Compute the direction in which the light source lies
+    fs_LightVec = u_LightDir;  // Compute the direction in which the light source lies
 
     gl_Position = u_ViewProj * modelposition;// gl_Position is a built-in variable of OpenGL which is
                                              // used to render the final positions of the geometry's vertices
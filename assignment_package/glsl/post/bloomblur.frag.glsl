@@ -0,0 +1,25 @@
+#version 150
+// Blurs its input along one axis with a 9-tap Gaussian. Run once
+// across and once down, at quarter resolution, to spread bloom cheaply.
+
+uniform sampler2D u_RenderedTexture;
+uniform vec4 u_Params; // xy is the axis to blur along
+
+in vec2 fs_UV;
+
+out vec4 color;
+
+void main()
+{
+    // Four taps each side, each read between two texels, so linear
+    // filtering blends those two with the right weights
+    const float offsets[2] = float[](1.3846153846, 3.2307692308);
+    const float weights[2] = float[](0.3162162162, 0.0702702703);
+    vec2 texel = u_Params.xy / vec2(textureSize(u_RenderedTexture, 0));
+    vec3 sum = texture(u_RenderedTexture, fs_UV).rgb * 0.2270270270;
+    for (int i = 0; i < 2; i++) {
+        sum += texture(u_RenderedTexture, fs_UV + offsets[i] * texel).rgb * weights[i];
+        sum += texture(u_RenderedTexture, fs_UV - offsets[i] * texel).rgb * weights[i];
+    }
+    color = vec4(sum, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 150
+// First step of bloom, drawn at half resolution: keeps only the parts
+// of the image brighter than a threshold. Sampling halfway between four
+// texels with linear filtering averages them in one read.
+
+uniform sampler2D u_RenderedTexture;
+uniform vec4 u_Params; // x is the brightness threshold
+
+in vec2 fs_UV;
+
+out vec4 color;
+
+void main()
+{
+    vec3 c = texture(u_RenderedTexture, fs_UV).rgb;
+    float luma = dot(c, vec3(0.2126, 0.7152, 0.0722));
+    float keep = max(luma - u_Params.x, 0.0) / max(luma, 0.0001);
+    color = vec4(c * keep, 1.0);
+}
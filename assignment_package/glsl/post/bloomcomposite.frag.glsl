@@ -0,0 +1,17 @@
+#version 150
+// Last step of bloom: adds the blurred highlights back over the image
+
+uniform sampler2D u_RenderedTexture;
+uniform sampler2D u_Input1; // The blurred highlights, at lower resolution
+uniform vec4 u_Params; // x is how strongly they are added
+
+in vec2 fs_UV;
+
+out vec4 color;
+
+void main()
+{
+    vec3 scene = texture(u_RenderedTexture, fs_UV).rgb;
+    vec3 bloom = texture(u_Input1, fs_UV).rgb;
+    color = vec4(scene + bloom * u_Params.x, 1.0);
+}
@@ -0,0 +1,62 @@
+#version 150
+// Fast approximate antialiasing. Finds edges from the contrast in
+// brightness around each pixel, works out which way each edge runs from
+// the brightness of the corners, and blends along it. A blend that
+// would reach past the local range of brightness has crossed another
+// edge, so the shorter one is used instead.
+
+uniform sampler2D u_RenderedTexture;
+
+in vec2 fs_UV;
+
+out vec4 color;
+
+// Contrast below which a pixel is left alone, relative to its brightest
+// neighbour and absolute, so dark areas are not blurred for their noise
+const float EDGE_THRESHOLD = 1.0 / 8.0;
+const float EDGE_THRESHOLD_MIN = 1.0 / 24.0;
+// Keep the blend direction from blowing up along near-flat gradients
+const float REDUCE_MUL = 1.0 / 8.0;
+const float REDUCE_MIN = 1.0 / 128.0;
+// Farthest along an edge a pixel may blend, in pixels
+const float SPAN_MAX = 8.0;
+
+float luma(vec3 c) {
+    return dot(c, vec3(0.299, 0.587, 0.114));
+}
+
+vec3 sampleAt(vec2 uv) {
+    return texture(u_RenderedTexture, uv).rgb;
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(u_RenderedTexture, 0));
+    vec3 rgbM = sampleAt(fs_UV);
+    float lumaM = luma(rgbM);
+    float lumaNW = luma(sampleAt(fs_UV + vec2(-1.0, 1.0) * texel));
+    float lumaNE = luma(sampleAt(fs_UV + vec2(1.0, 1.0) * texel));
+    float lumaSW = luma(sampleAt(fs_UV + vec2(-1.0, -1.0) * texel));
+    float lumaSE = luma(sampleAt(fs_UV + vec2(1.0, -1.0) * texel));
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD)) {
+        color = vec4(rgbM, 1.0);
+        return;
+    }
+
+    // Across the brightness gradient, i.e. along the edge. UVs are
+    // y-up here, so N is +y and the gradient is (E - W, N - S).
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)),
+                    (lumaNE + lumaSE) - (lumaNW + lumaSW));
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * texel;
+
+    vec3 rgbA = 0.5 * (sampleAt(fs_UV + dir * (1.0 / 3.0 - 0.5))
+                       + sampleAt(fs_UV + dir * (2.0 / 3.0 - 0.5)));
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (sampleAt(fs_UV - dir * 0.5) + sampleAt(fs_UV + dir * 0.5));
+    float lumaB = luma(rgbB);
+    color = vec4((lumaB < lumaMin || lumaB > lumaMax) ? rgbA : rgbB, 1.0);
+}
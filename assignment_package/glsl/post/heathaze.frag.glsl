@@ -0,0 +1,30 @@
+#version 330
+// Drawn while the camera is inside LAVA: the scene shimmers as if
+// through rising heat, and glows orange.
+
+// Shared by every program and filled once per frame by FrameUniforms.
+// Must read the same in every shader that declares it.
+layout(std140) uniform PerFrame {
+    mat4 u_ViewProj;
+    vec4 u_CameraPos;
+    vec4 u_LightDir;
+    int u_Time;
+};
+
+uniform sampler2D u_RenderedTexture;
+uniform vec4 u_Params; // rgb is the glow color, a how much of it shows
+
+in vec2 fs_UV;
+
+out vec4 color;
+
+void main()
+{
+    float t = u_Time * 0.15;
+    // Waves that travel up the screen, stronger toward the bottom
+    vec2 offset = vec2(sin(fs_UV.y * 60.0 - t) + 0.5 * sin(fs_UV.y * 23.0 - 1.7 * t),
+                       cos(fs_UV.x * 45.0 + 0.6 * t));
+    offset *= 0.006 * (1.3 - fs_UV.y);
+    vec3 scene = texture(u_RenderedTexture, clamp(fs_UV + offset, 0.0, 1.0)).rgb;
+    color = vec4(mix(scene, u_Params.rgb, u_Params.a), 1.0);
+}
@@ -5,7 +5,11 @@
 
 in vec4 vs_Pos;
 
+out vec2 fs_UV;
+
 void main()
 {
+    // The quad covers the screen, so its position is also where it reads
+    fs_UV = vs_Pos.xy * 0.5 + 0.5;
     gl_Position = vs_Pos;
 }
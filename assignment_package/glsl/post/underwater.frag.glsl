@@ -0,0 +1,29 @@
+#version 330
+// Drawn while the camera is inside WATER: the scene ripples slightly
+// and fades toward the color of deep water.
+
+// Shared by every program and filled once per frame by FrameUniforms.
+// Must read the same in every shader that declares it.
+layout(std140) uniform PerFrame {
+    mat4 u_ViewProj;
+    vec4 u_CameraPos;
+    vec4 u_LightDir;
+    int u_Time;
+};
+
+uniform sampler2D u_RenderedTexture;
+uniform vec4 u_Params; // rgb is the water color, a how much of it shows
+
+in vec2 fs_UV;
+
+out vec4 color;
+
+void main()
+{
+    float t = u_Time * 0.05;
+    vec2 uv = fs_UV + 0.003 * vec2(sin(fs_UV.y * 40.0 + t), cos(fs_UV.x * 30.0 + t));
+    vec3 scene = texture(u_RenderedTexture, clamp(uv, 0.0, 1.0)).rgb;
+    // Deeper toward the edges of the view
+    float dist = length(fs_UV - 0.5);
+    color = vec4(mix(scene, u_Params.rgb, u_Params.a + 0.3 * dist), 1.0);
+}
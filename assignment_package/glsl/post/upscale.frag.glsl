@@ -0,0 +1,31 @@
+#version 150
+// Stretches a scene drawn at lower resolution over the whole screen and
+// sharpens it back up. Sharpening pushes each pixel away from its four
+// neighbours, clamped to their range so edges do not ring.
+
+uniform sampler2D u_RenderedTexture;
+uniform vec4 u_Params; // x is the sharpening strength, zw the part of the texture the scene covers
+
+in vec2 fs_UV;
+
+out vec4 color;
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(u_RenderedTexture, 0));
+    // Never read past the drawn part into what is left from older frames
+    vec2 lo = 0.5 * texel;
+    vec2 hi = u_Params.zw - 0.5 * texel;
+    vec2 uv = fs_UV * u_Params.zw;
+
+    vec3 c = texture(u_RenderedTexture, clamp(uv, lo, hi)).rgb;
+    vec3 n = texture(u_RenderedTexture, clamp(uv + vec2(0.0, texel.y), lo, hi)).rgb;
+    vec3 s = texture(u_RenderedTexture, clamp(uv - vec2(0.0, texel.y), lo, hi)).rgb;
+    vec3 e = texture(u_RenderedTexture, clamp(uv + vec2(texel.x, 0.0), lo, hi)).rgb;
+    vec3 w = texture(u_RenderedTexture, clamp(uv - vec2(texel.x, 0.0), lo, hi)).rgb;
+
+    vec3 lowest = min(c, min(min(n, s), min(e, w)));
+    vec3 highest = max(c, max(max(n, s), max(e, w)));
+    vec3 sharpened = c + u_Params.x * (4.0 * c - n - s - e - w);
+    color = vec4(clamp(sharpened, lowest, highest), 1.0);
+}
@@ -1,3 +1,7 @@
+# openglwidgets, and Qt::SkipEmptyParts in the capture path reader,
+# need Qt 6
+lessThan(QT_MAJOR_VERSION, 6): error("MiniMinecraft requires Qt 6 or later")
+
 QT += core widgets openglwidgets
 
 TARGET = MiniMinecraft
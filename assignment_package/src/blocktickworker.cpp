@@ -0,0 +1,60 @@
+#include "blocktickworker.h"
+#include "scene/terrain.h"
+#include <QElapsedTimer>
+
+// Random tick numbers start here so they never repeat a scheduled update's
+static const uint32_t RANDOM_TICK_OFFSET = 1u << 16;
+
+BlockTickWorker::BlockTickWorker(BlockTickScheduler *s, uint64_t t,
+                                 vector<BlockTickJob> &&j, float budget)
+    : scheduler(s), tick(t), jobs(std::move(j)), budgetMs(budget)
+{
+}
+
+void BlockTickWorker::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+    qint64 budgetNs = static_cast<qint64>(budgetMs * 1e6f);
+
+    map<int64_t, vector<BlockChange>> results;
+    vector<BlockTickJob> unfinished;
+    for (BlockTickJob &job : jobs) {
+        Chunk *c = job.chunk;
+        vector<BlockChange> &changes = results[toKey(c->m_coords.x, c->m_coords.y)];
+        BlockChange change;
+
+        size_t done = 0;
+        for (; done < job.due.size() && timer.nsecsElapsed() < budgetNs; done++) {
+            const ScheduledUpdate &u = job.due[done];
+            uint32_t r = BlockTickScheduler::tickRandom(c, tick, static_cast<uint32_t>(done));
+            if (BlockTickScheduler::tickBlock(c, u.x, u.y, u.z, r, &change)) {
+                changes.push_back(change);
+            }
+        }
+        if (done < job.due.size()) {
+            // Out of time: scheduled updates wait for the next tick,
+            // random ticks are simply skipped
+            unfinished.push_back(BlockTickJob{c, vector<ScheduledUpdate>(job.due.begin() + done, job.due.end())});
+            continue;
+        }
+        if (timer.nsecsElapsed() >= budgetNs) {
+            continue;
+        }
+
+        uint32_t n = RANDOM_TICK_OFFSET;
+        for (int section = 0; section < 16; section++) {
+            if (c->getRandomTickBlockCount(section) == 0) {
+                continue;
+            }
+            for (int i = 0; i < BlockTickScheduler::RANDOM_TICKS_PER_SECTION; i++) {
+                uint32_t r = BlockTickScheduler::tickRandom(c, tick, n++);
+                int x = r & 15, z = (r >> 4) & 15, y = section * 16 + ((r >> 8) & 15);
+                if (BlockTickScheduler::tickBlock(c, x, y, z, r >> 12, &change)) {
+                    changes.push_back(change);
+                }
+            }
+        }
+    }
+    scheduler->reportResults(results, unfinished);
+}
@@ -0,0 +1,20 @@
+#ifndef BLOCKTICKWORKER_H
+#define BLOCKTICKWORKER_H
+
+#include <QRunnable>
+#include "scene/blocktickscheduler.h"
+using namespace std;
+
+// Runs one tick of the BlockTickScheduler for a batch of Chunks
+class BlockTickWorker : public QRunnable
+{
+protected:
+    BlockTickScheduler* scheduler;
+    uint64_t tick;
+    vector<BlockTickJob> jobs;
+    float budgetMs;
+public:
+    BlockTickWorker(BlockTickScheduler* s, uint64_t t, vector<BlockTickJob> &&j, float budget);
+    void run() override;
+};
+#endif // BLOCKTICKWORKER_H
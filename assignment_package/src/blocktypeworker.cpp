@@ -1,22 +1,41 @@
 #include "blocktypeworker.h"
+#include "scene/lightengine.h"
+#include <algorithm>
 
-BlockTypeWorker::BlockTypeWorker(int x, int y, vector<Chunk *> chunks,
+BlockTypeWorker::BlockTypeWorker(int64_t zone, Chunk *chunk,
                                  vector<Chunk*> *chunksThatHaveBlockData,
-                                 QMutex *chunksThatHaveBlockDataLock)
-    : PosX(x), PosY(y), chunks(chunks),
+                                 QMutex *chunksThatHaveBlockDataLock,
+                                 unordered_map<int64_t, PendingZoneWorkers> *pendingZoneWorkers,
+                                 QMutex *pendingZoneWorkersLock)
+    : zone(zone), chunk(chunk),
       chunksThatHaveBlockData(chunksThatHaveBlockData),
-      chunksThatHaveBlockDataLock(chunksThatHaveBlockDataLock)
+      chunksThatHaveBlockDataLock(chunksThatHaveBlockDataLock),
+      pendingZoneWorkers(pendingZoneWorkers),
+      pendingZoneWorkersLock(pendingZoneWorkersLock)
 {
 }
 
+Chunk* BlockTypeWorker::getChunk() const {
+    return chunk;
+}
+
 void BlockTypeWorker::run()
 {
-    for (auto &chunk : chunks)
-    {
-//        chunk->generateTestTerrain(PosX, PosY);
-        chunk->generateChunk(PosX, PosY);
-        chunksThatHaveBlockDataLock->lock();
-        chunksThatHaveBlockData->push_back(chunk);
-        chunksThatHaveBlockDataLock->unlock();
+    pendingZoneWorkersLock->lock();
+    auto pending = pendingZoneWorkers->find(zone);
+    if (pending != pendingZoneWorkers->end()) {
+        vector<BlockTypeWorker*> &workers = pending->second.workers;
+        workers.erase(std::remove(workers.begin(), workers.end(), this), workers.end());
+        if (workers.empty()) {
+            pendingZoneWorkers->erase(pending);
+        }
     }
+    pendingZoneWorkersLock->unlock();
+
+//    chunk->generateTestTerrain(chunk->m_coords.x, chunk->m_coords.y);
+    chunk->generateChunk();
+    LightEngine::lightChunk(chunk);
+    chunksThatHaveBlockDataLock->lock();
+    chunksThatHaveBlockData->push_back(chunk);
+    chunksThatHaveBlockDataLock->unlock();
 }
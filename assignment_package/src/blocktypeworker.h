@@ -3,21 +3,43 @@
 
 #include <QRunnable>
 #include <QMutex>
+#include <unordered_map>
+#include <vector>
+
+class BlockTypeWorker;
+
+// The BlockTypeWorkers of one zone that are still sitting in the thread
+// pool's queue. Terrain uses these to re-prioritize or cancel them.
+// Declared ahead of terrain.h since Terrain stores these by value.
+struct PendingZoneWorkers {
+    std::vector<BlockTypeWorker*> workers;
+    int priority;
+};
+
 #include "scene/terrain.h"
 using namespace std;
 
+// Fills in the blocks of a single Chunk. Each zone is split into one
+// worker per Chunk so that all of a zone's Chunks generate in parallel.
 class BlockTypeWorker : public QRunnable
 {
 protected:
-    int PosX, PosY;
-    vector<Chunk *> chunks;
+    int64_t zone;
+    Chunk *chunk;
     vector<Chunk *> *chunksThatHaveBlockData;
     QMutex *chunksThatHaveBlockDataLock;
+    // Once run() starts, the worker removes itself from this map
+    // so Terrain no longer tries to take it back out of the queue
+    unordered_map<int64_t, PendingZoneWorkers> *pendingZoneWorkers;
+    QMutex *pendingZoneWorkersLock;
 
 public:
-    BlockTypeWorker(int x, int y, vector<Chunk *> chunks,
+    BlockTypeWorker(int64_t zone, Chunk *chunk,
                     vector<Chunk *> *chunksThatHaveBlockData,
-                    QMutex *chunksThatHaveBlockDataLock);
+                    QMutex *chunksThatHaveBlockDataLock,
+                    unordered_map<int64_t, PendingZoneWorkers> *pendingZoneWorkers,
+                    QMutex *pendingZoneWorkersLock);
+    Chunk* getChunk() const;
     void run() override;
 };
 
@@ -15,15 +15,15 @@ Drawable::~Drawable()
 
 void Drawable::destroyVBOdata()
 {
-    mp_context->glDeleteBuffers(1, &m_bufIdx);
-    mp_context->glDeleteBuffers(1, &m_bufPos);
-    mp_context->glDeleteBuffers(1, &m_bufNor);
-    mp_context->glDeleteBuffers(1, &m_bufUV);
-    mp_context->glDeleteBuffers(1, &m_bufIdx_sec);
-    mp_context->glDeleteBuffers(1, &m_bufPos_sec);
-    mp_context->glDeleteBuffers(1, &m_bufNor_sec);
-    mp_context->glDeleteBuffers(1, &m_bufUV_sec);
-    mp_context->glDeleteBuffers(1, &m_bufCol);
+    mp_context->glState().deleteBuffers(1, &m_bufIdx);
+    mp_context->glState().deleteBuffers(1, &m_bufPos);
+    mp_context->glState().deleteBuffers(1, &m_bufNor);
+    mp_context->glState().deleteBuffers(1, &m_bufUV);
+    mp_context->glState().deleteBuffers(1, &m_bufIdx_sec);
+    mp_context->glState().deleteBuffers(1, &m_bufPos_sec);
+    mp_context->glState().deleteBuffers(1, &m_bufNor_sec);
+    mp_context->glState().deleteBuffers(1, &m_bufUV_sec);
+    mp_context->glState().deleteBuffers(1, &m_bufCol);
     m_idxGenerated = m_posGenerated = m_norGenerated = m_colGenerated = m_idxGenerated_sec = m_posGenerated_sec = m_norGenerated_sec = false;
     m_count = -1;
     m_count_sec = -1;
@@ -118,7 +118,7 @@ void Drawable::generateIdx_sec()
 bool Drawable::bindIdx()
 {
     if(m_idxGenerated) {
-        mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
+        mp_context->glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
     }
     return m_idxGenerated;
 }
@@ -126,7 +126,7 @@ bool Drawable::bindIdx()
 bool Drawable::bindPos()
 {
     if(m_posGenerated){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufPos);
+        mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufPos);
     }
     return m_posGenerated;
 }
@@ -134,7 +134,7 @@ bool Drawable::bindPos()
 bool Drawable::bindNor()
 {
     if(m_norGenerated){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufNor);
+        mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufNor);
     }
     return m_norGenerated;
 }
@@ -142,7 +142,7 @@ bool Drawable::bindNor()
 bool Drawable::bindCol()
 {
     if(m_colGenerated){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufCol);
+        mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufCol);
     }
     return m_colGenerated;
 }
@@ -151,7 +151,7 @@ bool Drawable::bindCol()
 bool Drawable::bindUV()
 {
     if(m_uvGenerated){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufUV);
+        mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufUV);
     }
     return m_uvGenerated;
 }
@@ -159,7 +159,7 @@ bool Drawable::bindUV()
 bool Drawable::bindIdx_sec()
 {
     if(m_idxGenerated_sec) {
-        mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx_sec);
+        mp_context->glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx_sec);
     }
     return m_idxGenerated_sec;
 }
@@ -167,7 +167,7 @@ bool Drawable::bindIdx_sec()
 bool Drawable::bindPos_sec()
 {
     if(m_posGenerated_sec){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufPos_sec);
+        mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufPos_sec);
     }
     return m_posGenerated_sec;
 }
@@ -175,7 +175,7 @@ bool Drawable::bindPos_sec()
 bool Drawable::bindNor_sec()
 {
     if(m_norGenerated_sec){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufNor_sec);
+        mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufNor_sec);
     }
     return m_norGenerated_sec;
 }
@@ -183,13 +183,14 @@ bool Drawable::bindNor_sec()
 bool Drawable::bindUV_sec()
 {
     if(m_uvGenerated_sec){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufUV_sec);
+        mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufUV_sec);
     }
     return m_uvGenerated_sec;
 }
 
 InstancedDrawable::InstancedDrawable(OpenGLContext *context)
-    : Drawable(context), m_numInstances(0), m_bufPosOffset(-1), m_offsetGenerated(false)
+    : Drawable(context), m_numInstances(0), m_bufPosOffset(-1), m_bufScale(-1),
+      m_offsetGenerated(false), m_scaleGenerated(false)
 {}
 
 InstancedDrawable::~InstancedDrawable(){}
@@ -205,7 +206,7 @@ void InstancedDrawable::generateOffsetBuf() {
 
 bool InstancedDrawable::bindOffsetBuf() {
     if(m_offsetGenerated){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufPosOffset);
+        mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufPosOffset);
     }
     return m_offsetGenerated;
 }
@@ -213,13 +214,43 @@ bool InstancedDrawable::bindOffsetBuf() {
 
 void InstancedDrawable::clearOffsetBuf() {
     if(m_offsetGenerated) {
-        mp_context->glDeleteBuffers(1, &m_bufPosOffset);
+        mp_context->glState().deleteBuffers(1, &m_bufPosOffset);
         m_offsetGenerated = false;
     }
 }
 void InstancedDrawable::clearColorBuf() {
     if(m_colGenerated) {
-        mp_context->glDeleteBuffers(1, &m_bufCol);
+        mp_context->glState().deleteBuffers(1, &m_bufCol);
         m_colGenerated = false;
     }
 }
+
+void InstancedDrawable::generateScaleBuf() {
+    m_scaleGenerated = true;
+    mp_context->glGenBuffers(1, &m_bufScale);
+}
+
+bool InstancedDrawable::bindScaleBuf() {
+    if(m_scaleGenerated){
+        mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufScale);
+    }
+    return m_scaleGenerated;
+}
+
+void InstancedDrawable::streamInterleavedInstances(const std::vector<glm::vec3> &data) {
+    if(!m_offsetGenerated) {
+        generateOffsetBuf();
+    }
+    m_numInstances = data.size() / 3;
+    GLsizeiptr size = data.size() * sizeof(glm::vec3);
+    mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufPosOffset);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    mp_context->glBufferSubData(GL_ARRAY_BUFFER, 0, size, data.data());
+}
+
+void InstancedDrawable::clearScaleBuf() {
+    if(m_scaleGenerated) {
+        mp_context->glState().deleteBuffers(1, &m_bufScale);
+        m_scaleGenerated = false;
+    }
+}
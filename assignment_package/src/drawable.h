@@ -84,8 +84,10 @@ class InstancedDrawable : public Drawable {
 protected:
     int m_numInstances;
     GLuint m_bufPosOffset;
+    GLuint m_bufScale; // Per-instance size along each axis
 
     bool m_offsetGenerated;
+    bool m_scaleGenerated;
 
 public:
     InstancedDrawable(OpenGLContext* mp_context);
@@ -96,6 +98,15 @@ public:
     bool bindOffsetBuf();
     void clearOffsetBuf();
     void clearColorBuf();
+    void generateScaleBuf();
+    bool bindScaleBuf();
+    void clearScaleBuf();
 
-    virtual void createInstancedVBOdata(std::vector<glm::vec3> &offsets, std::vector<glm::vec3> &colors) = 0;
+    // Uploads per-instance data for drawInstancedInterleaved into the
+    // offset buffer: an (offset, scale, color) triple per instance.
+    // The old contents are orphaned so the upload never waits on the GPU.
+    void streamInterleavedInstances(const std::vector<glm::vec3> &data);
+
+    virtual void createInstancedVBOdata(std::vector<glm::vec3> &offsets, std::vector<glm::vec3> &scales,
+                                        std::vector<glm::vec3> &colors) = 0;
 };
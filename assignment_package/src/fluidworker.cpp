@@ -0,0 +1,22 @@
+#include "fluidworker.h"
+
+FluidWorker::FluidWorker(FluidSimulator *s, Chunk *c, vector<int> &&b)
+    : simulator(s), chunk(c), blocks(std::move(b))
+{
+}
+
+void FluidWorker::run()
+{
+    vector<BlockChange> changes;
+    for (int i : blocks) {
+        // Inverse of blockIndex
+        int y = i % 256, x = (i / 256) % 16, z = i / 4096;
+        BlockType newType;
+        unsigned char newLevel;
+        if (simulator->nextState(chunk, x, y, z, &newType, &newLevel)) {
+            changes.push_back(BlockChange{chunk, (unsigned char)x, (unsigned char)y, (unsigned char)z,
+                                          chunk->getBlockAt(x, y, z), newType, newLevel});
+        }
+    }
+    simulator->reportChanges(changes);
+}
@@ -0,0 +1,20 @@
+#ifndef FLUIDWORKER_H
+#define FLUIDWORKER_H
+
+#include <QRunnable>
+#include "scene/fluidsimulator.h"
+using namespace std;
+
+// Evaluates one tick of the fluid simulation for the active
+// blocks of a single Chunk
+class FluidWorker : public QRunnable
+{
+protected:
+    FluidSimulator* simulator;
+    Chunk* chunk;
+    vector<int> blocks;
+public:
+    FluidWorker(FluidSimulator* s, Chunk* c, vector<int> &&b);
+    void run() override;
+};
+#endif // FLUIDWORKER_H
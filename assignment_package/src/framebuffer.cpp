@@ -2,65 +2,117 @@
 #include <iostream>
 
 FrameBuffer::FrameBuffer(OpenGLContext *context,
-                         unsigned int width, unsigned int height, unsigned int devicePixelRatio)
+                         unsigned int width, unsigned int height, unsigned int devicePixelRatio,
+                         GLenum colorFormat, bool hasDepth, unsigned int samples)
     : mp_context(context), m_frameBuffer(-1),
-      m_outputTexture(-1), m_depthRenderBuffer(-1),
-      m_width(width), m_height(height), m_devicePixelRatio(devicePixelRatio), m_created(false)
+      m_outputTexture(-1), m_colorRenderBuffer(-1), m_depthRenderBuffer(-1),
+      m_width(width), m_height(height), m_devicePixelRatio(devicePixelRatio),
+      m_colorFormat(colorFormat), m_hasDepth(hasDepth), m_samples(samples), m_created(false), m_textureSlot(0)
 {}
 
 void FrameBuffer::resize(unsigned int width, unsigned int height, unsigned int devicePixelRatio) {
+    if (width == m_width && height == m_height && devicePixelRatio == m_devicePixelRatio) {
+        return;
+    }
     m_width = width;
     m_height = height;
     m_devicePixelRatio = devicePixelRatio;
+    // GL storage cannot change size, so the old objects are replaced
+    if (m_created) {
+        destroy();
+        create();
+    }
 }
 
 void FrameBuffer::create() {
+    // Whatever is being drawn to now is bound again at the end
+    GLint previous = 0;
+    mp_context->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+
     // Initialize the frame buffers and render textures
     mp_context->glGenFramebuffers(1, &m_frameBuffer);
-    mp_context->glGenTextures(1, &m_outputTexture);
-    mp_context->glGenRenderbuffers(1, &m_depthRenderBuffer);
-
     mp_context->glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
+    if (m_samples > 0) {
+        createMultisampled();
+    } else {
+        createTextured();
+    }
+
+    // Sets the color output of the fragment shader to be stored in GL_COLOR_ATTACHMENT0,
+    // which we previously set to m_renderedTexture
+    GLenum drawBuffers[1] = {GL_COLOR_ATTACHMENT0};
+    mp_context->glDrawBuffers(1, drawBuffers); // "1" is the size of drawBuffers
+
+    m_created = true;
+    if(mp_context->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        m_created = false;
+        std::cout << "Frame buffer did not initialize correctly..." << std::endl;
+        mp_context->printGLErrorLog();
+        // Nothing can use them, and destroy() will not see them
+        deleteObjects();
+    }
+    mp_context->glBindFramebuffer(GL_FRAMEBUFFER, previous);
+}
+
+void FrameBuffer::createTextured() {
+    mp_context->glGenTextures(1, &m_outputTexture);
     // Bind our texture so that all functions that deal with textures will interact with this one
-    mp_context->glBindTexture(GL_TEXTURE_2D, m_outputTexture);
+    mp_context->glState().bindTexture(0, GL_TEXTURE_2D, m_outputTexture);
     // Give an empty image to OpenGL ( the last "0" )
-    mp_context->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width * m_devicePixelRatio, m_height * m_devicePixelRatio, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
+    mp_context->glTexImage2D(GL_TEXTURE_2D, 0, m_colorFormat, pixelWidth(), pixelHeight(), 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
 
     // Set the render settings for the texture we've just created.
-    // Essentially zero filtering on the "texture" so it appears exactly as rendered
-    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    // Sampled at the same size it appears exactly as rendered, and a
+    // smaller target read by a larger pass is smoothly scaled up.
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     // Clamp the colors at the edge of our texture
     mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    // Initialize our depth buffer
-    mp_context->glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderBuffer);
-    mp_context->glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, m_width, m_height);
-    mp_context->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderBuffer);
+    // Initialize our depth buffer, unless only full-screen passes draw here
+    if (m_hasDepth) {
+        mp_context->glGenRenderbuffers(1, &m_depthRenderBuffer);
+        mp_context->glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderBuffer);
+        mp_context->glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, pixelWidth(), pixelHeight());
+        mp_context->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderBuffer);
+    }
 
     // Set m_renderedTexture as the color output of our frame buffer
     mp_context->glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_outputTexture, 0);
+}
 
-    // Sets the color output of the fragment shader to be stored in GL_COLOR_ATTACHMENT0,
-    // which we previously set to m_renderedTexture
-    GLenum drawBuffers[1] = {GL_COLOR_ATTACHMENT0};
-    mp_context->glDrawBuffers(1, drawBuffers); // "1" is the size of drawBuffers
+void FrameBuffer::createMultisampled() {
+    mp_context->glGenRenderbuffers(1, &m_colorRenderBuffer);
+    mp_context->glBindRenderbuffer(GL_RENDERBUFFER, m_colorRenderBuffer);
+    mp_context->glRenderbufferStorageMultisample(GL_RENDERBUFFER, m_samples, m_colorFormat, pixelWidth(), pixelHeight());
+    mp_context->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorRenderBuffer);
 
-    m_created = true;
-    if(mp_context->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    {
-        m_created = false;
-        std::cout << "Frame buffer did not initialize correctly..." << std::endl;
-        mp_context->printGLErrorLog();
+    // Every attachment must have the same number of samples
+    if (m_hasDepth) {
+        mp_context->glGenRenderbuffers(1, &m_depthRenderBuffer);
+        mp_context->glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderBuffer);
+        mp_context->glRenderbufferStorageMultisample(GL_RENDERBUFFER, m_samples, GL_DEPTH_COMPONENT24, pixelWidth(), pixelHeight());
+        mp_context->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderBuffer);
     }
 }
 
 void FrameBuffer::destroy() {
     if(m_created) {
         m_created = false;
-        mp_context->glDeleteFramebuffers(1, &m_frameBuffer);
-        mp_context->glDeleteTextures(1, &m_outputTexture);
+        deleteObjects();
+    }
+}
+
+void FrameBuffer::deleteObjects() {
+    mp_context->glDeleteFramebuffers(1, &m_frameBuffer);
+    if (m_samples > 0) {
+        mp_context->glDeleteRenderbuffers(1, &m_colorRenderBuffer);
+    } else {
+        mp_context->glState().deleteTextures(1, &m_outputTexture);
+    }
+    if (m_hasDepth) {
         mp_context->glDeleteRenderbuffers(1, &m_depthRenderBuffer);
     }
 }
@@ -69,12 +121,38 @@ void FrameBuffer::bindFrameBuffer() {
     mp_context->glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
 }
 
+void FrameBuffer::blitTo(GLuint target, unsigned int width, unsigned int height) {
+    mp_context->glBindFramebuffer(GL_READ_FRAMEBUFFER, m_frameBuffer);
+    mp_context->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+    mp_context->glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    mp_context->glBindFramebuffer(GL_FRAMEBUFFER, target);
+}
+
+GLuint FrameBuffer::handle() const {
+    return m_frameBuffer;
+}
+
+bool FrameBuffer::isCreated() const {
+    return m_created;
+}
+
 void FrameBuffer::bindToTextureSlot(unsigned int slot) {
     m_textureSlot = slot;
-    mp_context->glActiveTexture(GL_TEXTURE0 + slot);
-    mp_context->glBindTexture(GL_TEXTURE_2D, m_outputTexture);
+    mp_context->glState().bindTexture(slot, GL_TEXTURE_2D, m_outputTexture);
 }
 
 unsigned int FrameBuffer::getTextureSlot() const {
     return m_textureSlot;
 }
+
+unsigned int FrameBuffer::pixelWidth() const {
+    return m_width * m_devicePixelRatio;
+}
+
+unsigned int FrameBuffer::pixelHeight() const {
+    return m_height * m_devicePixelRatio;
+}
+
+GLenum FrameBuffer::colorFormat() const {
+    return m_colorFormat;
+}
@@ -12,29 +12,53 @@
 // from the frame buffer's output texture by invoking
 // bindToTextureSlot() and then associating a ShaderProgram's
 // sampler2d with the appropriate texture slot.
+// A multisampled frame buffer has no texture to read; it is resolved
+// into another frame buffer with blitTo().
 class FrameBuffer {
 private:
     OpenGLContext *mp_context;
     GLuint m_frameBuffer;
     GLuint m_outputTexture;
+    GLuint m_colorRenderBuffer; // Takes the texture's place when multisampled
     GLuint m_depthRenderBuffer;
 
     unsigned int m_width, m_height, m_devicePixelRatio;
+    GLenum m_colorFormat; // Sized internal format of the output texture
+    bool m_hasDepth;
+    unsigned int m_samples; // 0 for an ordinary frame buffer
     bool m_created;
 
     unsigned int m_textureSlot;
 
+    // Attach the color and depth storage to the bound frame buffer
+    void createTextured();
+    void createMultisampled();
+    // Frees every GL object create() made
+    void deleteObjects();
+
 public:
-    FrameBuffer(OpenGLContext *context, unsigned int width, unsigned int height, unsigned int devicePixelRatio);
+    FrameBuffer(OpenGLContext *context, unsigned int width, unsigned int height, unsigned int devicePixelRatio,
+                GLenum colorFormat = GL_RGB8, bool hasDepth = true, unsigned int samples = 0);
     // Make sure to call resize from MyGL::resizeGL to keep your frame buffer up to date with
-    // your screen dimensions
+    // your screen dimensions. A created frame buffer is remade at the new size.
     void resize(unsigned int width, unsigned int height, unsigned int devicePixelRatio);
     // Initialize all GPU-side data required
     void create();
     // Deallocate all GPU-side data
     void destroy();
     void bindFrameBuffer();
+    // Copies the lower left width x height pixels into the frame buffer
+    // object target, averaging the samples of a multisampled frame
+    // buffer, and leaves target bound
+    void blitTo(GLuint target, unsigned int width, unsigned int height);
+    GLuint handle() const;
+    bool isCreated() const;
     // Associate our output texture with the indicated texture slot
     void bindToTextureSlot(unsigned int slot);
     unsigned int getTextureSlot() const;
+
+    // Size of the output texture in pixels
+    unsigned int pixelWidth() const;
+    unsigned int pixelHeight() const;
+    GLenum colorFormat() const;
 };
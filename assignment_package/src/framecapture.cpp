@@ -0,0 +1,151 @@
+#include "framecapture.h"
+#include "mygl.h"
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+
+// One point of a camera path. Yaw turns right from the player's starting
+// direction (-Z) and pitch looks up, both in degrees.
+struct PathKey {
+    glm::vec3 position;
+    float yaw, pitch;
+};
+
+static CameraPose poseOf(const PathKey &k) {
+    float yaw = glm::radians(k.yaw), pitch = glm::radians(k.pitch);
+    CameraPose pose;
+    pose.position = k.position;
+    pose.forward = glm::vec3(glm::sin(yaw) * glm::cos(pitch), glm::sin(pitch), -glm::cos(yaw) * glm::cos(pitch));
+    pose.right = glm::normalize(glm::cross(pose.forward, glm::vec3(0.f, 1.f, 0.f)));
+    pose.up = glm::cross(pose.right, pose.forward);
+    return pose;
+}
+
+// Reads one "x y z yaw pitch" key per line. Blank lines and lines
+// starting with # are skipped.
+static bool readPath(const QString &file, std::vector<PathKey> *keys) {
+    QFile f(file);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream in(&f);
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith("#")) {
+            continue;
+        }
+        QStringList parts = line.split(' ', Qt::SkipEmptyParts);
+        if (parts.size() != 5) {
+            return false;
+        }
+        float v[5];
+        for (int i = 0; i < 5; i++) {
+            bool ok;
+            v[i] = parts[i].toFloat(&ok);
+            if (!ok) {
+                return false;
+            }
+        }
+        keys->push_back(PathKey{glm::vec3(v[0], v[1], v[2]), v[3], v[4]});
+    }
+    return !keys->empty();
+}
+
+// Where the path is a fraction t of the way along, spending the same
+// number of frames between each pair of keys
+static PathKey samplePath(const std::vector<PathKey> &keys, float t) {
+    if (keys.size() == 1) {
+        return keys[0];
+    }
+    float f = t * (keys.size() - 1);
+    int i = glm::min(static_cast<int>(f), static_cast<int>(keys.size()) - 2);
+    float a = f - i;
+    const PathKey &k0 = keys[i], &k1 = keys[i + 1];
+    return PathKey{glm::mix(k0.position, k1.position, a), glm::mix(k0.yaw, k1.yaw, a), glm::mix(k0.pitch, k1.pitch, a)};
+}
+
+int runCapture(const QStringList &args) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays a camera path offscreen, saving frames and timings.");
+    parser.addHelpOption();
+    QCommandLineOption captureOption("capture", "Directory for the frames and timings.csv.", "dir");
+    QCommandLineOption pathOption("path", "Camera path: one \"x y z yaw pitch\" per line (default a fly-over).", "file");
+    QCommandLineOption framesOption("frames", "Frames to spread along the path (default 120).", "count", "120");
+    QCommandLineOption sizeOption("size", "Frame size (default 640x360).", "WxH", "640x360");
+    QCommandLineOption radiusOption("radius", "Draw radius in chunks (default 4).", "chunks", "4");
+    QCommandLineOption timeoutOption("timeout", "Longest to wait for terrain per frame (default 30000).", "ms", "30000");
+    QCommandLineOption noImagesOption("no-images", "Only write timings.csv.");
+    QCommandLineOption softwareOption("software", "Use Mesa's software rasterizer. Handled in main().");
+    parser.addOptions({captureOption, pathOption, framesOption, sizeOption,
+                       radiusOption, timeoutOption, noImagesOption, softwareOption});
+    parser.process(args);
+
+    QStringList size = parser.value(sizeOption).split('x');
+    int width = size.size() == 2 ? size[0].toInt() : 0;
+    int height = size.size() == 2 ? size[1].toInt() : 0;
+    if (width <= 0 || height <= 0) {
+        qCritical("--size must look like 640x360");
+        return 1;
+    }
+    std::vector<PathKey> keys;
+    if (parser.isSet(pathOption)) {
+        if (!readPath(parser.value(pathOption), &keys)) {
+            qCritical("Could not read a camera path from %s", qPrintable(parser.value(pathOption)));
+            return 1;
+        }
+    } else {
+        keys = {PathKey{glm::vec3(0.f, 160.f, 0.f), 135.f, -25.f},
+                PathKey{glm::vec3(192.f, 160.f, 192.f), 135.f, -25.f}};
+    }
+    int frames = std::max(1, parser.value(framesOption).toInt());
+    int timeoutMs = parser.value(timeoutOption).toInt();
+    bool saveImages = !parser.isSet(noImagesOption);
+
+    QDir dir(parser.value(captureOption));
+    if (!dir.mkpath(".")) {
+        qCritical("Could not create %s", qPrintable(parser.value(captureOption)));
+        return 1;
+    }
+    QFile csvFile(dir.filePath("timings.csv"));
+    if (!csvFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qCritical("Could not write %s", qPrintable(csvFile.fileName()));
+        return 1;
+    }
+    QTextStream csv(&csvFile);
+    csv << "frame,x,y,z,yaw,pitch,settled,stream_ms,cpu_ms,gpu_ms\n";
+
+    MyGL gl;
+    gl.setManualStepping(parser.value(radiusOption).toInt());
+    gl.resize(width, height);
+    // The first grab creates the GL context and runs initializeGL
+    float cpuMs, gpuMs;
+    gl.captureFrame(&cpuMs, &gpuMs);
+
+    int unsettled = 0;
+    for (int i = 0; i < frames; i++) {
+        PathKey key = samplePath(keys, frames == 1 ? 0.f : i / float(frames - 1));
+        QElapsedTimer streamTimer;
+        streamTimer.start();
+        bool settled = gl.placeCamera(poseOf(key), timeoutMs);
+        float streamMs = streamTimer.nsecsElapsed() / 1e6f;
+        unsettled += !settled;
+
+        QImage frame = gl.captureFrame(&cpuMs, &gpuMs);
+        if (saveImages) {
+            QString name = QString("frame_%1.png").arg(i, 4, 10, QChar('0'));
+            if (!frame.save(dir.filePath(name), "PNG")) {
+                qCritical("Could not write %s", qPrintable(dir.filePath(name)));
+                return 1;
+            }
+        }
+        csv << i << ',' << key.position.x << ',' << key.position.y << ',' << key.position.z << ','
+            << key.yaw << ',' << key.pitch << ',' << (settled ? 1 : 0) << ','
+            << streamMs << ',' << cpuMs << ',' << gpuMs << '\n';
+    }
+    csv.flush();
+    if (unsettled > 0) {
+        qWarning("%d of %d frames were drawn before their terrain finished loading", unsettled, frames);
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <QStringList>
+
+// Replays a camera path through MyGL without ever showing a window,
+// saving each frame as a PNG along with a CSV of how long it took to
+// stream in, draw on the CPU and execute on the GPU. For rendering
+// performance and correctness checks in automated jobs.
+//
+// MyGL draws into the framebuffer object QOpenGLWidget keeps for itself,
+// on a QOffscreenSurface when it has no window, so no display is
+// needed beyond a Qt platform that can make GL contexts. With
+// --software Mesa is asked for its software rasterizer, so it also runs
+// on machines without a GPU.
+//
+// args is the whole command line, including --capture <dir>; the other
+// options are listed in framecapture.cpp. Needs a QApplication and the
+// default surface format set up as for the game. Returns the process's
+// exit code.
+int runCapture(const QStringList &args);
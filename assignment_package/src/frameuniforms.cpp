@@ -0,0 +1,40 @@
+#include "frameuniforms.h"
+
+FrameUniforms::FrameUniforms(OpenGLContext *context)
+    : mp_context(context), m_buffer(0), m_created(false)
+{}
+
+void FrameUniforms::create() {
+    mp_context->glGenBuffers(1, &m_buffer);
+    mp_context->glState().bindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    mp_context->glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_STREAM_DRAW);
+    m_created = true;
+}
+
+void FrameUniforms::destroy() {
+    if(m_created) {
+        mp_context->glState().deleteBuffers(1, &m_buffer);
+        m_created = false;
+    }
+}
+
+void FrameUniforms::update(const glm::mat4 &viewProj, glm::vec3 cameraPos, glm::vec3 lightDir, int time) {
+    static_assert(sizeof(Block) == 112, "Block must match the std140 PerFrame block");
+    Block block;
+    block.viewProj = viewProj;
+    block.cameraPos = glm::vec4(cameraPos, 1.f);
+    block.lightDir = glm::vec4(glm::normalize(lightDir), 0.f);
+    block.time = glm::ivec4(time, 0, 0, 0);
+    mp_context->glState().bindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    // Respecifying the whole buffer lets the driver hand over fresh
+    // storage instead of waiting for last frame's draws to finish with it
+    mp_context->glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_STREAM_DRAW);
+    mp_context->glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, m_buffer);
+}
+
+void FrameUniforms::attach(OpenGLContext *context, GLuint prog) {
+    GLuint block = context->glGetUniformBlockIndex(prog, "PerFrame");
+    if(block != GL_INVALID_INDEX) {
+        context->glUniformBlockBinding(prog, block, BINDING);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "openglcontext.h"
+#include <la.h>
+
+// The values every program needs once per frame, kept in one std140
+// uniform buffer that each shader reads through its PerFrame block.
+// They are uploaded once per frame rather than into each program, and
+// never per draw.
+class FrameUniforms {
+public:
+    // Uniform buffer binding point every PerFrame block is attached to
+    static const GLuint BINDING = 0;
+
+    FrameUniforms(OpenGLContext *context);
+
+    void create();
+    void destroy();
+
+    // Uploads this frame's values and binds the buffer to BINDING
+    void update(const glm::mat4 &viewProj, glm::vec3 cameraPos, glm::vec3 lightDir, int time);
+
+    // Attaches prog's PerFrame block, if it has one, to BINDING
+    static void attach(OpenGLContext *context, GLuint prog);
+
+private:
+    // Laid out as std140 lays out the PerFrame block
+    struct Block {
+        glm::mat4 viewProj;
+        glm::vec4 cameraPos;
+        glm::vec4 lightDir;
+        glm::ivec4 time; // Only x is read; the rest pads the block to a whole vec4
+    };
+
+    OpenGLContext *mp_context;
+    GLuint m_buffer;
+    bool m_created;
+};
@@ -0,0 +1,132 @@
+#include "glstate.h"
+#include "openglcontext.h"
+
+// Stands for "whatever GL has", so the next bind is always issued
+static const GLuint UNKNOWN = ~0u;
+
+GLState::GLState(OpenGLContext *context)
+    : mp_context(context), m_program(UNKNOWN), m_vertexArray(UNKNOWN),
+      m_arrayBuffer(UNKNOWN), m_uniformBuffer(UNKNOWN), m_elementBuffer(UNKNOWN),
+      m_activeSlot(-1), m_textures(), m_attribArrays(0), m_attribArraysKnown(false)
+{
+    invalidate();
+}
+
+void GLState::invalidate() {
+    m_program = m_vertexArray = UNKNOWN;
+    m_arrayBuffer = m_uniformBuffer = m_elementBuffer = UNKNOWN;
+    m_activeSlot = -1;
+    for (std::array<GLuint, 2> &unit : m_textures) {
+        unit.fill(UNKNOWN);
+    }
+    m_attribArraysKnown = false;
+}
+
+void GLState::useProgram(GLuint prog) {
+    if (prog != m_program) {
+        mp_context->glUseProgram(prog);
+        m_program = prog;
+    }
+}
+
+void GLState::bindVertexArray(GLuint vao) {
+    if (vao != m_vertexArray) {
+        mp_context->glBindVertexArray(vao);
+        m_vertexArray = vao;
+        // The element buffer and enabled arrays come with the vertex array
+        m_elementBuffer = UNKNOWN;
+        m_attribArraysKnown = false;
+    }
+}
+
+GLuint *GLState::bufferSlot(GLenum target) {
+    switch (target) {
+    case GL_ARRAY_BUFFER:
+        return &m_arrayBuffer;
+    case GL_ELEMENT_ARRAY_BUFFER:
+        return &m_elementBuffer;
+    case GL_UNIFORM_BUFFER:
+        return &m_uniformBuffer;
+    default:
+        return nullptr;
+    }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buf) {
+    GLuint *bound = bufferSlot(target);
+    if (bound == nullptr || *bound != buf) {
+        mp_context->glBindBuffer(target, buf);
+        if (bound != nullptr) {
+            *bound = buf;
+        }
+    }
+}
+
+GLuint *GLState::textureSlot(int slot, GLenum target) {
+    if (slot < 0 || slot >= TEXTURE_SLOTS) {
+        return nullptr;
+    }
+    switch (target) {
+    case GL_TEXTURE_2D:
+        return &m_textures[slot][0];
+    case GL_TEXTURE_2D_ARRAY:
+        return &m_textures[slot][1];
+    default:
+        return nullptr;
+    }
+}
+
+void GLState::bindTexture(int slot, GLenum target, GLuint tex) {
+    GLuint *bound = textureSlot(slot, target);
+    if (bound != nullptr && *bound == tex) {
+        return;
+    }
+    if (slot != m_activeSlot) {
+        mp_context->glActiveTexture(GL_TEXTURE0 + slot);
+        m_activeSlot = slot;
+    }
+    mp_context->glBindTexture(target, tex);
+    if (bound != nullptr) {
+        *bound = tex;
+    }
+}
+
+void GLState::setAttribArrays(unsigned int mask) {
+    unsigned int changed = m_attribArraysKnown ? mask ^ m_attribArrays : (1u << ATTRIB_ARRAYS) - 1;
+    for (int i = 0; i < ATTRIB_ARRAYS; i++) {
+        if (!(changed & (1u << i))) {
+            continue;
+        }
+        if (mask & (1u << i)) {
+            mp_context->glEnableVertexAttribArray(i);
+        } else {
+            mp_context->glDisableVertexAttribArray(i);
+        }
+    }
+    m_attribArrays = mask;
+    m_attribArraysKnown = true;
+}
+
+void GLState::deleteBuffers(GLsizei n, const GLuint *bufs) {
+    mp_context->glDeleteBuffers(n, bufs);
+    for (GLsizei i = 0; i < n; i++) {
+        for (GLuint *bound : {&m_arrayBuffer, &m_elementBuffer, &m_uniformBuffer}) {
+            if (*bound == bufs[i]) {
+                *bound = UNKNOWN;
+            }
+        }
+    }
+}
+
+void GLState::deleteTextures(GLsizei n, const GLuint *texs) {
+    mp_context->glDeleteTextures(n, texs);
+    for (GLsizei i = 0; i < n; i++) {
+        for (std::array<GLuint, 2> &unit : m_textures) {
+            for (GLuint &bound : unit) {
+                if (bound == texs[i]) {
+                    bound = UNKNOWN;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <QOpenGLExtraFunctions>
+#include <array>
+
+class OpenGLContext;
+
+// Remembers which program, buffers, vertex array and textures are bound
+// so that binding the same one again costs nothing. Drawing a frame
+// binds the same few objects for every chunk, and each real bind is a
+// driver call and, for programs, a revalidation.
+//
+// The cache is only right while every bind goes through it, so all of
+// this project's binds and deletes of these objects do. Qt may change
+// bindings between frames, so invalidate() before each frame starts.
+class GLState {
+public:
+    // Texture units and vertex attributes that are cached. Anything past
+    // these is passed straight to GL.
+    static const int TEXTURE_SLOTS = 8;
+    static const int ATTRIB_ARRAYS = 16;
+
+    GLState(OpenGLContext *context);
+
+    // Forgets everything, so the next bind of each kind always reaches GL
+    void invalidate();
+
+    void useProgram(GLuint prog);
+    void bindVertexArray(GLuint vao);
+    // GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_UNIFORM_BUFFER are
+    // cached; other targets are always bound
+    void bindBuffer(GLenum target, GLuint buf);
+    // GL_TEXTURE_2D and GL_TEXTURE_2D_ARRAY are cached per unit
+    void bindTexture(int slot, GLenum target, GLuint tex);
+    // Enables exactly the vertex attribute arrays whose bits are set in
+    // mask, touching only those that change
+    void setAttribArrays(unsigned int mask);
+
+    // Deleting a bound object unbinds it, so these keep the cache in step
+    void deleteBuffers(GLsizei n, const GLuint *bufs);
+    void deleteTextures(GLsizei n, const GLuint *texs);
+
+private:
+    GLuint *bufferSlot(GLenum target);
+    GLuint *textureSlot(int slot, GLenum target);
+
+    OpenGLContext *mp_context;
+    GLuint m_program, m_vertexArray;
+    GLuint m_arrayBuffer, m_uniformBuffer;
+    GLuint m_elementBuffer; // Belongs to the bound vertex array
+    int m_activeSlot;
+    // GL_TEXTURE_2D then GL_TEXTURE_2D_ARRAY for each unit
+    std::array<std::array<GLuint, 2>, TEXTURE_SLOTS> m_textures;
+    unsigned int m_attribArrays;
+    bool m_attribArraysKnown;
+};
@@ -0,0 +1,70 @@
+#include "gputimer.h"
+
+GPUTimer::GPUTimer(OpenGLContext *context)
+    : mp_context(context), m_queries(), m_pending(),
+      m_current(0), m_active(false), m_created(false), m_lastMs(0.f)
+{
+    m_pending.fill(false);
+}
+
+void GPUTimer::create() {
+    mp_context->glGenQueries(NUM_QUERIES, m_queries.data());
+    m_pending.fill(false);
+    m_created = true;
+}
+
+void GPUTimer::destroy() {
+    if(m_created) {
+        mp_context->glDeleteQueries(NUM_QUERIES, m_queries.data());
+        m_created = false;
+    }
+}
+
+void GPUTimer::collectResults() {
+    // m_current is the oldest slot, so walking on from it reads the
+    // results in the order they were issued and the newest wins
+    for(int k = 0; k < NUM_QUERIES; k++) {
+        int i = (m_current + k) % NUM_QUERIES;
+        if(!m_pending[i]) {
+            continue;
+        }
+        GLuint available = GL_FALSE;
+        mp_context->glGetQueryObjectuiv(m_queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available) {
+            // The GPU finishes queries in order, so later ones are not done either
+            break;
+        }
+        GLuint elapsedNs = 0;
+        mp_context->glGetQueryObjectuiv(m_queries[i], GL_QUERY_RESULT, &elapsedNs);
+        m_lastMs = elapsedNs / 1000000.f;
+        m_pending[i] = false;
+    }
+}
+
+void GPUTimer::begin() {
+    if(!m_created) {
+        return;
+    }
+    collectResults();
+    // If the GPU is so far behind that every slot is still in flight,
+    // skip timing this frame rather than stalling on an old result
+    if(m_pending[m_current]) {
+        return;
+    }
+    mp_context->glBeginQuery(GL_TIME_ELAPSED, m_queries[m_current]);
+    m_active = true;
+}
+
+void GPUTimer::end() {
+    if(!m_active) {
+        return;
+    }
+    mp_context->glEndQuery(GL_TIME_ELAPSED);
+    m_pending[m_current] = true;
+    m_current = (m_current + 1) % NUM_QUERIES;
+    m_active = false;
+}
+
+float GPUTimer::lastMs() const {
+    return m_lastMs;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "openglcontext.h"
+#include <array>
+
+// Measures how long the GPU spends executing the commands issued
+// between begin() and end() using GL_TIME_ELAPSED queries.
+// Queries live in a small ring so that reading a result never
+// forces the CPU to wait on the GPU; as a consequence the reported
+// time lags a few frames behind the frame being drawn.
+class GPUTimer {
+private:
+    static const int NUM_QUERIES = 4;
+
+    OpenGLContext *mp_context;
+    std::array<GLuint, NUM_QUERIES> m_queries;
+    std::array<bool, NUM_QUERIES> m_pending; // Query issued but result not yet read back
+    int m_current; // Ring slot used by the next begin()
+    bool m_active; // True between a successful begin() and its end()
+    bool m_created;
+    float m_lastMs;
+
+public:
+    GPUTimer(OpenGLContext *context);
+
+    // Allocate / free the GPU-side query objects
+    void create();
+    void destroy();
+
+    void begin();
+    void end();
+
+    // Reads back every query whose result has become available.
+    // begin() does this too; call it directly to see the last frame's
+    // time once the GPU is known to have finished it.
+    void collectResults();
+
+    // The most recently resolved GPU time in milliseconds
+    float lastMs() const;
+};
@@ -1,4 +1,6 @@
 #include <mainwindow.h>
+#include "snapshot.h"
+#include "framecapture.h"
 
 #include <QApplication>
 #include <QSurfaceFormat>
@@ -21,14 +23,29 @@ void debugFormatVersion()
 
 int main(int argc, char *argv[])
 {
+    // Snapshots are drawn on the CPU, so they need no window or GL context.
+    // Captures still need GL, so they start up like the game does.
+    bool capture = false;
+    for (int i = 1; i < argc; i++) {
+        if (qstrcmp(argv[i], "--snapshot") == 0) {
+            QCoreApplication app(argc, argv);
+            return runSnapshot(app.arguments());
+        } else if (qstrcmp(argv[i], "--capture") == 0) {
+            capture = true;
+        } else if (qstrcmp(argv[i], "--software") == 0) {
+            // Must be set before Mesa is loaded
+            qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+        }
+    }
+
     QApplication a(argc, argv);
 
-    // Set OpenGL 4.0 and, optionally, 4-sample multisampling
+    // Set OpenGL 4.0. Antialiasing is chosen while running instead (X
+    // cycles none, FXAA and MSAA); MSAA draws into MyGL's own buffer.
     QSurfaceFormat format;
     format.setVersion(4, 0);
     format.setOption(QSurfaceFormat::DeprecatedFunctions, false);
     format.setProfile(QSurfaceFormat::CoreProfile);
-    //format.setSamples(4);  // Uncomment for nice antialiasing. Not always supported.
 
     /*** AUTOMATIC TESTING: DO NOT MODIFY ***/
     /*** Check whether automatic testing is enabled */
@@ -37,6 +54,10 @@ int main(int argc, char *argv[])
     QSurfaceFormat::setDefaultFormat(format);
     debugFormatVersion();
 
+    if (capture) {
+        return runCapture(a.arguments());
+    }
+
     MainWindow w;
     w.show();
 
@@ -18,6 +18,8 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->mygl, SIGNAL(sig_sendPlayerLook(QString)), &playerInfoWindow, SLOT(slot_setLookText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerChunk(QString)), &playerInfoWindow, SLOT(slot_setChunkText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerTerrainZone(QString)), &playerInfoWindow, SLOT(slot_setZoneText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendRenderDistance(QString)), &playerInfoWindow, SLOT(slot_setRenderDistText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendAntialiasing(QString)), &playerInfoWindow, SLOT(slot_setAntialiasText(QString)));
 }
 
 MainWindow::~MainWindow()
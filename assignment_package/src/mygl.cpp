@@ -2,23 +2,61 @@
 #include "scene/terrain.h"
 #include <glm_includes.h>
 
+#include <cstdio>
 #include <iostream>
 #include <QApplication>
 #include <QKeyEvent>
 
+// Length of one simulation step in dT units (1 is 10 ms): 60 steps per second
+static const float SIM_STEP_LENGTH = 10.f / 6.f;
+// Direction toward the sun, for every shader through FrameUniforms
+static const glm::vec3 LIGHT_DIR(0.5f, 1.f, 0.75f);
+// How hard the upscale pass sharpens a scene drawn below full resolution
+static const float UPSCALE_SHARPNESS = 0.2f;
+// Names of the passes in m_postProcess that are switched on and off
+static const char *PASS_UPSCALE = "upscale";
+static const char *PASS_BLOOM = "bloom";
+static const char *PASS_UNDERWATER = "underwater";
+static const char *PASS_HEAT_HAZE = "heat haze";
+static const char *PASS_GREYSCALE = "greyscale";
+static const char *PASS_FXAA = "fxaa";
+// Samples per pixel under AA_MSAA, if the GPU has that many
+static const int MSAA_SAMPLES = 4;
+// Smoothing of the per-mode GPU times
+static const float ANTIALIAS_SMOOTHING = 0.05f;
+
 
 MyGL::MyGL(QWidget *parent)
     : OpenGLContext(parent),
       m_ppShader(),
-      m_geomQuad(this),
-      fb(this,0,0,0),
+      m_geomQuad(this), m_postProcess(this),
+      fb(this,0,0,0), m_msaaBuffer(this, 0, 0, 1, GL_RGBA8, true, MSAA_SAMPLES),
       m_worldAxes(this),
-      m_progLambert(this), m_progFlat(this), m_diffuseTexture(this),
+      m_progLambert(this), m_progFlat(this), m_progInstanced(this), m_diffuseTexture(this),
+      m_frameUniforms(this),
       m_terrain(this), m_player(glm::vec3(32.f, 200.f, 32.f), m_terrain),
-      m_currFrameTime(QDateTime::currentMSecsSinceEpoch()),
-      m_prevFrameTime(QDateTime::currentMSecsSinceEpoch()),
-      accumulativeRotationOnRight(0.f), m_time(0.f)
+      m_entities(), m_geomEntityCube(this), m_pendingPaths(),
+      m_particles(), m_geomParticleCube(this), m_playerWasInWater(false),
+      m_simulation(), m_inputs(), m_pendingCommands(), m_inputLock(),
+      m_publishedFrame(), m_renderFrame(), m_frameFresh(false), m_frameLock(),
+      m_renderCamera(m_player.mcr_camera), m_clock(),
+      accumulativeRotationOnRight(0.f), m_time(0.f),
+      m_renderDistance(16.f, 2, 16, 4), m_resolutionScale(12.f, 0.5f, 1.f), m_dynamicResolution(false),
+      m_antialias(AA_NONE), m_msaaSupported(false), m_antialiasMs(), m_antialiasSettleFrames(0),
+      m_gpuTimer(this), m_lastTickMs(0.f),
+      m_zoneRadius(m_renderDistance.zoneRadius()), m_lastPaintMs(0.f),
+      m_manualStepping(false)
 {
+    m_clock.start();
+    m_renderFrame.prevCamera = m_renderFrame.currCamera = m_player.mcr_camera.getPose();
+    m_renderFrame.stepTimeNs = 0;
+    m_renderFrame.time = 0;
+    m_renderFrame.pendingJobs = 0;
+    m_renderFrame.particleCounts.fill(0);
+    m_renderFrame.cameraMedium = EMPTY;
+    m_antialiasMs.fill(0.f);
+    m_simulation = mkU<SimulationThread>([this](float dT) { simulate(dT); }, SIM_STEP_LENGTH);
+
     // Connect the timer to a function so that when the timer ticks the function is executed
     connect(&m_timer, SIGNAL(timeout()), this, SLOT(tick()));
     // Tell the timer to redraw 60 times per second
@@ -30,8 +68,16 @@ MyGL::MyGL(QWidget *parent)
 }
 
 MyGL::~MyGL() {
+    m_simulation->requestInterruption();
+    m_simulation->wait();
     makeCurrent();
     glDeleteVertexArrays(1, &vao);
+    m_diffuseTexture.destroy();
+    fb.destroy();
+    m_msaaBuffer.destroy();
+    m_postProcess.destroy();
+    m_frameUniforms.destroy();
+    m_gpuTimer.destroy();
 }
 
 
@@ -60,19 +106,42 @@ void MyGL::initializeGL()
 
     // Create a Vertex Attribute Object
     glGenVertexArrays(1, &vao);
+    // We have to have a VAO bound in OpenGL 3.2 Core. But if we're not
+    // using multiple VAOs, we can just bind one once, before any buffers
+    // are made.
+    glState().bindVertexArray(vao);
     m_diffuseTexture.create(":/textures/minecraft_textures_all.png");
     m_diffuseTexture.load(0);
 
-    fb = FrameBuffer(this, this->width(), this->height(), this->devicePixelRatio());
+    // Sized in pixels, since the device pixel ratio may be fractional.
+    // RGBA8 like the widget's framebuffer and m_msaaBuffer, since some
+    // drivers refuse to resolve samples between different formats.
+    fb = FrameBuffer(this, this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio(), 1, GL_RGBA8);
     fb.create();
+    GLint maxSamples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+    m_msaaSupported = maxSamples >= MSAA_SAMPLES;
+
+    m_gpuTimer.create();
+    m_frameUniforms.create();
 
     //Create the instance of the world axes
     m_worldAxes.createVBOdata();
+    m_geomEntityCube.createVBOdata();
+    m_geomParticleCube.createVBOdata();
+    m_geomQuad.createVBOdata();
 
+    // Every program is started before any is used, so drivers that can
+    // build them in the background work on all of them at once
+    ProgramBuilder::enableParallelCompile(this);
     // Create and set up the diffuse shader
     m_progLambert.create(":/glsl/lambert.vert.glsl", ":/glsl/lambert.frag.glsl");
     // Create and set up the flat lighting shader
     m_progFlat.create(":/glsl/flat.vert.glsl", ":/glsl/flat.frag.glsl");
+    // Lighting is done per vertex, so the flat fragment shader is enough
+    m_progInstanced.create(":/glsl/instanced.vert.glsl", ":/glsl/flat.frag.glsl");
+
+    createShaders();
 
     // Set a color with which to draw geometry.
     // This will ultimately not be used when you change
@@ -80,63 +149,217 @@ void MyGL::initializeGL()
     // and UV coordinates
     m_progLambert.setGeometryColor(glm::vec4(0,1,0,1));
 
-    createShaders();
-
-
-    // We have to have a VAO bound in OpenGL 3.2 Core. But if we're not
-    // using multiple VAOs, we can just bind one once.
-    glBindVertexArray(vao);
 
 //    m_terrain.CreateTestScene();
+    if (!m_manualStepping) {
+        m_simulation->start();
+    }
 }
 
 
 void MyGL::createShaders()
 
 {
-    std::shared_ptr<PPShader> grey = std::make_shared<PPShader>(this);
-    grey->create(":/glsl/post/passthrough.vert.glsl", ":/glsl/post/greyscale.frag.glsl");
-    m_ppShader.push_back(grey);
-    //m_ppShader = std::make_shared<PPShader>(this);
-    //std::shared_ptr<PPShader> grey = std::make_shared<PPShader>(this);
-
-    mp_progPostprocessCurrent = m_ppShader[0].get();
-
+    auto load = [this](const char *fragfile) {
+        std::shared_ptr<PPShader> shader = std::make_shared<PPShader>(this);
+        shader->create(":/glsl/post/passthrough.vert.glsl", fragfile);
+        m_ppShader.push_back(shader);
+        return shader.get();
+    };
+    PPShader *upscale = load(":/glsl/post/upscale.frag.glsl");
+    PPShader *bright = load(":/glsl/post/bloombright.frag.glsl");
+    PPShader *blur = load(":/glsl/post/bloomblur.frag.glsl");
+    PPShader *composite = load(":/glsl/post/bloomcomposite.frag.glsl");
+    PPShader *underwater = load(":/glsl/post/underwater.frag.glsl");
+    PPShader *haze = load(":/glsl/post/heathaze.frag.glsl");
+    PPShader *grey = load(":/glsl/post/greyscale.frag.glsl");
+    PPShader *fxaa = load(":/glsl/post/fxaa.frag.glsl");
+
+    const std::string &color = PostProcessGraph::COLOR;
+    // Brings a scene drawn at a lower resolution up to full size, so
+    // every later pass works on a full-size image
+    m_postProcess.addPass(PASS_UPSCALE, upscale, {color});
+    // Bloom finds the highlights at half resolution and blurs them at a
+    // quarter, so only its last pass is full size. Switching that pass
+    // off drops the others too, since nothing else reads them.
+    m_postProcess.addPass("bloom highlights", bright, {color}, "bloom", 2, glm::vec4(0.75f, 0.f, 0.f, 0.f));
+    m_postProcess.addPass("bloom blur across", blur, {"bloom"}, "bloom", 4, glm::vec4(1.f, 0.f, 0.f, 0.f));
+    m_postProcess.addPass("bloom blur down", blur, {"bloom"}, "bloom", 4, glm::vec4(0.f, 1.f, 0.f, 0.f));
+    m_postProcess.addPass(PASS_BLOOM, composite, {color, "bloom"}, color, 1, glm::vec4(0.8f, 0.f, 0.f, 0.f));
+    m_postProcess.addPass(PASS_UNDERWATER, underwater, {color}, color, 1, glm::vec4(0.05f, 0.2f, 0.45f, 0.45f));
+    m_postProcess.addPass(PASS_HEAT_HAZE, haze, {color}, color, 1, glm::vec4(1.f, 0.35f, 0.05f, 0.35f));
+    m_postProcess.addPass(PASS_GREYSCALE, grey, {color});
+    // Last, so it smooths the edges the image ends up with
+    m_postProcess.addPass(PASS_FXAA, fxaa, {color});
+    // Toggled from the keyboard, or by what the camera is in
+    m_postProcess.setEnabled(PASS_UPSCALE, false);
+    m_postProcess.setEnabled(PASS_BLOOM, false);
+    m_postProcess.setEnabled(PASS_UNDERWATER, false);
+    m_postProcess.setEnabled(PASS_HEAT_HAZE, false);
+    m_postProcess.setEnabled(PASS_GREYSCALE, false);
+    m_postProcess.setEnabled(PASS_FXAA, false);
 }
 
 void MyGL::resizeGL(int w, int h) {
     //This code sets the concatenated view and perspective projection matrices used for
     //our scene's camera view.
 
-    m_player.setCameraWidthHeight(static_cast<unsigned int>(w), static_cast<unsigned int>(h));
-    glm::mat4 viewproj = m_player.mcr_camera.getViewProj();
-
-    // Upload the view-projection matrix to our shaders (i.e. onto the graphics card)
-
-    m_progLambert.setViewProjMatrix(viewproj);
-    m_progFlat.setViewProjMatrix(viewproj);
-    fb.resize(this->width(), this->height(), this->devicePixelRatio());
+    // The view-projection matrix reaches the shaders through
+    // m_frameUniforms at the start of every frame
+    m_renderCamera.setWidthHeight(static_cast<unsigned int>(w), static_cast<unsigned int>(h));
+    fb.resize(w * this->devicePixelRatio(), h * this->devicePixelRatio(), 1);
+    m_msaaBuffer.resize(fb.pixelWidth(), fb.pixelHeight(), 1);
+    m_postProcess.resize(fb.pixelWidth(), fb.pixelHeight());
 
     printGLErrorLog();
 }
 
 
 // MyGL's constructor links tick() to a timer that fires 60 times per second.
-// We're treating MyGL as our game engine class, so we're going to perform
-// all per-frame actions here, such as performing physics updates on all
-// entities in the scene.
+// The world is advanced separately by m_simulation, so all this does is
+// ask for the next frame to be drawn.
 void MyGL::tick() {
+    update(); // Calls paintGL() as part of a larger QOpenGLWidget pipeline
+}
+
+void MyGL::simulate(float dT) {
+    QElapsedTimer tickTimer;
+    tickTimer.start();
+    InputBundle inputs;
+    std::vector<std::function<void()>> commands;
+    m_inputLock.lock();
+    inputs = m_inputs;
+    // Mouse movement is consumed; held keys stay held
+    m_inputs.mouseX = 0.f;
+    m_inputs.mouseY = 0.f;
+    std::swap(commands, m_pendingCommands);
+    m_inputLock.unlock();
+    for (auto &command : commands) {
+        command();
+    }
+
+    CameraPose prevCamera = m_player.mcr_camera.getPose();
+    m_player.rotateOnRightLocal(inputs.mouseY);
+    m_player.rotateOnUpGlobal(inputs.mouseX);
     m_player.mcr_posPrev = m_player.mcr_position;
-    m_currFrameTime = QDateTime::currentMSecsSinceEpoch();
-    float dT =(m_currFrameTime - m_prevFrameTime) * 0.1f;
-    m_player.tick(dT, m_inputs);
+    m_player.tick(dT, inputs);
 //    cout << "tick()" << endl;
-    m_terrain.multithreadedWork(m_player.mcr_position, m_player.mcr_posPrev, dT);
-    m_progLambert.setTime(m_time); // Set time in shader
-    update(); // Calls paintGL() as part of a larger QOpenGLWidget pipeline
-    sendPlayerDataToGUI(); // Updates the info in the secondary window displaying player data
-    m_prevFrameTime = m_currFrameTime;
+    m_terrain.setZoneRadius(m_zoneRadius);
+    m_terrain.multithreadedWork(m_player.mcr_position, m_player.getWorldVelocity(), m_player.mcr_forward, dT);
+    collectMobPaths();
+    m_entities.tick(dT, m_terrain);
+    emitPlayerParticles();
+    m_particles.tick(dT, m_terrain);
     m_time++; // Update time
+    publishFrame(prevCamera);
+    m_lastTickMs = tickTimer.nsecsElapsed() / 1000000.f;
+    sendPlayerDataToGUI(); // Updates the info in the secondary window displaying player data
+}
+
+void MyGL::publishFrame(const CameraPose &prevCamera) {
+    QMutexLocker locker(&m_frameLock);
+    FrameSnapshot &f = m_publishedFrame;
+    f.prevCamera = prevCamera;
+    f.currCamera = m_player.mcr_camera.getPose();
+    f.time = m_time;
+    f.pendingJobs = m_terrain.pendingJobCount();
+    m_entities.getInstanceData(&f.entityOffsets, &f.entityScales, &f.entityColors);
+    m_particles.getInstanceData(&f.particleInstances);
+    for (int m = 0; m < NUM_PARTICLE_MATERIALS; m++) {
+        f.particleCounts[m] = m_particles.count(static_cast<ParticleMaterial>(m));
+    }
+    f.cameraMedium = blockContaining(f.currCamera.position);
+    f.stepTimeNs = m_clock.nsecsElapsed();
+    m_frameFresh = true;
+}
+
+void MyGL::updateRenderFrame() {
+    m_frameLock.lock();
+    if (m_frameFresh) {
+        std::swap(m_renderFrame, m_publishedFrame);
+        m_frameFresh = false;
+    }
+    m_frameLock.unlock();
+    // The camera is drawn one step behind, partway from where it was to
+    // where it is, so it moves smoothly whatever the frame rate. Only
+    // its position is interpolated; looking around uses the newest step.
+    float stepNs = SIM_STEP_LENGTH * 1e7f;
+    float alpha = glm::clamp((m_clock.nsecsElapsed() - m_renderFrame.stepTimeNs) / stepNs, 0.f, 1.f);
+    CameraPose pose = m_renderFrame.currCamera;
+    pose.position = glm::mix(m_renderFrame.prevCamera.position, pose.position, alpha);
+    m_renderCamera.setPose(pose);
+}
+
+void MyGL::queueCommand(std::function<void()> command) {
+    QMutexLocker locker(&m_inputLock);
+    m_pendingCommands.push_back(command);
+}
+
+void MyGL::setManualStepping(int drawRadius) {
+    m_manualStepping = true;
+    m_timer.stop();
+    m_renderDistance = RenderDistanceController(16.f, drawRadius, drawRadius, drawRadius);
+    m_zoneRadius = m_renderDistance.zoneRadius();
+}
+
+BlockType MyGL::blockContaining(glm::vec3 p) const {
+    glm::ivec3 block = glm::ivec3(glm::floor(p));
+    if (block.y < 0 || block.y >= 256 || !m_terrain.hasChunkAt(block.x, block.z)) {
+        return EMPTY;
+    }
+    return m_terrain.getBlockAt(block.x, block.y, block.z);
+}
+
+bool MyGL::terrainSettled() const {
+    if (m_terrain.pendingJobCount() > 0) {
+        return false;
+    }
+    int radius = m_renderDistance.drawRadius();
+    glm::ivec2 center = 16 * glm::ivec2(glm::floor(glm::vec2(m_player.mcr_camera.mcr_position.x,
+                                                              m_player.mcr_camera.mcr_position.z) / 16.f));
+    for (int x = center.x - 16 * radius; x <= center.x + 16 * radius; x += 16) {
+        for (int z = center.y - 16 * radius; z <= center.y + 16 * radius; z += 16) {
+            if (!m_terrain.hasChunkAt(x, z) || m_terrain.getChunkAt(x, z)->m_generationState != GENERATED) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool MyGL::placeCamera(const CameraPose &pose, int timeoutMs) {
+    m_player.setCameraPose(pose);
+    m_terrain.setZoneRadius(m_zoneRadius);
+    QElapsedTimer timer;
+    timer.start();
+    bool settled = false;
+    while (true) {
+        m_terrain.multithreadedWork(pose.position, glm::vec3(0.f), pose.forward, SIM_STEP_LENGTH);
+        // Meshes are only uploaded when a frame is drawn, and the
+        // workers count as busy until they are
+        makeCurrent();
+        m_terrain.uploadVBOResults();
+        doneCurrent();
+        settled = terrainSettled();
+        if (settled || timer.elapsed() >= timeoutMs) {
+            break;
+        }
+        QThread::msleep(1);
+    }
+    // Both ends of the interpolation are the new pose, so it is drawn as is
+    publishFrame(m_player.mcr_camera.getPose());
+    return settled;
+}
+
+QImage MyGL::captureFrame(float *cpuMs, float *gpuMs) {
+    QImage frame = grabFramebuffer();
+    // Reading the frame back waited for the GPU, so its query is done
+    makeCurrent();
+    m_gpuTimer.collectResults();
+    doneCurrent();
+    *cpuMs = m_lastPaintMs;
+    *gpuMs = m_gpuTimer.lastMs();
+    return frame;
 }
 
 void MyGL::sendPlayerDataToGUI() const {
@@ -155,15 +378,61 @@ void MyGL::sendPlayerDataToGUI() const {
 // MyGL's constructor links update() to a timer that fires 60 times per second,
 // so paintGL() called at a rate of 60 frames per second.
 void MyGL::paintGL() {
-    //fb.bindFrameBuffer();
-
-    glViewport(0,0,this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+    m_gpuTimer.begin();
+    // Qt may have changed bindings since the last frame
+    glState().invalidate();
+    glState().bindVertexArray(vao);
+    m_terrain.uploadVBOResults();
+    updateRenderFrame();
+
+    // Looking out from inside a liquid tints the whole view
+    m_postProcess.setEnabled(PASS_UNDERWATER, m_renderFrame.cameraMedium == WATER);
+    m_postProcess.setEnabled(PASS_HEAT_HAZE, m_renderFrame.cameraMedium == LAVA);
+    // Below full scale the world is drawn into the lower left of fb and
+    // stretched over the screen; the axes drawn after are still sharp
+    int sceneWidth = fb.pixelWidth(), sceneHeight = fb.pixelHeight();
+    if (m_dynamicResolution) {
+        float scale = m_resolutionScale.scale();
+        sceneWidth = glm::max(1, static_cast<int>(sceneWidth * scale + 0.5f));
+        sceneHeight = glm::max(1, static_cast<int>(sceneHeight * scale + 0.5f));
+        glm::vec2 covered = glm::vec2(sceneWidth, sceneHeight) / glm::vec2(fb.pixelWidth(), fb.pixelHeight());
+        m_postProcess.setParams(PASS_UPSCALE, glm::vec4(UPSCALE_SHARPNESS, 0.f, covered));
+    }
+    // Drawing at full scale needs no upscale
+    m_postProcess.setEnabled(PASS_UPSCALE, m_dynamicResolution && m_resolutionScale.scale() < 1.f);
+    m_postProcess.setEnabled(PASS_FXAA, m_antialias == AA_FXAA);
+    // Four samples per pixel take four times the memory, so the buffer
+    // only exists while it is used
+    bool msaa = m_antialias == AA_MSAA;
+    if (msaa && !m_msaaBuffer.isCreated()) {
+        m_msaaBuffer.create();
+        if (!m_msaaBuffer.isCreated()) {
+            // Not for this format after all
+            m_msaaSupported = msaa = false;
+            m_antialias = AA_NONE;
+        }
+    } else if (!msaa && m_msaaBuffer.isCreated()) {
+        m_msaaBuffer.destroy();
+    }
+    // With no effects to apply the scene goes straight to the screen
+    bool postProcess = m_postProcess.active();
+    if (msaa) {
+        m_msaaBuffer.bindFrameBuffer();
+        glViewport(0, 0, sceneWidth, sceneHeight);
+    } else if (postProcess) {
+        fb.bindFrameBuffer();
+        glViewport(0, 0, sceneWidth, sceneHeight);
+    } else {
+        glViewport(0,0,this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
+    }
 
     // Clear the screen so that we only see newly drawn images
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    m_progFlat.setViewProjMatrix(m_player.mcr_camera.getViewProj());
-    m_progLambert.setViewProjMatrix(m_player.mcr_camera.getViewProj());
+    // Camera, light and time for every program, once per frame
+    m_frameUniforms.update(m_renderCamera.getViewProj(), m_renderCamera.mcr_position, LIGHT_DIR, m_renderFrame.time);
     m_progLambert.setModelMatrix(glm::mat4());
 
     //this->m_terrain.expandTerrain(m_player.mcr_position.x, m_player.mcr_position.z);
@@ -171,43 +440,175 @@ void MyGL::paintGL() {
     m_diffuseTexture.bind(0);
 
     renderTerrain();
+    renderEntities();
+    renderParticles();
+
+    if (msaa) {
+        // Averages the samples of each pixel into a single color
+        m_msaaBuffer.blitTo(postProcess ? fb.handle() : this->defaultFramebufferObject(), sceneWidth, sceneHeight);
+    }
+    if (postProcess) {
+        performPostprocessRenderPass();
+    }
 
+    // Drawn over the effects, which are for the world only
     glDisable(GL_DEPTH_TEST);
     m_progFlat.setModelMatrix(glm::mat4());
-    m_progFlat.setViewProjMatrix(m_player.mcr_camera.getViewProj());
     m_progFlat.draw(m_worldAxes);
     glEnable(GL_DEPTH_TEST);
 
-    //performPostprocessRenderPass();
+    m_gpuTimer.end();
+    float paintMs = paintTimer.nsecsElapsed() / 1000000.f;
+    m_lastPaintMs = paintMs;
+    // Simulation and drawing run side by side, so whichever is slower sets the pace
+    m_renderDistance.recordFrame(glm::max(m_lastTickMs.load(), paintMs), m_gpuTimer.lastMs(), m_renderFrame.pendingJobs);
+    m_zoneRadius = m_renderDistance.zoneRadius();
+    std::string resolution;
+    if (m_dynamicResolution) {
+        m_resolutionScale.recordFrame(m_gpuTimer.lastMs());
+        resolution = ", " + std::to_string(static_cast<int>(m_resolutionScale.scale() * 100.f + 0.5f)) + "% resolution";
+    }
+    emit sig_sendRenderDistance(QString::fromStdString(std::to_string(m_renderDistance.drawRadius()) + " chunks, "
+                                                       + std::to_string(m_renderDistance.zoneRadius()) + " zones ("
+                                                       + std::to_string(static_cast<int>(m_renderDistance.smoothedFrameMs() + 0.5f)) + " ms)"
+                                                       + resolution));
+    recordAntialiasCost();
 }
 
 void MyGL::performPostprocessRenderPass()
 {
-    // Render the frame buffer as a texture on a screen-size quad
-
-    // Tell OpenGL to render to the viewport's frame buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, this->defaultFramebufferObject());
-    // Render on the whole framebuffer, complete from the lower left corner to the upper right
+    // Render the frame buffer through each effect, the last straight
+    // into the viewport's frame buffer. Every pixel is drawn, so there
+    // is nothing to clear.
+    m_postProcess.execute(fb, this->defaultFramebufferObject(), m_geomQuad);
+    // Back to the whole framebuffer, for anything drawn on top
     glViewport(0,0,this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
-    // Clear the screen
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
 
-    fb.bindToTextureSlot(0);
-    mp_progPostprocessCurrent->draw(m_geomQuad, 0);
+void MyGL::cycleAntialiasMode() {
+    AntialiasMode next = static_cast<AntialiasMode>((m_antialias + 1) % NUM_AA_MODES);
+    if (next == AA_MSAA && !m_msaaSupported) {
+        next = AA_NONE;
+    }
+    m_antialias = next;
+    // The GPU timer's next few results are still for frames drawn the
+    // old way (see GPUTimer)
+    m_antialiasSettleFrames = 4;
 }
 
-// TODO: Change this so it renders the nine zones of generated
-// terrain that surround the player (refer to Terrain::m_generatedTerrain
-// for more info)
+void MyGL::recordAntialiasCost() {
+    float gpuMs = m_gpuTimer.lastMs();
+    if (m_antialiasSettleFrames > 0) {
+        m_antialiasSettleFrames--;
+    } else if (gpuMs > 0.f) {
+        float &ms = m_antialiasMs[m_antialias];
+        ms = ms == 0.f ? gpuMs : ms + ANTIALIAS_SMOOTHING * (gpuMs - ms);
+    }
+
+    // Each mode's GPU frame time, from whenever it was last used
+    static const char *names[NUM_AA_MODES] = {"None", "FXAA", "MSAA"};
+    std::string text = names[m_antialias];
+    for (int m = 0; m < NUM_AA_MODES; m++) {
+        text += m == 0 ? " (" : ", ";
+        text += names[m];
+        if (m == AA_MSAA && !m_msaaSupported) {
+            text += " n/a";
+        } else if (m_antialiasMs[m] > 0.f) {
+            char ms[16];
+            std::snprintf(ms, sizeof(ms), " %.1f ms", m_antialiasMs[m]);
+            text += ms;
+        } else {
+            text += " -";
+        }
+    }
+    text += ")";
+    emit sig_sendAntialiasing(QString::fromStdString(text));
+}
+
+// Renders the chunks within the adaptive draw radius of the player's chunk
 void MyGL::renderTerrain() {
-    int xmin = 16 * (glm::floor(this->m_player.mcr_position.x / 16.f) - 1);
-    int xmax = 16 * (glm::floor(this->m_player.mcr_position.x / 16.f) + 2);
+    int radius = m_renderDistance.drawRadius();
+    int xmin = 16 * (glm::floor(this->m_renderCamera.mcr_position.x / 16.f) - radius);
+    int xmax = 16 * (glm::floor(this->m_renderCamera.mcr_position.x / 16.f) + radius + 1);
 
-    int zmin = 16 * (glm::floor(this->m_player.mcr_position.z / 16.f) - 1);
-    int zmax = 16 * (glm::floor(this->m_player.mcr_position.z / 16.f) + 2);
+    int zmin = 16 * (glm::floor(this->m_renderCamera.mcr_position.z / 16.f) - radius);
+    int zmax = 16 * (glm::floor(this->m_renderCamera.mcr_position.z / 16.f) + radius + 1);
     m_terrain.draw(xmin, xmax, zmin, zmax, &m_progLambert);
 }
 
+void MyGL::renderEntities() {
+    FrameSnapshot &f = m_renderFrame;
+    if (f.entityOffsets.empty()) {
+        return;
+    }
+    m_geomEntityCube.createInstancedVBOdata(f.entityOffsets, f.entityScales, f.entityColors);
+    m_progInstanced.drawInstanced(m_geomEntityCube);
+}
+
+void MyGL::renderParticles() {
+    const FrameSnapshot &f = m_renderFrame;
+    if (f.particleInstances.empty()) {
+        return;
+    }
+    // Every particle goes up in one buffer, then each material is one draw
+    m_geomParticleCube.streamInterleavedInstances(f.particleInstances);
+    int first = 0;
+    for (int m = 0; m < NUM_PARTICLE_MATERIALS; m++) {
+        int count = f.particleCounts[m];
+        m_progInstanced.drawInstancedInterleaved(m_geomParticleCube, first, count);
+        first += count;
+    }
+}
+
+void MyGL::emitPlayerParticles() {
+    m_particles.emitAmbient(m_player.mcr_position, 24.f, m_terrain);
+
+    glm::vec3 feet = m_player.mcr_position;
+    glm::ivec3 block = glm::ivec3(glm::floor(feet));
+    bool inWater = blockContaining(feet) == WATER;
+    if (inWater && !m_playerWasInWater) {
+        // Faster falls throw up bigger splashes; the velocity is in blocks per dT
+        float speed = glm::abs(m_player.getWorldVelocity().y) * 100.f;
+        m_particles.emitSplash(glm::vec3(feet.x, block.y + 1, feet.z), glm::clamp(speed / 10.f, 0.3f, 1.5f));
+    }
+    m_playerWasInWater = inWater;
+}
+
+void MyGL::spawnMobs(int count) {
+    glm::vec3 center = m_player.mcr_position;
+    for (int i = 0; i < count; i++) {
+        // Golden angle spiral, so the mobs spread out evenly
+        float angle = i * 2.39996f;
+        float dist = 4.f + 0.5f * glm::sqrt(static_cast<float>(i)) * 4.f;
+        glm::vec3 pos = center + glm::vec3(glm::cos(angle) * dist, 2.f, glm::sin(angle) * dist);
+        m_entities.spawn(MOB, pos);
+    }
+}
+
+void MyGL::sendMobsToPlayer() {
+    std::vector<EntityId> mobs;
+    m_entities.getIds(MOB, &mobs);
+    for (EntityId id : mobs) {
+        PathTicket ticket = m_terrain.m_navGraph.requestPath(m_entities.getPosition(id), m_player.mcr_position);
+        m_pendingPaths.push_back(std::make_pair(id, ticket));
+    }
+}
+
+void MyGL::collectMobPaths() {
+    std::vector<glm::ivec3> path;
+    for (auto it = m_pendingPaths.begin(); it != m_pendingPaths.end();) {
+        bool found;
+        if (!m_terrain.m_navGraph.takePath(it->second, &found, &path)) {
+            ++it;
+            continue;
+        }
+        if (found) {
+            m_entities.setPath(it->first, std::move(path));
+        }
+        it = m_pendingPaths.erase(it);
+    }
+}
+
 
 void MyGL::keyPressEvent(QKeyEvent *e) {
     float amount = 2.f;
@@ -221,7 +622,11 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
     // chain of if statements instead
     if (e->key() == Qt::Key_Escape) {
         QApplication::quit();
-    } else if (e->key() == Qt::Key_W) {
+        return;
+    }
+    // The simulation thread reads these at the start of its next step
+    QMutexLocker locker(&m_inputLock);
+    if (e->key() == Qt::Key_W) {
         m_inputs.wPressed = true;
     } else if (e->key() == Qt::Key_S) {
         m_inputs.sPressed = true;
@@ -236,11 +641,27 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
     } else if (e->key() == Qt::Key_Space) {
         m_inputs.spacePressed = true;
     } else if (e->key() == Qt::Key_F) {
-        m_player.toggleFlight();
+        m_pendingCommands.push_back([this]() { m_player.toggleFlight(); });
+    } else if (e->key() == Qt::Key_M) {
+        m_pendingCommands.push_back([this]() { spawnMobs(100); });
+    } else if (e->key() == Qt::Key_N) {
+        m_pendingCommands.push_back([this]() { sendMobsToPlayer(); });
+    } else if (e->key() == Qt::Key_B) {
+        // Effects belong to the render thread, which this is
+        m_postProcess.setEnabled(PASS_BLOOM, !m_postProcess.isEnabled(PASS_BLOOM));
+    } else if (e->key() == Qt::Key_G) {
+        m_postProcess.setEnabled(PASS_GREYSCALE, !m_postProcess.isEnabled(PASS_GREYSCALE));
+    } else if (e->key() == Qt::Key_V) {
+        // Each time it is switched on it starts again from full resolution
+        m_dynamicResolution = !m_dynamicResolution;
+        m_resolutionScale.reset();
+    } else if (e->key() == Qt::Key_X) {
+        cycleAntialiasMode();
     }
 }
 
 void MyGL::keyReleaseEvent(QKeyEvent *e) {
+    QMutexLocker locker(&m_inputLock);
     if (e->key() == Qt::Key_W) {
         m_inputs.wPressed = false;
     } else if (e->key() == Qt::Key_S) {
@@ -276,10 +697,11 @@ void MyGL::mouseMoveEvent(QMouseEvent *e) {
         phi += diff;
         accumulativeRotationOnRight = -90.f;
     }
-    m_player.rotateOnRightLocal(m_inputs.mouseY);
-    m_player.rotateOnUpGlobal(m_inputs.mouseX);
-    m_inputs.mouseY = -phi;
-    m_inputs.mouseX = -theta;
+    // Several moves may land between two steps, so they add up
+    m_inputLock.lock();
+    m_inputs.mouseY += -phi;
+    m_inputs.mouseX += -theta;
+    m_inputLock.unlock();
     moveMouseToCenter();
 
 
@@ -287,9 +709,17 @@ void MyGL::mouseMoveEvent(QMouseEvent *e) {
 
 void MyGL::mousePressEvent(QMouseEvent *e) {
     if (e->button() == Qt::LeftButton) {
-        m_player.removeBlock();
+        queueCommand([this]() {
+            glm::ivec3 removed;
+            BlockType removedType;
+            if (m_player.removeBlock(&removed, &removedType)) {
+                m_particles.emitBlockBreak(removed, removedType);
+                // Drop the block as an item that pops up out of its hole
+                m_entities.spawn(ITEM_DROP, glm::vec3(removed) + glm::vec3(0.5f), glm::vec3(0.f, 4.f, 0.f));
+            }
+        });
     } else if (e->button() == Qt::RightButton) {
-        m_player.addBlock();
+        queueCommand([this]() { m_player.addBlock(); });
     }
 }
 
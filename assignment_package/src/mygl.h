@@ -9,14 +9,34 @@
 #include "scene/camera.h"
 #include "scene/terrain.h"
 #include "scene/player.h"
+#include "scene/cube.h"
+#include "scene/entitysystem.h"
+#include "scene/particlesystem.h"
 #include "framebuffer.h"
-#include "texture.h"
+#include "postprocessgraph.h"
+#include "texturearray.h"
+#include "frameuniforms.h"
+#include "gputimer.h"
+#include "renderdistancecontroller.h"
+#include "resolutionscalecontroller.h"
+#include "simulationthread.h"
 
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLShaderProgram>
 #include <smartpointerhelp.h>
 #include <QDateTime>
-
+#include <QElapsedTimer>
+#include <QMutex>
+#include <atomic>
+#include <functional>
+
+// How the edges of the world are smoothed. FXAA is a post pass that
+// costs about the same at any scene complexity; MSAA draws the scene
+// with four samples per pixel and averages them.
+enum AntialiasMode : unsigned char {
+    AA_NONE, AA_FXAA, AA_MSAA,
+    NUM_AA_MODES
+};
 
 class MyGL : public OpenGLContext
 {
@@ -25,27 +45,81 @@ private:
     WorldAxes m_worldAxes; // A wireframe representation of the world axes. It is hard-coded to sit centered at (32, 128, 32).
     ShaderProgram m_progLambert;// A shader program that uses lambertian reflection
     ShaderProgram m_progFlat;// A shader program that uses "flat" reflection (no shadowing at all)
-    FrameBuffer fb;
-    Texture m_diffuseTexture; // A Texture object used to draw the diffuse texture of the blocks
+    ShaderProgram m_progInstanced; // Draws one Cube per entity with instanced rendering
+    FrameBuffer fb; // The scene is drawn here whenever m_postProcess has passes to run
+    FrameBuffer m_msaaBuffer; // The scene is drawn here under AA_MSAA, then resolved
+    TextureArray m_diffuseTexture; // One layer per block texture, drawn by the Lambert shader
+    FrameUniforms m_frameUniforms; // Camera, light and time shared by every program
 
     GLuint vao; // A handle for our vertex array object. This will store the VBOs created in our geometry classes.
                 // Don't worry too much about this. Just know it is necessary in order to render geometry.
 
     Terrain m_terrain; // All of the Chunks that currently comprise the world.
     Player m_player; // The entity controlled by the user. Contains a camera to display what it sees as well.
+    EntitySystem m_entities; // Mobs and dropped items
+    Cube m_geomEntityCube; // Unit cube drawn once per entity
+    // Paths requested for mobs that the NavGraph has not finished yet
+    std::vector<std::pair<EntityId, PathTicket>> m_pendingPaths;
+    ParticleSystem m_particles; // Block debris, lava sparks and splashes
+    Cube m_geomParticleCube; // Unit cube drawn once per particle
+    bool m_playerWasInWater; // For splashing when the player enters water
+
+    // The world above is only touched by m_simulation's thread, except
+    // for the GL uploads Terrain leaves to the render thread. Input
+    // events reach it through m_inputs and m_pendingCommands, and
+    // paintGL draws from the FrameSnapshot it publishes after each step.
+    uPtr<SimulationThread> m_simulation;
     InputBundle m_inputs; // A collection of variables to be updated in keyPressEvent, mouseMoveEvent, mousePressEvent, etc.
+    // Actions from input events to run at the start of the next step
+    std::vector<std::function<void()>> m_pendingCommands;
+    QMutex m_inputLock; // Guards m_inputs and m_pendingCommands
+
+    // Everything paintGL needs from one simulation step
+    struct FrameSnapshot {
+        CameraPose prevCamera, currCamera; // The player's camera before and after the step
+        qint64 stepTimeNs; // m_clock time when the step finished
+        int time;
+        int pendingJobs;
+        std::vector<glm::vec3> entityOffsets, entityScales, entityColors;
+        std::vector<glm::vec3> particleInstances;
+        std::array<int, NUM_PARTICLE_MATERIALS> particleCounts;
+        BlockType cameraMedium; // What the camera is inside, e.g. EMPTY or WATER
+    };
+    // Double buffered: the simulation thread writes the latest step into
+    // m_publishedFrame, and paintGL swaps it with m_renderFrame when it is new
+    FrameSnapshot m_publishedFrame;
+    FrameSnapshot m_renderFrame;
+    bool m_frameFresh;
+    QMutex m_frameLock;
+    // The player's camera moved smoothly between the last two steps
+    Camera m_renderCamera;
+    QElapsedTimer m_clock; // Shared by both threads for interpolation
 
     QTimer m_timer; // Timer linked to tick(). Fires approximately 60 times per second.
-    long long m_currFrameTime;
-    long long m_prevFrameTime;
 
-    PPShader* mp_progPostprocessCurrent;
     Quad m_geomQuad;
 
     std::vector<std::shared_ptr<PPShader>> m_ppShader;
+    PostProcessGraph m_postProcess; // Draws m_ppShader's effects over fb
 
     int m_time; // Time variable used to track time in shader
 
+    RenderDistanceController m_renderDistance; // Scales the draw and streaming radius to hold the frame budget
+    ResolutionScaleController m_resolutionScale; // Scales the scene's resolution to hold the GPU budget
+    bool m_dynamicResolution; // Whether m_resolutionScale is in use
+    AntialiasMode m_antialias;
+    bool m_msaaSupported;
+    // Smoothed GPU frame time under each mode, 0 until it has been used
+    std::array<float, NUM_AA_MODES> m_antialiasMs;
+    int m_antialiasSettleFrames; // Frames of the old mode the GPU timer has yet to report
+    GPUTimer m_gpuTimer; // Measures GPU time spent in paintGL()
+    std::atomic<float> m_lastTickMs; // CPU time spent in the most recent simulation step
+    std::atomic<int> m_zoneRadius; // m_renderDistance's zone radius, for the simulation thread
+    float m_lastPaintMs; // CPU time spent in the most recent paintGL()
+    // Set by setManualStepping: nothing moves the world or repaints
+    // unless the caller asks
+    bool m_manualStepping;
+
     long long lastFrame;
     float sensitivity = 0.1f;
     float accumulativeRotationOnRight;
@@ -56,6 +130,20 @@ private:
 
     void sendPlayerDataToGUI() const;
 
+    // Advances the world by one fixed step. Runs on m_simulation's thread.
+    void simulate(float dT);
+    // Fills in m_publishedFrame at the end of a step
+    void publishFrame(const CameraPose &prevCamera);
+    // Takes the newest FrameSnapshot and interpolates m_renderCamera
+    void updateRenderFrame();
+    // Runs command on the simulation thread at the start of its next step
+    void queueCommand(std::function<void()> command);
+    // True once every Chunk within the draw radius of the camera is
+    // generated and no terrain work is left in flight
+    bool terrainSettled() const;
+    // The block containing p, or EMPTY where there is no Chunk
+    BlockType blockContaining(glm::vec3 p) const;
+
 
 public:
     explicit MyGL(QWidget *parent = nullptr);
@@ -76,9 +164,38 @@ public:
     // Calls Terrain::draw().
     void createShaders();
     void renderTerrain();
-
+    void renderEntities();
+    void renderParticles();
+    // Emits the particles that depend on what the player is doing
+    void emitPlayerParticles();
+    // Spawns count mobs in a ring around the player
+    void spawnMobs(int count);
+    // Asks for a path to the player for every mob
+    void sendMobsToPlayer();
+    // Hands the paths that have been found to their mobs
+    void collectMobPaths();
+    // Moves on to the next AntialiasMode this GPU can do
+    void cycleAntialiasMode();
+    // Folds the last GPU time into the current mode's and reports them
+    void recordAntialiasCost();
+
+    // Runs m_postProcess over fb and into the widget's framebuffer
     void performPostprocessRenderPass();
 
+    // For automated capture (see FrameCapture), which drives MyGL itself
+    // without ever showing it. Call before the first frame is drawn;
+    // afterwards neither the simulation thread nor the repaint timer
+    // runs, and the draw radius is held at drawRadius chunks so every
+    // run draws the same amount.
+    void setManualStepping(int drawRadius);
+    // Moves the player's camera to pose and streams in the terrain
+    // around it. Returns false if that is still unfinished after timeoutMs.
+    bool placeCamera(const CameraPose &pose, int timeoutMs);
+    // Draws one frame into the widget's offscreen framebuffer and reads
+    // it back, along with the CPU time paintGL took and the GPU time of
+    // the commands it issued
+    QImage captureFrame(float *cpuMs, float *gpuMs);
+
 protected:
     // Automatically invoked when the user
     // presses a key on the keyboard
@@ -93,7 +210,7 @@ protected:
     void mousePressEvent(QMouseEvent *e);
 
 private slots:
-    void tick(); // Slot that gets called ~60 times per second by m_timer firing.
+    void tick(); // Slot that gets called ~60 times per second by m_timer firing. Schedules a repaint.
 
 signals:
     void sig_sendPlayerPos(QString) const;
@@ -102,6 +219,8 @@ signals:
     void sig_sendPlayerLook(QString) const;
     void sig_sendPlayerChunk(QString) const;
     void sig_sendPlayerTerrainZone(QString) const;
+    void sig_sendRenderDistance(QString) const;
+    void sig_sendAntialiasing(QString) const;
 };
 
 
@@ -0,0 +1,11 @@
+#include "navclusterworker.h"
+
+NavClusterWorker::NavClusterWorker(NavGraph *g, Chunk *c)
+    : graph(g), chunk(c)
+{
+}
+
+void NavClusterWorker::run()
+{
+    graph->reportCluster(chunk, NavGraph::buildCluster(chunk));
+}
@@ -0,0 +1,18 @@
+#ifndef NAVCLUSTERWORKER_H
+#define NAVCLUSTERWORKER_H
+
+#include <QRunnable>
+#include "scene/navgraph.h"
+using namespace std;
+
+// Rebuilds the NavCluster of one Chunk
+class NavClusterWorker : public QRunnable
+{
+protected:
+    NavGraph* graph;
+    Chunk* chunk;
+public:
+    NavClusterWorker(NavGraph* g, Chunk* c);
+    void run() override;
+};
+#endif // NAVCLUSTERWORKER_H
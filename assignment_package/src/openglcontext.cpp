@@ -8,12 +8,16 @@
 
 
 OpenGLContext::OpenGLContext(QWidget *parent)
-    : QOpenGLWidget(parent)
+    : QOpenGLWidget(parent), m_glState(this)
 {}
 
 OpenGLContext::~OpenGLContext()
 {}
 
+GLState &OpenGLContext::glState() {
+    return m_glState;
+}
+
 inline const char *glGS(GLenum e)
 {
     return reinterpret_cast<const char *>(glGetString(e));
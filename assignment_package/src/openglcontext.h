@@ -3,6 +3,7 @@
 #include <QOpenGLWidget>
 #include <QTimer>
 #include <QOpenGLExtraFunctions>
+#include "glstate.h"
 
 class OpenGLContext
     : public QOpenGLWidget,
@@ -17,4 +18,11 @@ public:
     void printGLErrorLog();
     void printLinkInfoLog(int prog);
     void printShaderInfoLog(int shader);
+
+    // Binds of programs, buffers, vertex arrays and textures go through
+    // here so repeated ones are skipped
+    GLState &glState();
+
+private:
+    GLState m_glState;
 };
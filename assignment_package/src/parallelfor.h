@@ -0,0 +1,45 @@
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <QThread>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <algorithm>
+
+// Thread pool for short jobs that the current frame waits on. It is kept
+// apart from the global pool so they never queue up behind terrain generation.
+inline QThreadPool* simulationThreadPool() {
+    static QThreadPool pool;
+    return &pool;
+}
+
+// Calls body(begin, end) over [0, count) split into one contiguous range
+// per core, each at least minBatch long, and returns once all of them are
+// done. The calling thread runs the first range itself. body must only
+// write to data belonging to its own range.
+template <typename F>
+void parallelFor(int count, int minBatch, F body) {
+    int batches = std::min(std::max(1, QThread::idealThreadCount()),
+                           (count + minBatch - 1) / std::max(minBatch, 1));
+    if (batches <= 1) {
+        if (count > 0) {
+            body(0, count);
+        }
+        return;
+    }
+
+    int perBatch = (count + batches - 1) / batches;
+    QSemaphore done;
+    for (int b = 1; b < batches; b++) {
+        int begin = std::min(count, b * perBatch);
+        int end = std::min(count, begin + perBatch);
+        simulationThreadPool()->start([&body, &done, begin, end]() {
+            body(begin, end);
+            done.release();
+        });
+    }
+    body(0, perBatch);
+    done.acquire(batches - 1);
+}
+
+#endif // PARALLELFOR_H
@@ -0,0 +1,13 @@
+#include "pathworker.h"
+
+PathWorker::PathWorker(NavGraph *g, PathTicket t, glm::vec3 f, glm::vec3 dest)
+    : graph(g), ticket(t), from(f), to(dest)
+{
+}
+
+void PathWorker::run()
+{
+    vector<glm::ivec3> path;
+    bool found = graph->findPath(from, to, &path);
+    graph->reportPath(ticket, found, std::move(path));
+}
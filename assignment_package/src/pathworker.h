@@ -0,0 +1,19 @@
+#ifndef PATHWORKER_H
+#define PATHWORKER_H
+
+#include <QRunnable>
+#include "scene/navgraph.h"
+using namespace std;
+
+// Answers one path request made to a NavGraph
+class PathWorker : public QRunnable
+{
+protected:
+    NavGraph* graph;
+    PathTicket ticket;
+    glm::vec3 from, to;
+public:
+    PathWorker(NavGraph* g, PathTicket t, glm::vec3 f, glm::vec3 dest);
+    void run() override;
+};
+#endif // PATHWORKER_H
@@ -35,4 +35,10 @@ void PlayerInfo::slot_setChunkText(QString s) {
 void PlayerInfo::slot_setZoneText(QString s) {
     ui->zoneLabel->setText(s);
 }
+void PlayerInfo::slot_setRenderDistText(QString s) {
+    ui->renderDistLabel->setText(s);
+}
 
+void PlayerInfo::slot_setAntialiasText(QString s) {
+    ui->antialiasLabel->setText(s);
+}
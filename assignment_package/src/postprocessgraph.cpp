@@ -0,0 +1,184 @@
+#include "postprocessgraph.h"
+#include <algorithm>
+#include <map>
+
+const std::string PostProcessGraph::COLOR = "color";
+
+PostProcessGraph::PostProcessGraph(OpenGLContext *context)
+    : mp_context(context), m_pool(context), m_passes(), m_steps(), m_resourceCount(1),
+      m_dirty(true), m_width(1), m_height(1), m_passesRun(0)
+{}
+
+void PostProcessGraph::addPass(const std::string &name, PPShader *shader, const std::vector<std::string> &inputs,
+                               const std::string &output, int divisor, const glm::vec4 &params, GLenum format) {
+    m_passes.push_back(Pass{name, shader, inputs, output, divisor, params, format, true});
+    m_dirty = true;
+}
+
+void PostProcessGraph::setEnabled(const std::string &name, bool enabled) {
+    for (Pass &p : m_passes) {
+        if (p.name == name && p.enabled != enabled) {
+            p.enabled = enabled;
+            m_dirty = true;
+        }
+    }
+}
+
+bool PostProcessGraph::isEnabled(const std::string &name) const {
+    for (const Pass &p : m_passes) {
+        if (p.name == name) {
+            return p.enabled;
+        }
+    }
+    return false;
+}
+
+void PostProcessGraph::setParams(const std::string &name, const glm::vec4 &params) {
+    for (Pass &p : m_passes) {
+        if (p.name == name) {
+            p.params = params;
+        }
+    }
+}
+
+void PostProcessGraph::resize(unsigned int width, unsigned int height) {
+    if (width == m_width && height == m_height) {
+        return;
+    }
+    m_width = width;
+    m_height = height;
+    m_pool.clear();
+}
+
+bool PostProcessGraph::active() {
+    if (m_dirty) {
+        compile();
+    }
+    return !m_steps.empty();
+}
+
+void PostProcessGraph::compile() {
+    m_dirty = false;
+    m_steps.clear();
+
+    // Resolve every enabled pass's names to the resources written so far
+    std::vector<Step> planned;
+    std::map<std::string, int> latest;
+    latest[COLOR] = 0;
+    int resources = 1;
+    for (const Pass &p : m_passes) {
+        if (!p.enabled) {
+            continue;
+        }
+        Step s{&p, {}, 0, false, {}};
+        bool missing = false;
+        for (const std::string &in : p.inputs) {
+            auto it = latest.find(in);
+            if (it == latest.end()) {
+                // Its writer is disabled, so this pass has nothing to read
+                missing = true;
+                break;
+            }
+            s.inputs.push_back(it->second);
+        }
+        if (missing) {
+            continue;
+        }
+        s.output = resources++;
+        latest[p.output] = s.output;
+        planned.push_back(s);
+    }
+    m_resourceCount = resources;
+    int result = latest[COLOR];
+    if (result == 0) {
+        return;
+    }
+
+    // Walk back from the final image, keeping the passes it depends on
+    std::vector<bool> needed(resources, false);
+    std::vector<bool> live(planned.size(), false);
+    needed[result] = true;
+    for (int i = static_cast<int>(planned.size()) - 1; i >= 0; i--) {
+        if (needed[planned[i].output]) {
+            live[i] = true;
+            for (int in : planned[i].inputs) {
+                needed[in] = true;
+            }
+        }
+    }
+    for (size_t i = 0; i < planned.size(); i++) {
+        if (live[i]) {
+            m_steps.push_back(planned[i]);
+        }
+    }
+
+    // Each target goes back to the pool after the last step reading it.
+    // The scene is not the pool's, and the final image is the screen.
+    std::vector<int> lastRead(resources, -1);
+    for (size_t i = 0; i < m_steps.size(); i++) {
+        for (int in : m_steps[i].inputs) {
+            lastRead[in] = i;
+        }
+    }
+    for (int r = 1; r < resources; r++) {
+        if (lastRead[r] >= 0) {
+            m_steps[lastRead[r]].released.push_back(r);
+        }
+    }
+    m_steps.back().toScreen = true;
+}
+
+void PostProcessGraph::execute(FrameBuffer &scene, GLuint screen, Drawable &quad) {
+    m_passesRun = 0;
+    if (!active()) {
+        return;
+    }
+    // Every pass covers its whole target, so nothing is cleared, tested
+    // or blended
+    mp_context->glDisable(GL_DEPTH_TEST);
+    mp_context->glDisable(GL_BLEND);
+
+    std::vector<FrameBuffer*> targets(m_resourceCount, nullptr);
+    targets[0] = &scene;
+    for (const Step &s : m_steps) {
+        const Pass &p = *s.pass;
+        unsigned int w = m_width, h = m_height;
+        if (s.toScreen) {
+            mp_context->glBindFramebuffer(GL_FRAMEBUFFER, screen);
+        } else {
+            w = std::max(1u, m_width / p.divisor);
+            h = std::max(1u, m_height / p.divisor);
+            // Taken before the inputs are released, so a pass never
+            // draws into the texture it reads
+            FrameBuffer *target = m_pool.acquire(w, h, p.format);
+            targets[s.output] = target;
+            target->bindFrameBuffer();
+        }
+        mp_context->glViewport(0, 0, w, h);
+        for (size_t i = 0; i < s.inputs.size(); i++) {
+            targets[s.inputs[i]]->bindToTextureSlot(i);
+        }
+        p.shader->setDimensions(glm::ivec2(w, h));
+        p.shader->setParams(p.params);
+        p.shader->draw(quad, 0);
+        for (int r : s.released) {
+            m_pool.release(targets[r]);
+        }
+        m_passesRun++;
+    }
+
+    mp_context->glEnable(GL_DEPTH_TEST);
+    mp_context->glEnable(GL_BLEND);
+}
+
+void PostProcessGraph::destroy() {
+    m_pool.clear();
+}
+
+int PostProcessGraph::passesRun() const {
+    return m_passesRun;
+}
+
+int PostProcessGraph::targetCount() const {
+    return m_pool.size();
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "ppshader.h"
+#include "rendertargetpool.h"
+#include <string>
+#include <vector>
+
+// Post-processing as a list of full-screen passes, each declaring the
+// textures it reads and the one it writes. Each frame only the enabled
+// passes the final image depends on are run, every output is drawn into
+// a target from a shared RenderTargetPool, and each target goes back to
+// the pool as soon as its last reader has run. Passes at half or
+// quarter resolution get targets of that size.
+//
+// Passes are joined by name. COLOR is the image being built up: as an
+// input it is whatever the enabled passes before have made of the
+// scene, and writing it makes the next step of that image. Any other
+// name is an intermediate for later passes, e.g. the blurred highlights
+// a bloom pass adds back in. Disabling the pass that writes COLOR from
+// such intermediates also drops the passes that only fed it.
+class PostProcessGraph {
+public:
+    static const std::string COLOR;
+
+    PostProcessGraph(OpenGLContext *context);
+
+    // Appends a pass drawing shader at 1/divisor of the screen size into
+    // a target of the given format. Its inputs go to the texture slots
+    // from 0 in order, and params to the shader's u_Params. The pass
+    // starts enabled.
+    void addPass(const std::string &name, PPShader *shader, const std::vector<std::string> &inputs,
+                 const std::string &output = COLOR, int divisor = 1, const glm::vec4 &params = glm::vec4(0.f),
+                 GLenum format = GL_RGB8);
+    void setEnabled(const std::string &name, bool enabled);
+    bool isEnabled(const std::string &name) const;
+    // Changes what a pass passes to u_Params, e.g. once per frame
+    void setParams(const std::string &name, const glm::vec4 &params);
+
+    // Size of the screen in pixels. Pooled targets are remade to match.
+    void resize(unsigned int width, unsigned int height);
+    // Whether any pass will run, so the scene must be drawn offscreen
+    bool active();
+    // Runs the passes, reading the scene from scene and drawing the last
+    // into the framebuffer object screen. Leaves screen bound.
+    void execute(FrameBuffer &scene, GLuint screen, Drawable &quad);
+    // Deallocates the pooled targets
+    void destroy();
+
+    // Passes the last execute() ran, and targets the pool holds
+    int passesRun() const;
+    int targetCount() const;
+
+private:
+    struct Pass {
+        std::string name;
+        PPShader *shader;
+        std::vector<std::string> inputs;
+        std::string output;
+        int divisor;
+        glm::vec4 params;
+        GLenum format;
+        bool enabled;
+    };
+    // A pass as it runs this frame. Every write makes a new resource;
+    // resource 0 is the scene.
+    struct Step {
+        const Pass *pass;
+        std::vector<int> inputs;
+        int output;
+        bool toScreen;
+        std::vector<int> released; // Resources nothing reads after this step
+    };
+
+    // Works out m_steps from the passes that are enabled
+    void compile();
+
+    OpenGLContext *mp_context;
+    RenderTargetPool m_pool;
+    std::vector<Pass> m_passes;
+    std::vector<Step> m_steps;
+    int m_resourceCount;
+    bool m_dirty; // The enabled passes changed since m_steps was made
+    unsigned int m_width, m_height;
+    int m_passesRun;
+};
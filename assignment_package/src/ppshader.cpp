@@ -1,11 +1,15 @@
 #include "ppshader.h"
+#include "frameuniforms.h"
 #include <QDateTime>
+#include <string>
 
 PPShader::PPShader(OpenGLContext *context)
     : SProgram(context),
       attrPos(-1), attrUV(-1),
-      unifDimensions(-1)
-{}
+      unifDimensions(-1), unifParams(-1), unifInputs()
+{
+    unifInputs.fill(-1);
+}
 
 PPShader::~PPShader()
 {}
@@ -18,6 +22,14 @@ void PPShader::setupMemberVars()
     unifTime = context->glGetUniformLocation(prog, "u_Time");
     unifSampler2D = context->glGetUniformLocation(prog, "u_RenderedTexture");
     unifDimensions = context->glGetUniformLocation(prog, "u_Dimensions");
+    unifParams = context->glGetUniformLocation(prog, "u_Params");
+    unifInputs[0] = unifSampler2D;
+    for (int i = 1; i < MAX_INPUTS; i++) {
+        std::string name = "u_Input" + std::to_string(i);
+        unifInputs[i] = context->glGetUniformLocation(prog, name.c_str());
+    }
+    // Time and the camera come from the shared PerFrame block
+    FrameUniforms::attach(context, prog);
 }
 
 void PPShader::draw(Drawable& d, int textureSlot = 0)
@@ -26,8 +38,13 @@ void PPShader::draw(Drawable& d, int textureSlot = 0)
     useMe();
 
     error = glGetError();
-    // Set our "renderedTexture" sampler to user Texture Unit 0
-    context->glUniform1i(unifSampler2D, textureSlot);
+    // Set our "renderedTexture" sampler to the given Texture Unit, and
+    // any further inputs to the units after it
+    for (int i = 0; i < MAX_INPUTS; i++) {
+        if (unifInputs[i] != -1) {
+            context->glUniform1i(unifInputs[i], textureSlot + i);
+        }
+    }
 
     // Each of the following blocks checks that:
     //   * This shader has this attribute, and
@@ -35,14 +52,16 @@ void PPShader::draw(Drawable& d, int textureSlot = 0)
     // If so, it binds the appropriate buffers to each attribute.
 
     error = glGetError();
+    unsigned int attribs = 0;
     if (attrPos != -1 && d.bindPos()) {
-        context->glEnableVertexAttribArray(attrPos);
         context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, NULL);
+        attribs |= 1u << attrPos;
     }
 //    if (attrUV != -1 && d.bindUV()) {
 //        context->glEnableVertexAttribArray(attrUV);
 //        context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, 0, NULL);
 //    }
+    context->glState().setAttribArrays(attribs);
 
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
@@ -52,8 +71,6 @@ void PPShader::draw(Drawable& d, int textureSlot = 0)
     context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
     error = glGetError();
 
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    error = glGetError();
     //if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
     //if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
     //if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
@@ -73,3 +90,13 @@ void PPShader::setDimensions(glm::ivec2 dims)
         context->glUniform2i(unifDimensions, dims.x, dims.y);
     }
 }
+
+void PPShader::setParams(const glm::vec4 &params)
+{
+    useMe();
+
+    if(unifParams != -1)
+    {
+        context->glUniform4fv(unifParams, 1, &params[0]);
+    }
+}
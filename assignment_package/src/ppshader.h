@@ -1,15 +1,21 @@
 #pragma once
 
 #include "sprogram.h"
+#include <array>
 
 class PPShader : public SProgram
 {
 public:
+    // Textures a pass can read. Input 0 is u_RenderedTexture and the
+    // rest are u_Input1, u_Input2, ... on the texture slots that follow.
+    static const int MAX_INPUTS = 3;
 
     int attrPos; // A handle for the "in" vec4 representing vertex position in the vertex shader
     int attrUV; // A handle for the "in" vec2 representing the UV coordinates in the vertex shader
 
     int unifDimensions; // A handle to the "uniform" ivec2 that stores the width and height of the texture being rendered
+    int unifParams; // A handle to the "uniform" vec4 of settings each pass using this shader may choose
+    std::array<int, MAX_INPUTS> unifInputs; // Handles to the input samplers; unifInputs[0] is unifSampler2D
 
 public:
     PPShader(OpenGLContext* context);
@@ -21,4 +27,5 @@ public:
     void draw(Drawable &d, int textureSlot) override;
 
     void setDimensions(glm::ivec2 dims);
+    void setParams(const glm::vec4 &params);
 };
@@ -0,0 +1,196 @@
+#include "programbuilder.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QOpenGLContext>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+#include <vector>
+
+// Bump whenever the file layout changes, so stale caches are ignored
+static const quint32 CACHE_VERSION = 1;
+
+struct BinaryHeader {
+    char magic[4];
+    quint32 version;
+    quint32 format; // GLenum the driver gave the binary
+    quint32 length;
+};
+
+ProgramBuilder::ProgramBuilder(OpenGLContext *context)
+    : mp_context(context), m_prog(0), m_vertShader(0), m_fragShader(0),
+      m_vertSource(), m_fragSource(), m_cacheFile(), m_binaryFormats(0), m_pending(false), m_fromBinary(false)
+{}
+
+void ProgramBuilder::enableParallelCompile(OpenGLContext *context) {
+    QOpenGLContext *gl = context->context();
+    const char *name = nullptr;
+    if (gl->hasExtension("GL_KHR_parallel_shader_compile")) {
+        name = "glMaxShaderCompilerThreadsKHR";
+    } else if (gl->hasExtension("GL_ARB_parallel_shader_compile")) {
+        name = "glMaxShaderCompilerThreadsARB";
+    } else {
+        return;
+    }
+    typedef void (QOPENGLF_APIENTRYP MaxShaderCompilerThreads)(GLuint count);
+    MaxShaderCompilerThreads maxThreads = reinterpret_cast<MaxShaderCompilerThreads>(gl->getProcAddress(name));
+    if (maxThreads != nullptr) {
+        // All ones means as many as the driver wants
+        maxThreads(0xFFFFFFFF);
+    }
+}
+
+static QByteArray glString(OpenGLContext *context, GLenum e) {
+    return QByteArray(reinterpret_cast<const char*>(context->glGetString(e)));
+}
+
+void ProgramBuilder::start(GLuint prog, const QByteArray &vertSource, const QByteArray &fragSource) {
+    m_prog = prog;
+    m_vertShader = m_fragShader = 0;
+    m_vertSource = vertSource;
+    m_fragSource = fragSource;
+    m_pending = true;
+
+    m_cacheFile.clear();
+    m_binaryFormats = 0;
+    mp_context->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &m_binaryFormats);
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (m_binaryFormats > 0 && !cacheDir.isEmpty()) {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(vertSource);
+        hash.addData(QByteArray("\n"));
+        hash.addData(fragSource);
+        for (GLenum e : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            hash.addData(QByteArray("\n"));
+            hash.addData(glString(mp_context, e));
+        }
+        m_cacheFile = QDir(cacheDir).filePath("shaders/" + QString(hash.result().toHex()) + ".bin");
+    }
+
+    m_fromBinary = loadBinary();
+    if (!m_fromBinary) {
+        compileAndLink();
+    }
+}
+
+bool ProgramBuilder::pending() const {
+    return m_pending;
+}
+
+// Issues the compile and link without asking how they went, since
+// asking is what makes the driver finish them
+void ProgramBuilder::compileAndLink() {
+    m_vertShader = mp_context->glCreateShader(GL_VERTEX_SHADER);
+    m_fragShader = mp_context->glCreateShader(GL_FRAGMENT_SHADER);
+    const char *vert = m_vertSource.constData();
+    const char *frag = m_fragSource.constData();
+    mp_context->glShaderSource(m_vertShader, 1, &vert, 0);
+    mp_context->glShaderSource(m_fragShader, 1, &frag, 0);
+    mp_context->glCompileShader(m_vertShader);
+    mp_context->glCompileShader(m_fragShader);
+
+    mp_context->glAttachShader(m_prog, m_vertShader);
+    mp_context->glAttachShader(m_prog, m_fragShader);
+    if (!m_cacheFile.isEmpty()) {
+        mp_context->glProgramParameteri(m_prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    mp_context->glLinkProgram(m_prog);
+}
+
+bool ProgramBuilder::loadBinary() {
+    // A driver with no binary formats cannot load any, whatever is cached
+    if (m_binaryFormats <= 0 || m_cacheFile.isEmpty()) {
+        return false;
+    }
+    QFile f(m_cacheFile);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QByteArray bytes = f.readAll();
+    BinaryHeader header;
+    if (bytes.size() < static_cast<int>(sizeof(header))) {
+        return false;
+    }
+    std::memcpy(&header, bytes.constData(), sizeof(header));
+    if (std::memcmp(header.magic, "PBIN", 4) != 0 || header.version != CACHE_VERSION
+            || static_cast<int>(header.length) != bytes.size() - static_cast<int>(sizeof(header))) {
+        return false;
+    }
+    mp_context->glProgramBinary(m_prog, header.format, bytes.constData() + sizeof(header), header.length);
+    return true;
+}
+
+void ProgramBuilder::saveBinary() const {
+    GLint length = 0;
+    mp_context->glGetProgramiv(m_prog, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    mp_context->glGetProgramBinary(m_prog, length, &length, &format, binary.data());
+
+    if (!QDir().mkpath(QFileInfo(m_cacheFile).absolutePath())) {
+        return;
+    }
+    QSaveFile f(m_cacheFile);
+    if (!f.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    BinaryHeader header;
+    std::memcpy(header.magic, "PBIN", 4);
+    header.version = CACHE_VERSION;
+    header.format = format;
+    header.length = length;
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    f.write(binary.data(), length);
+    // A binary that fails to save is simply compiled again next launch
+    f.commit();
+}
+
+bool ProgramBuilder::finish() {
+    if (!m_pending) {
+        return false;
+    }
+    m_pending = false;
+
+    GLint linked = GL_FALSE;
+    if (m_fromBinary) {
+        mp_context->glGetProgramiv(m_prog, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            // Most likely a driver update the key did not catch
+            m_fromBinary = false;
+            compileAndLink();
+        }
+    }
+    if (!m_fromBinary) {
+        GLint compiled;
+        mp_context->glGetShaderiv(m_vertShader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            mp_context->printShaderInfoLog(m_vertShader);
+        }
+        mp_context->glGetShaderiv(m_fragShader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            mp_context->printShaderInfoLog(m_fragShader);
+        }
+        mp_context->glGetProgramiv(m_prog, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            mp_context->printLinkInfoLog(m_prog);
+        } else if (!m_cacheFile.isEmpty()) {
+            saveBinary();
+        }
+    }
+    // The linked program keeps what it needs, so the shaders can go
+    if (m_vertShader != 0) {
+        mp_context->glDetachShader(m_prog, m_vertShader);
+        mp_context->glDetachShader(m_prog, m_fragShader);
+        mp_context->glDeleteShader(m_vertShader);
+        mp_context->glDeleteShader(m_fragShader);
+        m_vertShader = m_fragShader = 0;
+    }
+    m_vertSource.clear();
+    m_fragSource.clear();
+    return linked;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "openglcontext.h"
+#include <QByteArray>
+#include <QString>
+
+// Builds one GL program from GLSL source, split into start() and
+// finish() so that nothing waits on the driver until the program is
+// first needed. Starting every program before finishing any lets a
+// driver with KHR_parallel_shader_compile build them all at once.
+//
+// Each linked program's binary is saved to the user's cache directory,
+// keyed on a hash of its source and the GL vendor, renderer and version
+// strings, and the next launch loads it instead of compiling. A binary
+// the driver refuses is simply rebuilt from source.
+class ProgramBuilder {
+public:
+    ProgramBuilder(OpenGLContext *context);
+
+    // Lets the driver compile on as many threads as it likes, if it
+    // supports KHR_parallel_shader_compile. Call once per context,
+    // before starting any programs.
+    static void enableParallelCompile(OpenGLContext *context);
+
+    // Starts building prog from the given source, from the cached
+    // binary if there is one
+    void start(GLuint prog, const QByteArray &vertSource, const QByteArray &fragSource);
+    // Whether start() has been called without finish()
+    bool pending() const;
+    // Waits for prog to finish building, prints any errors, saves the
+    // binary of a program built from source and deletes its shaders.
+    // Returns whether prog linked.
+    bool finish();
+
+private:
+    void compileAndLink();
+    bool loadBinary();
+    void saveBinary() const;
+
+    OpenGLContext *mp_context;
+    GLuint m_prog, m_vertShader, m_fragShader;
+    // Kept until finish() in case the cached binary is refused
+    QByteArray m_vertSource, m_fragSource;
+    QString m_cacheFile; // Empty when the driver cannot save binaries
+    GLint m_binaryFormats; // GL_NUM_PROGRAM_BINARY_FORMATS
+    bool m_pending, m_fromBinary;
+};
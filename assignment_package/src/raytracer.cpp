@@ -0,0 +1,170 @@
+#include "raytracer.h"
+#include "parallelfor.h"
+#include <atomic>
+
+// Same as the light direction MyGL gives the shaders and the GL clear color
+static const glm::vec3 SUN_DIR = glm::normalize(glm::vec3(0.5f, 1.f, 0.75f));
+static const glm::vec3 SKY_COLOR(0.37f, 0.74f, 1.f);
+static const float AMBIENT = 0.2f;
+// How far secondary rays start from the surface they leave
+static const float SURFACE_OFFSET = 1e-3f;
+
+static bool isVisible(BlockType t) {
+    return t != EMPTY;
+}
+
+// The normal of the face a ray hit. A ray that started inside a block
+// is treated as having come through the face it was heading away from.
+static glm::ivec3 faceNormal(const RayHit &hit, glm::vec3 dir) {
+    if (hit.normal != glm::ivec3(0)) {
+        return hit.normal;
+    }
+    glm::vec3 a = glm::abs(dir);
+    int axis = a.x > a.y ? (a.x > a.z ? 0 : 2) : (a.y > a.z ? 1 : 2);
+    glm::ivec3 n(0);
+    n[axis] = dir[axis] > 0.f ? -1 : 1;
+    return n;
+}
+
+// Index into adjacentFaces (and Direction) of the face with normal n
+static int faceIndex(glm::ivec3 n) {
+    return n.x != 0 ? (n.x > 0 ? XPOS : XNEG) : (n.y != 0 ? (n.y > 0 ? YPOS : YNEG) : (n.z > 0 ? ZPOS : ZNEG));
+}
+
+static QRgb toRgb(glm::vec3 c) {
+    glm::ivec3 i = glm::ivec3(glm::clamp(c, 0.f, 1.f) * 255.f + 0.5f);
+    return qRgb(i.r, i.g, i.b);
+}
+
+Raytracer::Raytracer(const QImage &atlas)
+    : m_tileSize(16), m_maxDist(256.f), m_shadows(true),
+      m_atlas(atlas.convertToFormat(QImage::Format_ARGB32).mirrored())
+{}
+
+glm::vec4 Raytracer::sampleAtlas(glm::vec2 uv) const {
+    int x = glm::clamp(static_cast<int>(uv.x * m_atlas.width()), 0, m_atlas.width() - 1);
+    int y = glm::clamp(static_cast<int>(uv.y * m_atlas.height()), 0, m_atlas.height() - 1);
+    QRgb texel = reinterpret_cast<const QRgb*>(m_atlas.constScanLine(y))[x];
+    return glm::vec4(qRed(texel), qGreen(texel), qBlue(texel), qAlpha(texel)) / 255.f;
+}
+
+glm::vec4 Raytracer::shade(const Terrain &terrain, const RayHit &hit, glm::vec3 origin, glm::vec3 dir, bool inShadow) const {
+    glm::ivec3 n = faceNormal(hit, dir);
+    const BlockFace &face = adjacentFaces[faceIndex(n)];
+
+    // The mesher gives the face's first vertex UV (0, 0), its second
+    // (1, 0) and its fourth (0, 1), in tiles
+    glm::vec3 local = glm::clamp(origin + dir * hit.dist - glm::vec3(hit.block), 0.f, 0.999f);
+    glm::vec3 v0(face.vertices[0].pos), v1(face.vertices[1].pos), v3(face.vertices[3].pos);
+    glm::vec2 inTile(glm::dot(local - v0, v1 - v0), glm::dot(local - v0, v3 - v0));
+    glm::vec4 albedo = sampleAtlas(atlasUV(hit.type, face.direction) + inTile / 16.f);
+
+    // Faces are lit by the block they look into
+    glm::ivec3 facing = hit.block + n;
+    unsigned char light = 0;
+    if (terrain.hasChunkAt(hit.block.x, hit.block.z)) {
+        const Chunk *c = terrain.getChunkAt(hit.block.x, hit.block.z).get();
+        light = c->getLightAt(facing.x - c->m_coords.x, facing.y, facing.z - c->m_coords.y);
+    }
+    float sky = skyLight(light) / 15.f, block = blockLight(light) / 15.f;
+
+    float diffuse = inShadow ? 0.f : glm::clamp(glm::dot(glm::vec3(n), SUN_DIR), 0.f, 1.f);
+    float intensity = diffuse * sky + AMBIENT;
+    intensity *= glm::mix(0.05f, 1.f, glm::pow(0.8f, 15.f * (1.f - glm::max(sky, block))));
+    return glm::vec4(glm::vec3(albedo) * intensity, albedo.a);
+}
+
+void Raytracer::renderTile(const Terrain &terrain, const CameraPose &camera, float tanHalfFovy,
+                           int width, int height, int tile, QRgb *pixels, int stride) const {
+    int tilesX = (width + m_tileSize - 1) / m_tileSize;
+    int x0 = (tile % tilesX) * m_tileSize, y0 = (tile / tilesX) * m_tileSize;
+    int x1 = std::min(x0 + m_tileSize, width), y1 = std::min(y0 + m_tileSize, height);
+    float aspect = width / static_cast<float>(height);
+
+    std::vector<Ray> rays;
+    rays.reserve((x1 - x0) * (y1 - y0));
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            glm::vec2 ndc((x + 0.5f) / width * 2.f - 1.f, 1.f - (y + 0.5f) / height * 2.f);
+            glm::vec3 dir = camera.forward
+                    + camera.right * (ndc.x * tanHalfFovy * aspect)
+                    + camera.up * (ndc.y * tanHalfFovy);
+            rays.push_back(Ray{camera.position, glm::normalize(dir), m_maxDist});
+        }
+    }
+    std::vector<RayHit> hits;
+    raycastBatch(terrain, rays, &hits, isVisible);
+
+    // Secondary rays: one toward the sun from every hit, and one on
+    // through every hit on water. Each lists the pixel it belongs to.
+    std::vector<Ray> shadowRays, throughRays;
+    std::vector<int> shadowPixel, throughPixel;
+    for (size_t i = 0; i < hits.size(); i++) {
+        if (!hits[i].hit) {
+            continue;
+        }
+        glm::vec3 p = rays[i].origin + rays[i].direction * hits[i].dist;
+        if (m_shadows) {
+            glm::vec3 n(faceNormal(hits[i], rays[i].direction));
+            shadowRays.push_back(Ray{p + n * SURFACE_OFFSET, SUN_DIR, m_maxDist});
+            shadowPixel.push_back(i);
+        }
+        if (isTransparent(hits[i].type)) {
+            throughRays.push_back(Ray{p + rays[i].direction * SURFACE_OFFSET, rays[i].direction,
+                                      m_maxDist - hits[i].dist});
+            throughPixel.push_back(i);
+        }
+    }
+    std::vector<RayHit> shadowHits, throughHits;
+    raycastBatch(terrain, shadowRays, &shadowHits, isOpaque);
+    raycastBatch(terrain, throughRays, &throughHits, isOpaque);
+
+    std::vector<unsigned char> shadowed(hits.size(), 0);
+    for (size_t i = 0; i < shadowHits.size(); i++) {
+        shadowed[shadowPixel[i]] = shadowHits[i].hit;
+    }
+    std::vector<glm::vec4> surface(hits.size());
+    std::vector<glm::vec3> color(hits.size(), SKY_COLOR);
+    for (size_t i = 0; i < hits.size(); i++) {
+        if (hits[i].hit) {
+            surface[i] = shade(terrain, hits[i], rays[i].origin, rays[i].direction, shadowed[i]);
+            color[i] = glm::vec3(surface[i]);
+        }
+    }
+    // Blend whatever lies behind the water under its surface
+    for (size_t i = 0; i < throughHits.size(); i++) {
+        int pixel = throughPixel[i];
+        glm::vec3 behind = SKY_COLOR;
+        if (throughHits[i].hit) {
+            behind = glm::vec3(shade(terrain, throughHits[i], throughRays[i].origin, throughRays[i].direction, false));
+        }
+        color[pixel] = glm::mix(behind, glm::vec3(surface[pixel]), surface[pixel].a);
+    }
+
+    int i = 0;
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            pixels[y * stride + x] = toRgb(color[i++]);
+        }
+    }
+}
+
+QImage Raytracer::render(const Terrain &terrain, const CameraPose &camera, float fovy, int width, int height) const {
+    QImage image(width, height, QImage::Format_RGB32);
+    // Taken once up front so the threads never make the image detach
+    QRgb *pixels = reinterpret_cast<QRgb*>(image.bits());
+    int stride = image.bytesPerLine() / sizeof(QRgb);
+    float tanHalfFovy = glm::tan(glm::radians(fovy) / 2.f);
+
+    int tiles = ((width + m_tileSize - 1) / m_tileSize) * ((height + m_tileSize - 1) / m_tileSize);
+    std::atomic<int> nextTile(0);
+    int threads = std::max(1, QThread::idealThreadCount());
+    parallelFor(threads, 1, [&](int begin, int end) {
+        for (int t = begin; t < end; t++) {
+            for (int tile = nextTile++; tile < tiles; tile = nextTile++) {
+                renderTile(terrain, camera, tanHalfFovy, width, height, tile, pixels, stride);
+            }
+        }
+    });
+    return image;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "scene/terrain.h"
+#include "scene/camera.h"
+#include "scene/raycast.h"
+#include <QImage>
+
+// Draws the terrain on the CPU by casting a ray through every pixel,
+// for previews rendered where there is no GPU.
+//
+// The image is split into square tiles that every core takes turns
+// claiming, so busy parts of the picture don't hold up the rest. The
+// rays of a tile are cast together with raycastBatch; then a shadow ray
+// toward the sun is cast from everything they hit, and rays that hit
+// water are continued through it. Faces are textured from the same
+// atlas tiles and UVs the mesher gives them and lit like the Lambert
+// shader does, from the Chunks' sky and block light.
+class Raytracer {
+public:
+    int m_tileSize; // Width and height of a tile, in pixels
+    float m_maxDist; // Rays that hit nothing this close show the sky
+    bool m_shadows;
+
+    // atlas is the block texture atlas, as loaded from the resources
+    Raytracer(const QImage &atlas);
+
+    // fovy is the vertical field of view in degrees, as in Camera.
+    // Only reads the terrain, so the caller must not change it meanwhile.
+    QImage render(const Terrain &terrain, const CameraPose &camera, float fovy, int width, int height) const;
+
+private:
+    // Flipped and converted the same way Texture does it, so UVs
+    // index it exactly as they index the GL texture
+    QImage m_atlas;
+
+    // Color and alpha of the atlas at uv, nearest texel
+    glm::vec4 sampleAtlas(glm::vec2 uv) const;
+    // Shaded color and alpha of the face a ray along dir hit
+    glm::vec4 shade(const Terrain &terrain, const RayHit &hit, glm::vec3 origin, glm::vec3 dir, bool inShadow) const;
+
+    void renderTile(const Terrain &terrain, const CameraPose &camera, float tanHalfFovy,
+                    int width, int height, int tile, QRgb *pixels, int stride) const;
+};
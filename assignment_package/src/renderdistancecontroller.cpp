@@ -0,0 +1,95 @@
+#include "renderdistancecontroller.h"
+#include <algorithm>
+
+// Grow only when there is plenty of headroom, shrink as soon as we
+// are meaningfully over budget. The gap between the two is the
+// hysteresis band in which the radius is left alone.
+static const float GROW_THRESHOLD = 0.7f;
+static const float SHRINK_THRESHOLD = 1.05f;
+// Consecutive frames a condition must hold before acting on it.
+// Shrinking reacts faster than growing since a slow frame is
+// more noticeable than a slightly short view distance.
+static const int FRAMES_TO_GROW = 90;
+static const int FRAMES_TO_SHRINK = 20;
+// Frames to ignore after a change so the new radius can settle
+// (new chunks are meshed and uploaded over several frames)
+static const int COOLDOWN_FRAMES = 120;
+// Above this many outstanding chunk jobs the workers are not
+// keeping up, so streaming in even more terrain would only
+// make the visible holes worse
+static const int MAX_PENDING_JOBS_TO_GROW = 32;
+static const float SMOOTHING = 0.1f;
+
+RenderDistanceController::RenderDistanceController(float frameBudgetMs, int minRadius, int maxRadius, int initialRadius)
+    : m_frameBudgetMs(frameBudgetMs), m_minRadius(minRadius), m_maxRadius(maxRadius),
+      m_drawRadius(std::clamp(initialRadius, minRadius, maxRadius)),
+      m_smoothedMs(0.f), m_framesOverBudget(0), m_framesUnderBudget(0),
+      m_cooldown(COOLDOWN_FRAMES), m_lastCpuMs(0.f), m_lastGpuMs(0.f)
+{}
+
+void RenderDistanceController::recordFrame(float cpuMs, float gpuMs, int pendingJobs) {
+    m_lastCpuMs = cpuMs;
+    m_lastGpuMs = gpuMs;
+
+    // The CPU and GPU work in parallel, so whichever is slower
+    // determines how long a frame takes
+    float frameMs = std::max(cpuMs, gpuMs);
+    if(m_smoothedMs == 0.f) {
+        m_smoothedMs = frameMs;
+    } else {
+        m_smoothedMs += SMOOTHING * (frameMs - m_smoothedMs);
+    }
+
+    if(m_cooldown > 0) {
+        m_cooldown--;
+        return;
+    }
+
+    if(m_smoothedMs > m_frameBudgetMs * SHRINK_THRESHOLD) {
+        m_framesOverBudget++;
+        m_framesUnderBudget = 0;
+    } else if(m_smoothedMs < m_frameBudgetMs * GROW_THRESHOLD
+              && pendingJobs <= MAX_PENDING_JOBS_TO_GROW) {
+        m_framesUnderBudget++;
+        m_framesOverBudget = 0;
+    } else {
+        m_framesOverBudget = 0;
+        m_framesUnderBudget = 0;
+    }
+
+    int newRadius = m_drawRadius;
+    if(m_framesOverBudget >= FRAMES_TO_SHRINK) {
+        newRadius = std::max(m_minRadius, m_drawRadius - 1);
+    } else if(m_framesUnderBudget >= FRAMES_TO_GROW) {
+        newRadius = std::min(m_maxRadius, m_drawRadius + 1);
+    }
+
+    if(newRadius != m_drawRadius) {
+        m_drawRadius = newRadius;
+        m_cooldown = COOLDOWN_FRAMES;
+        m_framesOverBudget = 0;
+        m_framesUnderBudget = 0;
+    }
+}
+
+int RenderDistanceController::drawRadius() const {
+    return m_drawRadius;
+}
+
+int RenderDistanceController::zoneRadius() const {
+    // Number of zones needed to cover the drawn chunks, plus one
+    // ring so terrain is already generated when it comes into view
+    return (m_drawRadius * 16 + 63) / 64 + 1;
+}
+
+float RenderDistanceController::smoothedFrameMs() const {
+    return m_smoothedMs;
+}
+
+float RenderDistanceController::lastCpuMs() const {
+    return m_lastCpuMs;
+}
+
+float RenderDistanceController::lastGpuMs() const {
+    return m_lastGpuMs;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// Chooses how far around the player terrain is drawn and streamed
+// so that frames stay within a fixed time budget.
+// Every frame MyGL reports how long the CPU and GPU took along with
+// the number of terrain jobs still waiting on worker threads. The
+// controller keeps a smoothed frame time and only changes the radius
+// after the frame time has stayed clearly above (or below) the budget
+// for a number of consecutive frames, then waits out a cooldown before
+// it may change again. The gap between the grow and shrink thresholds
+// plus the cooldown keep the radius from oscillating.
+class RenderDistanceController {
+private:
+    float m_frameBudgetMs; // Target time for one frame of work
+    int m_minRadius, m_maxRadius; // Limits on the draw radius, in chunks
+    int m_drawRadius; // Current draw radius, in chunks
+
+    float m_smoothedMs; // Exponential moving average of the frame time
+    int m_framesOverBudget, m_framesUnderBudget;
+    int m_cooldown; // Frames to wait before the radius may change again
+
+    float m_lastCpuMs, m_lastGpuMs;
+
+public:
+    RenderDistanceController(float frameBudgetMs, int minRadius, int maxRadius, int initialRadius);
+
+    // Feed one frame's measurements into the controller.
+    // pendingJobs is the number of chunks still waiting to be
+    // generated or meshed; the radius never grows while the
+    // workers are falling behind.
+    void recordFrame(float cpuMs, float gpuMs, int pendingJobs);
+
+    // Radius in chunks around the player's chunk that is drawn
+    int drawRadius() const;
+    // Radius in 64 x 64 terrain zones around the player's zone that is
+    // kept generated. Always covers the draw radius plus one zone of margin.
+    int zoneRadius() const;
+
+    float smoothedFrameMs() const;
+    float lastCpuMs() const;
+    float lastGpuMs() const;
+};
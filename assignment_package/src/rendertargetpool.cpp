@@ -0,0 +1,45 @@
+#include "rendertargetpool.h"
+
+RenderTargetPool::RenderTargetPool(OpenGLContext *context)
+    : mp_context(context), m_targets()
+{}
+
+RenderTargetPool::~RenderTargetPool()
+{}
+
+FrameBuffer *RenderTargetPool::acquire(unsigned int width, unsigned int height, GLenum format) {
+    for (Entry &e : m_targets) {
+        if (!e.inUse && e.target->pixelWidth() == width && e.target->pixelHeight() == height
+                && e.target->colorFormat() == format) {
+            e.inUse = true;
+            return e.target.get();
+        }
+    }
+    // Passes only ever draw full-screen quads, so no depth buffer
+    Entry e;
+    e.target = mkU<FrameBuffer>(mp_context, width, height, 1, format, false);
+    e.target->create();
+    e.inUse = true;
+    m_targets.push_back(std::move(e));
+    return m_targets.back().target.get();
+}
+
+void RenderTargetPool::release(FrameBuffer *target) {
+    for (Entry &e : m_targets) {
+        if (e.target.get() == target) {
+            e.inUse = false;
+            return;
+        }
+    }
+}
+
+void RenderTargetPool::clear() {
+    for (Entry &e : m_targets) {
+        e.target->destroy();
+    }
+    m_targets.clear();
+}
+
+int RenderTargetPool::size() const {
+    return m_targets.size();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "framebuffer.h"
+#include "smartpointerhelp.h"
+#include <vector>
+
+// Colour-only FrameBuffers handed out to post-processing passes for as
+// long as they need them. A released target goes back to the pool and
+// is given to the next pass asking for the same size and format, so a
+// chain of passes ping-pongs between a few textures instead of each
+// effect keeping its own.
+class RenderTargetPool {
+public:
+    RenderTargetPool(OpenGLContext *context);
+    ~RenderTargetPool();
+
+    // A target of exactly this size in pixels and format that no one
+    // else holds, made if none is free
+    FrameBuffer *acquire(unsigned int width, unsigned int height, GLenum format);
+    // Gives target back for the next acquire()
+    void release(FrameBuffer *target);
+    // Destroys every target, e.g. once the screen size has changed.
+    // None may be held.
+    void clear();
+
+    // Targets that exist, whether held or free
+    int size() const;
+
+private:
+    struct Entry {
+        uPtr<FrameBuffer> target;
+        bool inUse;
+    };
+
+    OpenGLContext *mp_context;
+    std::vector<Entry> m_targets;
+};
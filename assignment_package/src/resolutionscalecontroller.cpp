@@ -0,0 +1,63 @@
+#include "resolutionscalecontroller.h"
+#include <algorithm>
+#include <cmath>
+
+// Aim a little under the budget, so a scale that has settled has room
+// for the frame that costs more than usual
+static const float TARGET_FRACTION = 0.9f;
+// Within this much of the target the scale is left alone
+static const float TOLERANCE = 0.08f;
+// Frames between changes. The GPU timer lags up to four behind.
+static const int FRAMES_PER_CHANGE = 8;
+// Largest change to the scale in one step
+static const float MAX_STEP = 0.1f;
+// Scales are rounded to this, so noise alone does not move them
+static const float QUANTUM = 1.f / 64.f;
+static const float SMOOTHING = 0.2f;
+
+ResolutionScaleController::ResolutionScaleController(float frameBudgetMs, float minScale, float maxScale)
+    : m_frameBudgetMs(frameBudgetMs), m_minScale(minScale), m_maxScale(maxScale),
+      m_scale(maxScale), m_smoothedMs(0.f), m_framesSinceChange(0)
+{}
+
+void ResolutionScaleController::recordFrame(float gpuMs) {
+    // No timer queries on this GPU, so there is nothing to go by
+    if(gpuMs <= 0.f) {
+        return;
+    }
+    if(m_smoothedMs == 0.f) {
+        m_smoothedMs = gpuMs;
+    } else {
+        m_smoothedMs += SMOOTHING * (gpuMs - m_smoothedMs);
+    }
+
+    if(++m_framesSinceChange < FRAMES_PER_CHANGE) {
+        return;
+    }
+    float ratio = m_frameBudgetMs * TARGET_FRACTION / m_smoothedMs;
+    if(std::abs(ratio - 1.f) < TOLERANCE) {
+        return;
+    }
+    float target = m_scale * std::sqrt(ratio);
+    target = std::clamp(target, m_scale - MAX_STEP, m_scale + MAX_STEP);
+    target = std::round(target / QUANTUM) * QUANTUM;
+    target = std::clamp(target, m_minScale, m_maxScale);
+    if(target != m_scale) {
+        m_scale = target;
+        m_framesSinceChange = 0;
+    }
+}
+
+void ResolutionScaleController::reset() {
+    m_scale = m_maxScale;
+    m_smoothedMs = 0.f;
+    m_framesSinceChange = 0;
+}
+
+float ResolutionScaleController::scale() const {
+    return m_scale;
+}
+
+float ResolutionScaleController::smoothedGpuMs() const {
+    return m_smoothedMs;
+}
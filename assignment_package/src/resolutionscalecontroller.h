@@ -0,0 +1,32 @@
+#pragma once
+
+// Chooses the fraction of the screen's resolution the 3D scene is drawn
+// at so that the GPU's share of a frame stays within a fixed budget.
+// Where filling pixels is the bottleneck, as on HiDPI screens, GPU time
+// grows with the number of pixels drawn, i.e. with the square of the
+// scale. So every few frames the controller moves the scale by the
+// square root of how far the smoothed GPU time is from the budget,
+// within a band it leaves alone and a limit on each step.
+//
+// The GPU timer lags a few frames behind, so the controller waits
+// longer than that between changes to see the effect of the last one.
+class ResolutionScaleController {
+private:
+    float m_frameBudgetMs; // Target GPU time for one frame
+    float m_minScale, m_maxScale;
+    float m_scale; // Current fraction of the screen's width and height
+
+    float m_smoothedMs; // Exponential moving average of the GPU time
+    int m_framesSinceChange;
+
+public:
+    ResolutionScaleController(float frameBudgetMs, float minScale, float maxScale);
+
+    // Feed one frame's GPU time into the controller
+    void recordFrame(float gpuMs);
+    // Back to full scale, forgetting the frames seen so far
+    void reset();
+
+    float scale() const;
+    float smoothedGpuMs() const;
+};
@@ -0,0 +1,127 @@
+#pragma once
+#include "chunkhelpers.h"
+#include "glm_includes.h"
+#include <array>
+
+// Everything the game needs to know about a kind of block.
+// To add a block type, add it to the BlockType enum and add its
+// row to BLOCK_PROPERTIES below in the same position.
+struct BlockProperties {
+    // Hides the faces of the blocks next to it
+    bool opaque;
+    // The player collides with it and block raycasts stop at it
+    bool solid;
+    // A liquid the player can swim in
+    bool fluid;
+    // Block light level it gives off, 0 to 15
+    unsigned char emission;
+    // For fluids, how many blocks it flows sideways from a source
+    unsigned char flowRange;
+    // Picked by BlockTickScheduler's random ticks
+    bool randomTicks;
+    // Rough average color of its texture, for particles
+    unsigned char color[3];
+    // Texture atlas tile (column, row) for each face, in Direction order
+    unsigned char tiles[6][2];
+};
+
+constexpr int NUM_BLOCK_TYPES = BEDROCK + 1;
+
+// Tile shown for block types that do not have a texture yet
+#define DEBUG_TILES {{10, 3}, {10, 3}, {10, 3}, {10, 3}, {10, 3}, {10, 3}}
+#define SAME_TILES(c, r) {{c, r}, {c, r}, {c, r}, {c, r}, {c, r}, {c, r}}
+
+// Indexed by BlockType
+constexpr std::array<BlockProperties, NUM_BLOCK_TYPES> BLOCK_PROPERTIES {{
+    // EMPTY
+    {false, false, false, 0, 0, false, {0, 0, 0}, DEBUG_TILES},
+    // GRASS: grass on top, dirt on the bottom, grassy dirt on the sides
+    {true, true, false, 0, 0, true, {95, 159, 53}, {{3, 15}, {3, 15}, {8, 13}, {2, 15}, {3, 15}, {3, 15}}},
+    // DIRT
+    {true, true, false, 0, 0, false, {134, 96, 67}, SAME_TILES(2, 15)},
+    // STONE
+    {true, true, false, 0, 0, false, {125, 125, 125}, SAME_TILES(1, 15)},
+    // WATER
+    {false, false, true, 0, 7, false, {47, 92, 220}, SAME_TILES(13, 3)},
+    // SNOW
+    {true, true, false, 0, 0, true, {240, 250, 250}, SAME_TILES(2, 11)},
+    // UNDETERMINED: stands in for blocks in Chunks that do not exist,
+    // which are treated as a wall
+    {true, true, false, 0, 0, false, {255, 0, 255}, DEBUG_TILES},
+    // LAVA
+    {false, false, true, 15, 3, true, {207, 92, 15}, SAME_TILES(13, 1)},
+    // BEDROCK
+    {true, true, false, 0, 0, false, {85, 85, 85}, SAME_TILES(1, 15)},
+}};
+
+#undef DEBUG_TILES
+#undef SAME_TILES
+
+// Flat per-property tables so hot loops read a single byte
+template <typename T, typename F>
+constexpr std::array<T, NUM_BLOCK_TYPES> makeBlockTable(F property) {
+    std::array<T, NUM_BLOCK_TYPES> table {};
+    for(int i = 0; i < NUM_BLOCK_TYPES; i++) {
+        table[i] = property(BLOCK_PROPERTIES[i]);
+    }
+    return table;
+}
+
+constexpr std::array<bool, NUM_BLOCK_TYPES> BLOCK_OPAQUE =
+        makeBlockTable<bool>([](const BlockProperties &p) { return p.opaque; });
+constexpr std::array<bool, NUM_BLOCK_TYPES> BLOCK_SOLID =
+        makeBlockTable<bool>([](const BlockProperties &p) { return p.solid; });
+constexpr std::array<bool, NUM_BLOCK_TYPES> BLOCK_FLUID =
+        makeBlockTable<bool>([](const BlockProperties &p) { return p.fluid; });
+constexpr std::array<unsigned char, NUM_BLOCK_TYPES> BLOCK_EMISSION =
+        makeBlockTable<unsigned char>([](const BlockProperties &p) { return p.emission; });
+constexpr std::array<unsigned char, NUM_BLOCK_TYPES> BLOCK_FLOW_RANGE =
+        makeBlockTable<unsigned char>([](const BlockProperties &p) { return p.flowRange; });
+constexpr std::array<bool, NUM_BLOCK_TYPES> BLOCK_RANDOM_TICKS =
+        makeBlockTable<bool>([](const BlockProperties &p) { return p.randomTicks; });
+
+inline bool isOpaque(BlockType t) {
+    return BLOCK_OPAQUE[t];
+}
+
+inline bool isSolid(BlockType t) {
+    return BLOCK_SOLID[t];
+}
+
+inline bool isFluid(BlockType t) {
+    return BLOCK_FLUID[t];
+}
+
+// Drawn in the transparent pass: anything visible that is not opaque
+inline bool isTransparent(BlockType t) {
+    return t != EMPTY && !BLOCK_OPAQUE[t];
+}
+
+inline unsigned char lightEmission(BlockType t) {
+    return BLOCK_EMISSION[t];
+}
+
+inline unsigned char flowRange(BlockType t) {
+    return BLOCK_FLOW_RANGE[t];
+}
+
+inline bool hasRandomTicks(BlockType t) {
+    return BLOCK_RANDOM_TICKS[t];
+}
+
+inline glm::vec3 blockColor(BlockType t) {
+    const unsigned char *c = BLOCK_PROPERTIES[t].color;
+    return glm::vec3(c[0], c[1], c[2]) / 255.f;
+}
+
+// Offset of the face's tile in the texture atlas, in [0, 1] UV space
+inline glm::vec2 atlasUV(BlockType t, Direction face) {
+    const unsigned char *tile = BLOCK_PROPERTIES[t].tiles[face];
+    return glm::vec2(tile[0], tile[1]) / 16.f;
+}
+
+// Layer of the face's tile in the block TextureArray
+inline int atlasLayer(BlockType t, Direction face) {
+    const unsigned char *tile = BLOCK_PROPERTIES[t].tiles[face];
+    return tile[0] + 16 * tile[1];
+}
@@ -0,0 +1,227 @@
+#include "blocktickscheduler.h"
+#include "blockregistry.h"
+#include "lightengine.h"
+#include "zoneprefetcher.h"
+#include "blocktickworker.h"
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+
+// Block tick workers are short, so they go ahead of terrain generation
+static const int BLOCK_TICK_WORKER_PRIORITY = ZonePrefetcher::RING_PRIORITY + 1;
+// Snow stops piling up once it is this many blocks deep
+static const int MAX_SNOW_DEPTH = 3;
+// Sky light grass needs to spread onto a dirt block
+static const unsigned char MIN_GRASS_SKY_LIGHT = 9;
+
+// Block at local x, y, z of c, which may lie one block into a neighbor.
+// Missing Chunks, Chunks still being generated and the world's
+// bottom come back UNDETERMINED; the sky above the world is EMPTY.
+static BlockType blockAt(const Chunk *c, int x, int y, int z, Chunk **holder = nullptr) {
+    if (y >= 256) {
+        return EMPTY;
+    }
+    Chunk *n = y < 0 ? nullptr : c->getChunkContaining(x, z);
+    if (n == nullptr || n->m_generationState != GENERATED) {
+        return UNDETERMINED;
+    }
+    if (holder != nullptr) {
+        *holder = n;
+    }
+    return n->getBlockAt(x, y, z);
+}
+
+BlockTickScheduler::BlockTickScheduler()
+    : m_tickLength(5.f), m_workerBudgetMs(2.f), m_applyBudgetMs(1.f),
+      m_scheduled(), m_tick(0), m_nextOrder(0), m_tickTimer(0.f),
+      m_workersInFlight(0), m_workersFinished(0), m_results(), m_unfinished(),
+      m_resultsLock(), m_changes()
+{}
+
+void BlockTickScheduler::schedule(Chunk *c, int x, int y, int z, int delay) {
+    m_scheduled[c].insert(ScheduledUpdate{m_tick + std::max(delay, 1), m_nextOrder++,
+                                          (unsigned char)x, (unsigned char)y, (unsigned char)z});
+}
+
+void BlockTickScheduler::scheduleAround(Chunk *c, int x, int y, int z, int delay) {
+    static const int offsets[7][3] = {
+        {0, 0, 0}, {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}
+    };
+    for (const int *o : offsets) {
+        int nx = x + o[0], ny = y + o[1], nz = z + o[2];
+        Chunk *n = nullptr;
+        if (ny < 256 && hasRandomTicks(blockAt(c, nx, ny, nz, &n))) {
+            schedule(n, nx, ny, nz, delay);
+        }
+    }
+}
+
+uint32_t BlockTickScheduler::tickRandom(const Chunk *c, uint64_t tick, uint32_t n) {
+    // splitmix64 over everything that identifies this update
+    uint64_t h = tick * 0x9E3779B97F4A7C15ULL;
+    h ^= (uint64_t(uint32_t(c->m_coords.x)) << 32 | uint32_t(c->m_coords.y)) + 0x632BE59BD9B4E019ULL;
+    h ^= uint64_t(n) * 0xD6E8FEB86659FD93ULL;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return static_cast<uint32_t>(h ^ (h >> 31));
+}
+
+bool BlockTickScheduler::tickBlock(const Chunk *c, int x, int y, int z, uint32_t r, BlockChange *out) {
+    BlockType t = c->getBlockAt(x, y, z);
+    switch (t) {
+    case GRASS: {
+        // Smothered grass dies back to dirt
+        if (isOpaque(blockAt(c, x, y + 1, z))) {
+            *out = BlockChange{const_cast<Chunk*>(c), (unsigned char)x, (unsigned char)y, (unsigned char)z,
+                               GRASS, DIRT, 0};
+            return true;
+        }
+        // Otherwise it spreads to a random nearby dirt block with light above it
+        int nx = x + int(r % 3) - 1, ny = y + int(r / 3 % 3) - 1, nz = z + int(r / 9 % 3) - 1;
+        // blockAt only reaches the four side neighbors, so a target
+        // diagonally across a corner of c is left alone
+        bool outX = nx < 0 || nx >= 16, outZ = nz < 0 || nz >= 16;
+        Chunk *n = nullptr;
+        if ((outX && outZ) || ny >= 255 || blockAt(c, nx, ny, nz, &n) != DIRT
+                || isOpaque(blockAt(c, nx, ny + 1, nz))
+                || skyLight(c->getLightAt(nx, ny + 1, nz)) < MIN_GRASS_SKY_LIGHT) {
+            return false;
+        }
+        int lx = nx, lz = nz;
+        c->getChunkContaining(lx, lz);
+        *out = BlockChange{n, (unsigned char)lx, (unsigned char)ny, (unsigned char)lz, DIRT, GRASS, 0};
+        return true;
+    }
+    case SNOW: {
+        // Snow only builds up slowly, under open sky
+        if (r % 4 != 0 || y >= 255 || c->getBlockAt(x, y + 1, z) != EMPTY
+                || skyLight(c->getLightAt(x, y + 1, z)) < LightEngine::MAX_LIGHT) {
+            return false;
+        }
+        int depth = 1;
+        while (depth < MAX_SNOW_DEPTH && y - depth >= 0 && c->getBlockAt(x, y - depth, z) == SNOW) {
+            depth++;
+        }
+        if (depth >= MAX_SNOW_DEPTH) {
+            return false;
+        }
+        *out = BlockChange{const_cast<Chunk*>(c), (unsigned char)x, (unsigned char)(y + 1), (unsigned char)z,
+                           EMPTY, SNOW, 0};
+        return true;
+    }
+    case LAVA: {
+        static const int offsets[6][3] = {
+            {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}
+        };
+        for (const int *o : offsets) {
+            if (blockAt(c, x + o[0], y + o[1], z + o[2]) == WATER) {
+                *out = BlockChange{const_cast<Chunk*>(c), (unsigned char)x, (unsigned char)y, (unsigned char)z,
+                                   LAVA, STONE, 0};
+                return true;
+            }
+        }
+        return false;
+    }
+    default:
+        return false;
+    }
+}
+
+void BlockTickScheduler::reportResults(std::map<int64_t, std::vector<BlockChange>> &results,
+                                       std::vector<BlockTickJob> &unfinished) {
+    m_resultsLock.lock();
+    for (auto &chunkChanges : results) {
+        std::vector<BlockChange> &changes = m_results[chunkChanges.first];
+        changes.insert(changes.end(), chunkChanges.second.begin(), chunkChanges.second.end());
+    }
+    m_unfinished.insert(m_unfinished.end(), unfinished.begin(), unfinished.end());
+    m_workersFinished++;
+    m_resultsLock.unlock();
+}
+
+void BlockTickScheduler::collectResults() {
+    m_resultsLock.lock();
+    // m_results is ordered by Chunk, so the order changes are applied
+    // in does not depend on which worker finished first
+    for (auto &chunkChanges : m_results) {
+        m_changes.insert(m_changes.end(), chunkChanges.second.begin(), chunkChanges.second.end());
+    }
+    m_results.clear();
+    for (BlockTickJob &job : m_unfinished) {
+        std::set<ScheduledUpdate> &queue = m_scheduled[job.chunk];
+        queue.insert(job.due.begin(), job.due.end());
+    }
+    m_unfinished.clear();
+    m_workersInFlight = 0;
+    m_workersFinished = 0;
+    m_resultsLock.unlock();
+}
+
+void BlockTickScheduler::update(float dT, const std::vector<Chunk*> &chunks) {
+    m_tickTimer += dT;
+
+    if (m_workersInFlight > 0) {
+        m_resultsLock.lock();
+        bool done = m_workersFinished == m_workersInFlight;
+        m_resultsLock.unlock();
+        if (!done) {
+            return;
+        }
+        collectResults();
+    }
+
+    if (m_tickTimer < m_tickLength) {
+        return;
+    }
+    m_tickTimer = 0.f;
+    m_tick++;
+
+    // Spread the Chunks over one batch per core; each Chunk is cheap,
+    // so a worker per Chunk would mostly be queueing overhead
+    int batchCount = std::max(1, QThread::idealThreadCount());
+    std::vector<std::vector<BlockTickJob>> batches(batchCount);
+    int next = 0;
+    for (Chunk *c : chunks) {
+        BlockTickJob job{c, {}};
+        auto queue = m_scheduled.find(c);
+        if (queue != m_scheduled.end()) {
+            std::set<ScheduledUpdate> &updates = queue->second;
+            auto firstLater = updates.begin();
+            while (firstLater != updates.end() && firstLater->tick <= m_tick) {
+                ++firstLater;
+            }
+            job.due.assign(updates.begin(), firstLater);
+            updates.erase(updates.begin(), firstLater);
+            if (updates.empty()) {
+                m_scheduled.erase(queue);
+            }
+        }
+        bool hasRandomTicks = false;
+        for (int section = 0; section < 16 && !hasRandomTicks; section++) {
+            hasRandomTicks = c->getRandomTickBlockCount(section) > 0;
+        }
+        if (job.due.empty() && !hasRandomTicks) {
+            continue;
+        }
+        batches[next].push_back(std::move(job));
+        next = (next + 1) % batchCount;
+    }
+
+    for (std::vector<BlockTickJob> &batch : batches) {
+        if (batch.empty()) {
+            continue;
+        }
+        m_workersInFlight++;
+        QThreadPool::globalInstance()->start(new BlockTickWorker(this, m_tick, std::move(batch), m_workerBudgetMs),
+                                             BLOCK_TICK_WORKER_PRIORITY);
+    }
+}
+
+bool BlockTickScheduler::takeChange(BlockChange *out) {
+    if (m_changes.empty()) {
+        return false;
+    }
+    *out = m_changes.front();
+    m_changes.pop_front();
+    return true;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "chunk.h"
+#include "fluidsimulator.h"
+#include <QMutex>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+// A block update due on a given tick. Ordered by tick, then by
+// the order the updates were scheduled in.
+struct ScheduledUpdate {
+    uint64_t tick;
+    uint64_t order;
+    unsigned char x, y, z;
+    bool operator<(const ScheduledUpdate &o) const {
+        return tick != o.tick ? tick < o.tick : order < o.order;
+    }
+};
+
+// One Chunk's share of a tick, handed to a BlockTickWorker
+struct BlockTickJob {
+    Chunk *chunk;
+    std::vector<ScheduledUpdate> due;
+};
+
+// Makes the world change slowly over time: grass spreads onto dirt,
+// snow piles up on snowy peaks, and lava next to water hardens into stone.
+//
+// Every tick each Chunk near the player gets a few random ticks per
+// 16-block-tall section, skipping sections without blocks that react
+// to them (see Chunk::getRandomTickBlockCount). Blocks can also be
+// scheduled to update a number of ticks from now; these are kept in a
+// sorted queue per Chunk. Terrain::editBlockAt schedules the blocks
+// around every edit, so e.g. lava hardens soon after water is poured
+// next to it.
+//
+// The ticks themselves run on BlockTickWorkers, which only read the
+// world and stop once they have spent m_workerBudgetMs. Random numbers
+// come from a hash of the Chunk, tick and update rather than a shared
+// generator, and the changes are sorted by Chunk before Terrain applies
+// them, so the outcome does not depend on thread timing.
+class BlockTickScheduler {
+public:
+    static const int RANDOM_TICKS_PER_SECTION = 3;
+    // Time between ticks, in the same units as the dT passed to update()
+    float m_tickLength;
+    // How long each worker may spend on one tick, in milliseconds
+    float m_workerBudgetMs;
+    // How long Terrain may spend applying changes each frame, in milliseconds
+    float m_applyBudgetMs;
+
+private:
+    std::unordered_map<Chunk*, std::set<ScheduledUpdate>> m_scheduled;
+    uint64_t m_tick;
+    uint64_t m_nextOrder;
+    float m_tickTimer;
+
+    int m_workersInFlight;
+    int m_workersFinished;
+    // Worker results by Chunk key, so they are applied in a fixed order
+    std::map<int64_t, std::vector<BlockChange>> m_results;
+    std::vector<BlockTickJob> m_unfinished;
+    QMutex m_resultsLock;
+
+    // Changes waiting for Terrain to apply them, oldest first
+    std::deque<BlockChange> m_changes;
+
+    void collectResults();
+
+public:
+    BlockTickScheduler();
+
+    // Updates the block at local x, y, z of c delay ticks from now.
+    // Main thread only.
+    void schedule(Chunk *c, int x, int y, int z, int delay);
+    // Schedules that block and its six neighbors, if they have random ticks
+    void scheduleAround(Chunk *c, int x, int y, int z, int delay);
+
+    // Advances the tick clock and starts workers for every Chunk in
+    // chunks once a tick is due. Main thread only.
+    void update(float dT, const std::vector<Chunk*> &chunks);
+
+    // Pops the next change workers have asked for. The caller must
+    // check that the block still has the expected type before applying it.
+    bool takeChange(BlockChange *out);
+
+    // What ticking the block at local x, y, z of c does, driven by the
+    // random number r. Returns false if nothing happens. Only reads the
+    // world, so workers may call it concurrently.
+    static bool tickBlock(const Chunk *c, int x, int y, int z, uint32_t r, BlockChange *out);
+    // Deterministic random number for update n of Chunk c on this tick
+    static uint32_t tickRandom(const Chunk *c, uint64_t tick, uint32_t n);
+
+    // Called by each BlockTickWorker when it is done. unfinished holds
+    // the scheduled updates it ran out of time for.
+    void reportResults(std::map<int64_t, std::vector<BlockChange>> &results,
+                       std::vector<BlockTickJob> &unfinished);
+};
@@ -26,6 +26,17 @@ void Camera::setWidthHeight(unsigned int w, unsigned int h) {
     m_aspect = w / static_cast<float>(h);
 }
 
+CameraPose Camera::getPose() const {
+    return CameraPose{m_position, m_forward, m_right, m_up};
+}
+
+void Camera::setPose(const CameraPose &pose) {
+    m_position = pose.position;
+    m_forward = pose.forward;
+    m_right = pose.right;
+    m_up = pose.up;
+}
+
 
 void Camera::tick(float dT, InputBundle &input) {
     // Do nothing
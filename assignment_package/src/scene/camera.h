@@ -3,6 +3,11 @@
 #include "la.h"
 #include "scene/entity.h"
 
+// Where a Camera is and which way it faces
+struct CameraPose {
+    glm::vec3 position, forward, right, up;
+};
+
 //A perspective projection camera
 //Receives its eye position and reference point from the scene XML file
 class Camera : public Entity {
@@ -19,6 +24,9 @@ public:
     Camera(const Camera &c);
     void setWidthHeight(unsigned int w, unsigned int h);
 
+    CameraPose getPose() const;
+    void setPose(const CameraPose &pose);
+
     void tick(float dT, InputBundle &input) override;
 
     glm::mat4 getViewProj() const;
@@ -1,12 +1,38 @@
 #include "chunk.h"
+#include "blockregistry.h"
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+
+// Occupancy masks pack the four 16-block x rows z = 4k .. 4k + 3 at one
+// height into a single word, with block x, z at bit (z % 4) * 16 + x
+static inline int maskWord(int y, int zGroup) {
+    return y * 4 + zGroup;
+}
+
+static inline uint64_t maskBit(int x, int z) {
+    return uint64_t(1) << ((z % 4) * 16 + x);
+}
+
+// The x == 0 and x == 15 bit of every row in a mask word
+static const uint64_t ROW_LOW_BITS = 0x0001000100010001ULL;
+static const uint64_t ROW_HIGH_BITS = 0x8000800080008000ULL;
+static const uint64_t ALL_BITS = ~uint64_t(0);
 
 Chunk::Chunk(OpenGLContext* mp_context, int x, int z) : Drawable(mp_context),
-    m_coords(x, z), m_blocks(),
+    m_coords(x, z), m_blocks(), m_light(), m_columnMin(), m_columnMax(),
+    m_minHeight(255), m_maxHeight(0),
     m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}},
-    m_chunkVBOData(this), hasVBOdata(false)
+    m_chunkVBOData(this), hasVBOdata(false), m_generationState(UNGENERATED)
 {
     std::fill_n(m_blocks.begin(), 65536, EMPTY);
+    m_light.fill(0);
+    m_opaqueMask.fill(0);
+    m_transparentMask.fill(0);
+    m_randomTickBlocks.fill(0);
+    m_sectionBlocks.fill(0);
+    m_columnMin.fill(255);
+    m_columnMax.fill(0);
 }
 
 void Chunk::destroyVBOdata() {
@@ -55,7 +81,7 @@ BlockType Chunk::getBlockAt(unsigned int x, unsigned int y, unsigned int z) cons
         return m_neighbors.at(ZPOS)->getBlockAt(x, y, z - 16);
     }
 
-    return m_blocks.at(x + 16 * y + 16 * 256 * z);
+    return m_blocks[blockIndex(x, y, z)];
 }
 
 // Exists to get rid of compiler warnings about int -> unsigned int implicit conversion
@@ -70,9 +96,240 @@ BlockType Chunk::getBlockAt(glm::vec3 pos) const {
     return getBlockAt(static_cast<unsigned int>(pos.x), static_cast<unsigned int>(pos.y), static_cast<unsigned int>(pos.z));
 }
 
-// Does bounds checking with at()
+unsigned char Chunk::getLightAt(int x, int y, int z) const {
+    if (y >= 256) {
+        return packLight(15, 0); // Open sky
+    } else if (y < 0) {
+        return 0;
+    }
+    Direction dir;
+    if (x < 0) {
+        dir = XNEG; x += 16;
+    } else if (x >= 16) {
+        dir = XPOS; x -= 16;
+    } else if (z < 0) {
+        dir = ZNEG; z += 16;
+    } else if (z >= 16) {
+        dir = ZPOS; z -= 16;
+    } else {
+        return m_light[blockIndex(x, y, z)];
+    }
+    const Chunk *n = getNeighbor(dir);
+    // Faces are never made against missing Chunks, so this value is unused
+    return n == nullptr ? packLight(15, 0) : n->getLightAt(x, y, z);
+}
+
+// Coordinates wrap into the Chunk; there is no bounds checking
 void Chunk::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
-    m_blocks.at((x % 16) + 16 * (y % 256) + 16 * 256 * (z % 16)) = t;
+    x %= 16; y %= 256; z %= 16;
+    countSectionBlocks(y, m_blocks[blockIndex(x, y, z)], t);
+    m_blocks[blockIndex(x, y, z)] = t;
+    setOccupancy(x, y, z, t);
+    if(t != EMPTY) {
+        expandColumn(x, z, y, y);
+    } else if(y == m_columnMin[x + 16 * z] || y == m_columnMax[x + 16 * z]) {
+        rescanColumn(x, z);
+    }
+}
+
+void Chunk::setOccupancy(int x, int y, int z, BlockType t) {
+    uint64_t bit = maskBit(x, z);
+    uint64_t &opaque = m_opaqueMask[maskWord(y, z / 4)];
+    uint64_t &transparent = m_transparentMask[maskWord(y, z / 4)];
+    opaque &= ~bit;
+    transparent &= ~bit;
+    if(isOpaque(t)) {
+        opaque |= bit;
+    } else if(isTransparent(t)) {
+        transparent |= bit;
+    }
+}
+
+void Chunk::countSectionBlocks(int y, BlockType old, BlockType t) {
+    m_randomTickBlocks[y / 16] += hasRandomTicks(t) - hasRandomTicks(old);
+    m_sectionBlocks[y / 16] += (t != EMPTY) - (old != EMPTY);
+}
+
+int Chunk::getRandomTickBlockCount(int section) const {
+    return m_randomTickBlocks[section];
+}
+
+int Chunk::getSectionBlockCount(int section) const {
+    return m_sectionBlocks[section];
+}
+
+uint64_t Chunk::adjacentOccupancy(OccupancyMask Chunk::*mask, int y, int zGroup, Direction dir) const {
+    const OccupancyMask &m = this->*mask;
+    uint64_t row = m[maskWord(y, zGroup)];
+    Chunk *n = nullptr;
+    switch(dir) {
+    case XPOS:
+        n = getNeighbor(XPOS);
+        return ((row >> 1) & ~ROW_HIGH_BITS)
+                | (n ? ((n->*mask)[maskWord(y, zGroup)] & ROW_LOW_BITS) << 15 : ROW_HIGH_BITS);
+    case XNEG:
+        n = getNeighbor(XNEG);
+        return ((row << 1) & ~ROW_LOW_BITS)
+                | (n ? ((n->*mask)[maskWord(y, zGroup)] & ROW_HIGH_BITS) >> 15 : ROW_LOW_BITS);
+    case YPOS:
+        return y == 255 ? ALL_BITS : m[maskWord(y + 1, zGroup)];
+    case YNEG:
+        return y == 0 ? ALL_BITS : m[maskWord(y - 1, zGroup)];
+    case ZPOS: {
+        uint64_t next;
+        if(zGroup < 3) {
+            next = m[maskWord(y, zGroup + 1)];
+        } else {
+            n = getNeighbor(ZPOS);
+            next = n ? (n->*mask)[maskWord(y, 0)] : ALL_BITS;
+        }
+        // Row z + 1 of the last row in this word is the first row of the next
+        return (row >> 16) | (next << 48);
+    }
+    case ZNEG: {
+        uint64_t prev;
+        if(zGroup > 0) {
+            prev = m[maskWord(y, zGroup - 1)];
+        } else {
+            n = getNeighbor(ZNEG);
+            prev = n ? (n->*mask)[maskWord(y, 3)] : ALL_BITS;
+        }
+        return (row << 16) | (prev >> 48);
+    }
+    }
+    return ALL_BITS;
+}
+
+void Chunk::expandColumn(int x, int z, int yMin, int yMax) {
+    int col = x + 16 * z;
+    m_columnMin[col] = std::min<int>(m_columnMin[col], yMin);
+    m_columnMax[col] = std::max<int>(m_columnMax[col], yMax);
+    m_minHeight = std::min(m_minHeight, yMin);
+    m_maxHeight = std::max(m_maxHeight, yMax);
+}
+
+void Chunk::rescanColumn(int x, int z, int yMin, int yMax) {
+    int col = x + 16 * z;
+    bool wasAtChunkBound = m_columnMin[col] <= m_columnMax[col]
+            && (m_columnMin[col] == m_minHeight || m_columnMax[col] == m_maxHeight);
+    const BlockType *column = &m_blocks[blockIndex(x, 0, z)];
+    int lo = yMin, hi = yMax;
+    while(lo <= hi && column[lo] == EMPTY) {
+        lo++;
+    }
+    while(hi >= lo && column[hi] == EMPTY) {
+        hi--;
+    }
+    if(lo > hi) {
+        m_columnMin[col] = 255;
+        m_columnMax[col] = 0;
+    } else {
+        m_columnMin[col] = lo;
+        m_columnMax[col] = hi;
+    }
+    if(wasAtChunkBound) {
+        recomputeHeightBounds();
+    } else if(lo <= hi) {
+        m_minHeight = std::min(m_minHeight, lo);
+        m_maxHeight = std::max(m_maxHeight, hi);
+    }
+}
+
+void Chunk::rescanColumn(int x, int z) {
+    // Blocks can only have been removed, so the new bounds lie
+    // within the old ones
+    int col = x + 16 * z;
+    rescanColumn(x, z, m_columnMin[col], m_columnMax[col]);
+}
+
+void Chunk::recomputeHeightBounds() {
+    m_minHeight = 255;
+    m_maxHeight = 0;
+    for(int col = 0; col < 256; col++) {
+        if(m_columnMin[col] <= m_columnMax[col]) {
+            m_minHeight = std::min<int>(m_minHeight, m_columnMin[col]);
+            m_maxHeight = std::max<int>(m_maxHeight, m_columnMax[col]);
+        }
+    }
+}
+
+int Chunk::getColumnMinHeight(int x, int z) const {
+    int col = x + 16 * z;
+    return m_columnMin[col] <= m_columnMax[col] ? m_columnMin[col] : -1;
+}
+
+int Chunk::getColumnMaxHeight(int x, int z) const {
+    int col = x + 16 * z;
+    return m_columnMin[col] <= m_columnMax[col] ? m_columnMax[col] : -1;
+}
+
+int Chunk::getMinHeight() const {
+    return m_minHeight <= m_maxHeight ? m_minHeight : -1;
+}
+
+int Chunk::getMaxHeight() const {
+    return m_minHeight <= m_maxHeight ? m_maxHeight : -1;
+}
+
+void Chunk::fillColumn(int x, int z, int yMin, int yMax, BlockType t) {
+    yMin = std::max(yMin, 0);
+    yMax = std::min(yMax, 255);
+    if(yMin > yMax) {
+        return;
+    }
+    static_assert(sizeof(BlockType) == 1, "fillColumn assumes one byte per block");
+    for(int y = yMin; y <= yMax; y++) {
+        countSectionBlocks(y, m_blocks[blockIndex(x, y, z)], t);
+    }
+    std::memset(&m_blocks[blockIndex(x, yMin, z)], t, yMax - yMin + 1);
+    // The column has one bit in each mask word of its height range, and
+    // every one of them gets the same value
+    uint64_t bit = maskBit(x, z);
+    uint64_t opaque = isOpaque(t) ? bit : 0;
+    uint64_t transparent = !opaque && isTransparent(t) ? bit : 0;
+    for(int w = maskWord(yMin, z / 4), end = maskWord(yMax, z / 4); w <= end; w += 4) {
+        m_opaqueMask[w] = (m_opaqueMask[w] & ~bit) | opaque;
+        m_transparentMask[w] = (m_transparentMask[w] & ~bit) | transparent;
+    }
+
+    int col = x + 16 * z;
+    if(t != EMPTY) {
+        expandColumn(x, z, yMin, yMax);
+    } else if(m_columnMin[col] <= m_columnMax[col]
+              && yMin <= m_columnMax[col] && yMax >= m_columnMin[col]) {
+        rescanColumn(x, z);
+    }
+}
+
+void Chunk::setColumn(int x, int z, int yMin, const BlockType *types, int count) {
+    int start = std::max(yMin, 0);
+    int end = std::min(yMin + count, 256);
+    if(start >= end) {
+        return;
+    }
+    for(int y = start; y < end; y++) {
+        countSectionBlocks(y, m_blocks[blockIndex(x, y, z)], types[y - yMin]);
+    }
+    std::memcpy(&m_blocks[blockIndex(x, start, z)], types + (start - yMin), end - start);
+    // One write to each mask word the column passes through
+    uint64_t bit = maskBit(x, z);
+    for(int y = start, w = maskWord(start, z / 4); y < end; y++, w += 4) {
+        BlockType t = types[y - yMin];
+        uint64_t opaque = isOpaque(t) ? bit : 0;
+        uint64_t transparent = !opaque && isTransparent(t) ? bit : 0;
+        m_opaqueMask[w] = (m_opaqueMask[w] & ~bit) | opaque;
+        m_transparentMask[w] = (m_transparentMask[w] & ~bit) | transparent;
+    }
+
+    // The copy may both add blocks and clear old ones, so rescan
+    // everything the old bounds and the written range cover
+    int col = x + 16 * z;
+    int lo = start, hi = end - 1;
+    if(m_columnMin[col] <= m_columnMax[col]) {
+        lo = std::min<int>(lo, m_columnMin[col]);
+        hi = std::max<int>(hi, m_columnMax[col]);
+    }
+    rescanColumn(x, z, lo, hi);
 }
 
 
@@ -92,6 +349,55 @@ void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
     }
 }
 
+Chunk* Chunk::getNeighbor(Direction dir) const {
+    auto it = m_neighbors.find(dir);
+    return it == m_neighbors.end() ? nullptr : it->second;
+}
+
+Chunk* Chunk::getChunkContaining(int &x, int &z) const {
+    Direction dir;
+    if(x < 0) {
+        dir = XNEG; x += 16;
+    } else if(x >= 16) {
+        dir = XPOS; x -= 16;
+    } else if(z < 0) {
+        dir = ZNEG; z += 16;
+    } else if(z >= 16) {
+        dir = ZPOS; z -= 16;
+    } else {
+        return const_cast<Chunk*>(this);
+    }
+    return getNeighbor(dir);
+}
+
+bool Chunk::occludesAt(int x, int y, int z) const {
+    if (y < 0 || y >= 256) {
+        return false;
+    }
+    BlockType t = getBlockAt(x, y, z);
+    // Missing Chunks are not real walls, so they cast no shadow
+    return t != UNDETERMINED && isOpaque(t);
+}
+
+float Chunk::vertexAO(glm::ivec3 facing, glm::vec3 normal, glm::vec4 corner) const {
+    // The two directions along the face toward this corner
+    glm::ivec3 side1(0), side2(0);
+    int axis1 = normal.x != 0 ? 1 : 0;
+    int axis2 = normal.z != 0 ? 1 : 2;
+    side1[axis1] = corner[axis1] > 0.5f ? 1 : -1;
+    side2[axis2] = corner[axis2] > 0.5f ? 1 : -1;
+
+    glm::ivec3 a = facing + side1, b = facing + side2, c = facing + side1 + side2;
+    bool s1 = occludesAt(a.x, a.y, a.z);
+    bool s2 = occludesAt(b.x, b.y, b.z);
+    // Two blocked sides fully cover the corner block
+    if (s1 && s2) {
+        return 0.f;
+    }
+    int open = 3 - (s1 + s2 + occludesAt(c.x, c.y, c.z));
+    return open / 3.f;
+}
+
 void Chunk::createVBOdata() {
     // Create stores for all the opaque square faces to be drawn
     std::vector<glm::vec4> O_pos = std::vector<glm::vec4>();
@@ -108,94 +414,77 @@ void Chunk::createVBOdata() {
     int O_indexOffset = 0;
     int T_indexOffset = 0;
 
-    // Iterate through all the blocks
-    for (int z = 0; z < 16; z++) {
-        for (int y = 0; y < 256; y++) {
-            for (int x = 0; x < 16; x++) {
-                BlockType btAtCurrPos = getBlockAt(x, y, z);
-
-                if (btAtCurrPos != EMPTY) {
-                    glm::vec3 currPos = glm::vec3(x, y, z);
-                    glm::vec3 currWorldPos = glm::vec3(x, y, z);
-
-                    // Look at all neighbors and add appropriate faces
-                    for (BlockFace neighborFace : adjacentFaces) {
-                        BlockType neighborType = getBlockAt(neighborFace.directionVec + currPos);
-
-                        // If the neighbor is empty, not undetermined and this block is a non liquid block touching liquid, add vertices to collection
-                        if (neighborType == EMPTY || ((neighborType == WATER || neighborType == LAVA) && (btAtCurrPos != WATER && btAtCurrPos != LAVA))) {
-                            for (VertexData VD : neighborFace.vertices) {
-                                glm::vec2 UVoffset;
-
-                                switch(btAtCurrPos) {
-                                    case GRASS:
-                                        // Set offset for grass top
-                                        if (neighborFace.direction == YPOS) {
-                                            UVoffset = glm::vec2(8, 13);
-                                        } else if (neighborFace.direction == YNEG) { // Set offset for grass bottom
-                                            UVoffset = glm::vec2(2, 15);
-                                        } else { // Set offset for grass sides
-                                            UVoffset = glm::vec2(3, 15);
-                                        }
-                                        break;
-                                    case DIRT:
-                                        // Set offset for dirt
-                                        UVoffset = glm::vec2(2, 15);
-                                        break;
-                                    case STONE:
-                                        // Set offset for stone
-                                        UVoffset = glm::vec2(1, 15);
-                                        break;
-                                    case SNOW:
-                                        UVoffset = glm::vec2(2, 11);
-                                        break;
-                                    case WATER:
-                                        UVoffset = glm::vec2(13, 3);
-                                        break;
-                                    case LAVA:
-                                        UVoffset = glm::vec2(13, 1);
-                                        break;
-                                    case BEDROCK:
-                                        UVoffset = glm::vec2(1, 15);
-                                        break;
-                                    default:
-                                        // Other block types are not yet handled, so we default to debug purple
-                                        UVoffset = glm::vec2(10, 3);
-                                        break;
-                                }
-
-                                // Push VBO Data
-                                if (btAtCurrPos != WATER && btAtCurrPos != LAVA) {
-                                    O_pos.push_back(glm::vec4(currWorldPos, 0.f) + VD.pos);
-                                    O_nor.push_back(glm::vec4(neighborFace.directionVec, 0.f));
-                                    O_uv.push_back(glm::vec4(VD.uv + UVoffset / 16.f, 0, 0));
-                                } else {
-                                    T_pos.push_back(glm::vec4(currWorldPos, 0.f) + VD.pos);
-                                    T_nor.push_back(glm::vec4(neighborFace.directionVec, 0.f));
-                                    T_uv.push_back(glm::vec4(VD.uv + UVoffset / 16.f, 0, 0));
-                                }
-                            }
-
-                            // Push indices
-                            if (btAtCurrPos != WATER && btAtCurrPos != LAVA) {
-                                O_idx.push_back(0 + O_indexOffset);
-                                O_idx.push_back(1 + O_indexOffset);
-                                O_idx.push_back(2 + O_indexOffset);
-                                O_idx.push_back(0 + O_indexOffset);
-                                O_idx.push_back(2 + O_indexOffset);
-                                O_idx.push_back(3 + O_indexOffset);
-                                O_indexOffset += 4;
-                            } else {
-                                T_idx.push_back(0 + T_indexOffset);
-                                T_idx.push_back(1 + T_indexOffset);
-                                T_idx.push_back(2 + T_indexOffset);
-                                T_idx.push_back(0 + T_indexOffset);
-                                T_idx.push_back(2 + T_indexOffset);
-                                T_idx.push_back(3 + T_indexOffset);
-                                T_indexOffset += 4;
-                            }
-                        }
-                    }
+    // Adds the four vertices and two triangles of one block face
+    auto emitFace = [&](int x, int y, int z, BlockType btAtCurrPos, const BlockFace &neighborFace) {
+        glm::vec3 currWorldPos = glm::vec3(x, y, z);
+        float layer = atlasLayer(btAtCurrPos, neighborFace.direction);
+        bool opaque = isOpaque(btAtCurrPos);
+        // Faces are lit by the block they face, stored packed in uv.w
+        glm::ivec3 facing = glm::ivec3(x, y, z) + glm::ivec3(neighborFace.directionVec);
+        float light = getLightAt(facing.x, facing.y, facing.z);
+
+        // Ambient occlusion of each corner, stored in nor.w
+        std::array<float, 4> ao;
+        for (int i = 0; i < 4; i++) {
+            ao[i] = vertexAO(facing, neighborFace.directionVec, neighborFace.vertices[i].pos);
+        }
+        for (int i = 0; i < 4; i++) {
+            const VertexData &VD = neighborFace.vertices[i];
+            // Push VBO Data
+            if (opaque) {
+                O_pos.push_back(glm::vec4(currWorldPos, 0.f) + VD.pos);
+                O_nor.push_back(glm::vec4(neighborFace.directionVec, ao[i]));
+                O_uv.push_back(glm::vec4(VD.uv * 16.f, layer, light));
+            } else {
+                T_pos.push_back(glm::vec4(currWorldPos, 0.f) + VD.pos);
+                T_nor.push_back(glm::vec4(neighborFace.directionVec, ao[i]));
+                T_uv.push_back(glm::vec4(VD.uv * 16.f, layer, light));
+            }
+        }
+
+        // Split the quad along the diagonal that does not run through
+        // its darkest corners, so occlusion interpolates evenly
+        static const std::array<GLuint, 6> defaultTris {0, 1, 2, 0, 2, 3};
+        static const std::array<GLuint, 6> flippedTris {1, 2, 3, 1, 3, 0};
+        const std::array<GLuint, 6> &tris = ao[0] + ao[2] < ao[1] + ao[3] ? flippedTris : defaultTris;
+
+        // Push indices
+        if (opaque) {
+            for (GLuint i : tris) {
+                O_idx.push_back(i + O_indexOffset);
+            }
+            O_indexOffset += 4;
+        } else {
+            for (GLuint i : tris) {
+                T_idx.push_back(i + T_indexOffset);
+            }
+            T_indexOffset += 4;
+        }
+    };
+
+    // Work a mask word (four 16-block rows) at a time over the
+    // heights that contain any blocks
+    int minHeight = getMinHeight(), maxHeight = getMaxHeight();
+    for (int y = minHeight; y >= 0 && y <= maxHeight; y++) {
+        for (int zGroup = 0; zGroup < 4; zGroup++) {
+            uint64_t opaque = m_opaqueMask[maskWord(y, zGroup)];
+            uint64_t transparent = m_transparentMask[maskWord(y, zGroup)];
+            if ((opaque | transparent) == 0) {
+                continue;
+            }
+            for (const BlockFace &neighborFace : adjacentFaces) {
+                uint64_t neighborOpaque = adjacentOccupancy(&Chunk::m_opaqueMask, y, zGroup, neighborFace.direction);
+                uint64_t neighborTransparent = adjacentOccupancy(&Chunk::m_transparentMask, y, zGroup, neighborFace.direction);
+                // Opaque blocks show a face to anything that is not opaque,
+                // transparent ones (liquids) only show one to empty space
+                uint64_t visible = (opaque & ~neighborOpaque)
+                        | (transparent & ~(neighborOpaque | neighborTransparent));
+                while (visible != 0) {
+                    int bit = countTrailingZeros64(visible);
+                    visible &= visible - 1;
+                    int x = bit & 15;
+                    int z = zGroup * 4 + (bit >> 4);
+                    emitFace(x, y, z, m_blocks[blockIndex(x, y, z)], neighborFace);
                 }
             }
         }
@@ -231,43 +520,37 @@ void Chunk::bufferVBOdata(std::vector<glm::vec4> m_vboDataOpaque,
     this->m_count = m_idxDataOpaque.size();
     this->m_count_sec = m_idxDataTransparent.size();
 
-    generatePos();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufPos);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, m_vboDataOpaque.size() * sizeof(glm::vec4), m_vboDataOpaque.data(), GL_STATIC_DRAW);
-
-    generateNor();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufNor);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, m_vboDataOpaque.size() * sizeof(glm::vec4), m_vboDataOpaque.data(), GL_STATIC_DRAW);
-
-    generateUV();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufUV);
+    // Position, normal and UV are interleaved in one buffer per pass, so
+    // that is all that is uploaded. Remeshing reuses the buffers.
+    if (!m_posGenerated) {
+        generatePos();
+    }
+    mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufPos);
     mp_context->glBufferData(GL_ARRAY_BUFFER, m_vboDataOpaque.size() * sizeof(glm::vec4), m_vboDataOpaque.data(), GL_STATIC_DRAW);
 
-    generateIdx();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
+    if (!m_idxGenerated) {
+        generateIdx();
+    }
+    mp_context->glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
     mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_idxDataOpaque.size() * sizeof(GLuint), m_idxDataOpaque.data(), GL_STATIC_DRAW);
 
-    generatePos_sec();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufPos_sec);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, m_vboDataTransparent.size() * sizeof(glm::vec4), m_vboDataTransparent.data(), GL_STATIC_DRAW);
-
-    generateNor_sec();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufNor_sec);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, m_vboDataTransparent.size() * sizeof(glm::vec4), m_vboDataTransparent.data(), GL_STATIC_DRAW);
-
-    generateUV_sec();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufUV_sec);
+    if (!m_posGenerated_sec) {
+        generatePos_sec();
+    }
+    mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufPos_sec);
     mp_context->glBufferData(GL_ARRAY_BUFFER, m_vboDataTransparent.size() * sizeof(glm::vec4), m_vboDataTransparent.data(), GL_STATIC_DRAW);
 
-    generateIdx_sec();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx_sec);
+    if (!m_idxGenerated_sec) {
+        generateIdx_sec();
+    }
+    mp_context->glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx_sec);
     mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_idxDataTransparent.size() * sizeof(GLuint), m_idxDataTransparent.data(), GL_STATIC_DRAW);
 }
-void Chunk::generateChunk(int PosX, int PosZ){
+void Chunk::generateChunk(){
     // Populate blocks
     for(int i = 0; i < 16; i++){
         for(int j = 0; j < 16; j++){
-            setBlock(PosX + i, PosZ + j);
+            generateColumn(i, j);
         }
     }
 }
@@ -403,7 +686,9 @@ float Chunk::perlinNoise3D(glm::vec3 uv) {
 }
 
 
-void Chunk::setBlock(int x, int z){
+void Chunk::generateColumn(int localX, int localZ){
+    int x = m_coords.x + localX;
+    int z = m_coords.y + localZ;
     float b = perlinNoise(glm::vec2(x/300.0, z/300.0))+0.5;
 
     float p = (perlinNoise(glm::vec2(x/64.0 ,z/64.0) ) + 0.5);
@@ -436,43 +721,38 @@ void Chunk::setBlock(int x, int z){
     f = std::max(std::min(
                      f,254),0); // interpolated value
 
+    // Start from an empty column so regenerating a Chunk is safe
+    fillColumn(localX, localZ, 0, 255, EMPTY);
 
     //caves
+    std::array<BlockType, 21> caves;
     for(int i = 108; i <= 128; i++){
         float p = perlinNoise3D(glm::vec3(x/10.0,i/10.0,z/10.0));
 
         if(p > 0){
-            setBlockAt(x, i, z, STONE);
+            caves[i - 108] = STONE;
         }else if (i < 113){ // should be 25 (just for testing)
-            setBlockAt(x, i, z, LAVA);
+            caves[i - 108] = LAVA;
         }else{
-            setBlockAt(x, i, z, EMPTY);
+            caves[i - 108] = EMPTY;
         }
     }
-    setBlockAt(x, 107, z, BEDROCK); // bottom layer is bedrock
+    setColumn(localX, localZ, 108, caves.data(), caves.size());
+    fillColumn(localX, localZ, 107, 107, BEDROCK); // bottom layer is bedrock
 
     if(b > 0.5){
-        for(int i = 129; i <= f; i++){
-            if(i == f && f >= 200){
-                setBlockAt(x, i, z, SNOW); // top of mountain
-            }else{
-                setBlockAt(x, i, z, STONE); // set mountains stone
-            }
+        fillColumn(localX, localZ, 129, f - 1, STONE); // set mountains stone
+        if(f >= 129){
+            fillColumn(localX, localZ, f, f, f >= 200 ? SNOW : STONE); // top of mountain
         }
-
     }
     else{
-        for(int i = 129; i <= f; i++){
-            if(i == f){
-                setBlockAt(x, i, z, GRASS); // top of hills
-            }else{
-                setBlockAt(x, i, z, DIRT); // set hills dirt
-            }
+        fillColumn(localX, localZ, 129, f - 1, DIRT); // set hills dirt
+        if(f >= 129){
+            fillColumn(localX, localZ, f, f, GRASS); // top of hills
         }
     }
-    for(int i = f; i < 138; i++){
-        setBlockAt(x, i, z, WATER); // water 128 - 138
-    }
+    fillColumn(localX, localZ, f, 137, WATER); // water 128 - 138
 }
 
 void Chunk::generateTestTerrain(int PosX, int PosZ) {
@@ -8,8 +8,27 @@
 #include <cstddef>
 
 class Chunk;
+class LightEngine;
 //using namespace std;
 
+// Blocks are stored y-fastest so that a vertical column is contiguous
+// and can be written with a single memset or memcpy
+inline int blockIndex(unsigned int x, unsigned int y, unsigned int z) {
+    return y + 256 * x + 256 * 16 * z;
+}
+
+// A block's light is one byte: sky light in the high nibble
+// and block light (from emitters such as lava) in the low nibble
+inline unsigned char packLight(unsigned char sky, unsigned char block) {
+    return (sky << 4) | block;
+}
+inline unsigned char skyLight(unsigned char light) {
+    return light >> 4;
+}
+inline unsigned char blockLight(unsigned char light) {
+    return light & 0x0F;
+}
+
 struct ChunkVBOData {
     std::vector<glm::vec4> m_vboDataTransparent;
     std::vector<glm::vec4> m_vboDataOpaque;
@@ -21,6 +40,12 @@ struct ChunkVBOData {
 };
 
 
+// Where a Chunk is in the block generation pipeline.
+// Only modified on the main thread.
+enum GenerationState : unsigned char {
+    UNGENERATED, GENERATING, GENERATED
+};
+
 // Lets us use any enum class as the key of a
 // std::unordered_map
 struct EnumHash {
@@ -42,21 +67,99 @@ class Chunk : public Drawable {
 public:
     glm::ivec2 m_coords;
 private:
-    // All of the blocks contained within this Chunk
+    // All of the blocks contained within this Chunk, stored column by
+    // column (see blockIndex) so each x, z column is 256 contiguous bytes
     std::array<BlockType, 65536> m_blocks;
+    // The light level in each block, laid out like m_blocks.
+    // Filled in and kept up to date by LightEngine.
+    std::array<unsigned char, 65536> m_light;
+    // Lowest and highest non-EMPTY block in each column, indexed by
+    // x + 16 * z. A column with no blocks has min > max.
+    std::array<unsigned char, 256> m_columnMin;
+    std::array<unsigned char, 256> m_columnMax;
+    // The same bounds over every column in this Chunk
+    int m_minHeight, m_maxHeight;
+
+    // One bit per block marking which blocks are opaque and which are
+    // transparent (see blockregistry.h). Each 64-bit word covers four 16-block x rows
+    // at one height (see maskWord in chunk.cpp), so the mesher can test
+    // a whole row of faces with a few shifts and ANDs.
+    typedef std::array<uint64_t, 1024> OccupancyMask;
+    OccupancyMask m_opaqueMask;
+    OccupancyMask m_transparentMask;
+    // Number of blocks with random ticks (see blockregistry.h) in each
+    // 16-block-tall section, so BlockTickScheduler can skip the rest
+    std::array<unsigned short, 16> m_randomTickBlocks;
+    // Number of non-EMPTY blocks in each section, so raycasts can
+    // cross empty ones in one step
+    std::array<unsigned short, 16> m_sectionBlocks;
     // This Chunk's four neighbors to the north, south, east, and west
     // The third input to this map just lets us use a Direction as
     // a key for this map.
     // These allow us to properly determine
     std::unordered_map<Direction, Chunk*, EnumHash> m_neighbors;
 
+    friend class LightEngine;
+
+    // Rescans one column for its bounds after blocks were cleared.
+    // The second form only looks at heights yMin through yMax.
+    void rescanColumn(int x, int z);
+    void rescanColumn(int x, int z, int yMin, int yMax);
+    void recomputeHeightBounds();
+    // Widens the column's bounds to include yMin through yMax
+    void expandColumn(int x, int z, int yMin, int yMax);
+    // Updates the occupancy mask bits of one block
+    void setOccupancy(int x, int y, int z, BlockType t);
+    // Updates m_randomTickBlocks and m_sectionBlocks for a block at
+    // height y changing from old to t
+    void countSectionBlocks(int y, BlockType old, BlockType t);
+    // For the mask word at y, zGroup: the given mask's bits for the
+    // block next to each one in direction dir, read from neighboring
+    // Chunks at the edges. Blocks outside the world or in missing
+    // Chunks are treated as occupied so no faces are made against them.
+    uint64_t adjacentOccupancy(OccupancyMask Chunk::*mask, int y, int zGroup, Direction dir) const;
+    // Whether the block at these local coords (which may lie in a
+    // neighboring Chunk) darkens the corners of faces next to it
+    bool occludesAt(int x, int y, int z) const;
+    // Ambient occlusion in [0, 1] (0 is darkest) of the face corner at
+    // corner (relative to the block) of the face with this normal, where
+    // facing is the block the face looks into
+    float vertexAO(glm::ivec3 facing, glm::vec3 normal, glm::vec4 corner) const;
+
 public:
     explicit Chunk(OpenGLContext* mp_context, int x, int z);
     BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
     BlockType getBlockAt(int x, int y, int z) const;
     BlockType getBlockAt(glm::vec3 pos) const;
     void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
+    // Packed light (see packLight) in the block at these local coords,
+    // which may lie in a neighboring Chunk. Above the world is open sky.
+    unsigned char getLightAt(int x, int y, int z) const;
+    // Bulk writes for terrain generation. x and z are local to this
+    // Chunk and must be in [0, 16); the y range is clamped to [0, 256).
+    // Sets every block from yMin to yMax inclusive to t
+    void fillColumn(int x, int z, int yMin, int yMax, BlockType t);
+    // Copies count block types into the column starting at height yMin
+    void setColumn(int x, int z, int yMin, const BlockType *types, int count);
+
+    // Height bounds of the non-EMPTY blocks (water and lava included),
+    // kept up to date by every write. Columns are chunk-local.
+    // Both return -1 for an empty column or Chunk.
+    int getColumnMinHeight(int x, int z) const;
+    int getColumnMaxHeight(int x, int z) const;
+    int getMinHeight() const;
+    int getMaxHeight() const;
     void linkNeighbor(uPtr<Chunk>& neighbor, Direction dir);
+    // The adjacent Chunk in the given horizontal direction, or nullptr
+    Chunk* getNeighbor(Direction dir) const;
+    // The Chunk holding local x, z, which may lie one block outside this
+    // one, or nullptr if it does not exist. Makes x, z local to it.
+    Chunk* getChunkContaining(int &x, int &z) const;
+    // Blocks with random ticks in the section spanning heights
+    // 16 * section to 16 * section + 15
+    int getRandomTickBlockCount(int section) const;
+    // Non-EMPTY blocks in the same section
+    int getSectionBlockCount(int section) const;
     virtual void createVBOdata() override;
     //void bufferVBOdata(std::vector<glm::vec4> interleavedData, std::vector<int> indices);
 
@@ -66,8 +169,11 @@ public:
                        std::vector<GLuint> m_idxDataTransparent);
     ChunkVBOData m_chunkVBOData;
     bool hasVBOdata;
-    void generateChunk(int PosX, int PosZ);
-    void setBlock(int x, int z); // sets blocks on coordinates x,z
+    GenerationState m_generationState;
+    // Fills in every column of this Chunk from the terrain noise
+    void generateChunk();
+    // Fills in the column at local x, z from the terrain noise
+    void generateColumn(int x, int z);
     virtual void destroyVBOdata() override;
     float WorleyDist(glm::vec2 uv);
     float fbm(float x);
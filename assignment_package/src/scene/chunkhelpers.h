@@ -2,6 +2,11 @@
 #define CHUNKHELPERS_H
 
 #include "glm/glm.hpp"
+#include <array>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 // C++ 11 allows us to define the size of an enum. This lets us use only one byte
 // of memory to store our different block types. By default, the size of a C++ enum
@@ -40,6 +45,17 @@ struct BlockFace {
     {}
 };
 
+// Index of the lowest set bit of v, which must not be 0
+inline int countTrailingZeros64(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
 #define BLK_UV 1/16.f
 
 const static std::array<BlockFace, 6> adjacentFaces {
@@ -0,0 +1,116 @@
+#include "collision.h"
+#include "terrain.h"
+#include "blockregistry.h"
+#include <vector>
+
+// Faces closer than this are touching, not overlapping
+static const float EPSILON = 1e-5f;
+// How far above a block a box may be and still stand on it
+static const float GROUND_TOLERANCE = 1e-3f;
+
+// Appends a box for every solid block that overlaps lo to hi
+static void gatherBlocks(const Terrain &terrain, glm::vec3 lo, glm::vec3 hi, std::vector<AABB> *out) {
+    glm::ivec3 a = glm::ivec3(glm::floor(lo)), b = glm::ivec3(glm::floor(hi));
+    for (int x = a.x; x <= b.x; x++) {
+        for (int z = a.z; z <= b.z; z++) {
+            // A Chunk still being generated belongs to its worker, so it
+            // is a wall until it is done, like a missing one
+            const Chunk *c = terrain.hasChunkAt(x, z) ? terrain.getChunkAt(x, z).get() : nullptr;
+            if (c == nullptr || c->m_generationState != GENERATED) {
+                out->push_back(AABB{glm::vec3(x, a.y, z), glm::vec3(x + 1, b.y + 1, z + 1)});
+                continue;
+            }
+            int localX = x - c->m_coords.x, localZ = z - c->m_coords.y;
+            // Everything above the column's highest block is air
+            int top = glm::min(b.y, c->getColumnMaxHeight(localX, localZ));
+            for (int y = a.y; y <= top; y++) {
+                if (y < 0 || isSolid(c->getBlockAt(localX, y, localZ))) {
+                    out->push_back(AABB{glm::vec3(x, y, z), glm::vec3(x + 1, y + 1, z + 1)});
+                }
+            }
+        }
+    }
+}
+
+// Whether a and b overlap on both axes other than axis
+static bool overlapsAcross(const AABB &a, const AABB &b, int axis) {
+    for (int i = 0; i < 3; i++) {
+        if (i != axis && (a.max[i] <= b.min[i] + EPSILON || a.min[i] >= b.max[i] - EPSILON)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// How far box can go along axis, up to move, before it hits one of blocks
+static float clipAxis(const std::vector<AABB> &blocks, const AABB &box, int axis, float move) {
+    for (const AABB &b : blocks) {
+        if (!overlapsAcross(box, b, axis)) {
+            continue;
+        }
+        if (move > 0.f && b.min[axis] >= box.max[axis] - EPSILON) {
+            move = glm::min(move, glm::max(0.f, b.min[axis] - box.max[axis]));
+        } else if (move < 0.f && b.max[axis] <= box.min[axis] + EPSILON) {
+            move = glm::max(move, glm::min(0.f, b.max[axis] - box.min[axis]));
+        }
+    }
+    return move;
+}
+
+static void translate(AABB *box, int axis, float distance) {
+    box->min[axis] += distance;
+    box->max[axis] += distance;
+}
+
+static bool resting(const std::vector<AABB> &blocks, const AABB &box) {
+    for (const AABB &b : blocks) {
+        if (overlapsAcross(box, b, 1) && glm::abs(box.min.y - b.max.y) <= GROUND_TOLERANCE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+SweepResult sweepAABB(const Terrain &terrain, const AABB &box, glm::vec3 move, float stepHeight) {
+    glm::vec3 lo = glm::min(box.min, box.min + move);
+    glm::vec3 hi = glm::max(box.max, box.max + move);
+    lo.y -= GROUND_TOLERANCE;
+    hi.y += stepHeight;
+    std::vector<AABB> blocks;
+    gatherBlocks(terrain, lo, hi, &blocks);
+
+    SweepResult result{glm::vec3(0.f), glm::bvec3(false), false, false};
+    AABB moved = box;
+    for (int axis : {1, 0, 2}) {
+        float d = clipAxis(blocks, moved, axis, move[axis]);
+        translate(&moved, axis, d);
+        result.moved[axis] = d;
+        result.blocked[axis] = d != move[axis];
+    }
+
+    if (stepHeight > 0.f && (result.blocked.x || result.blocked.z) && resting(blocks, box)) {
+        // Up, across, then back down onto whatever is there
+        AABB stepped = box;
+        glm::vec3 d;
+        d.y = clipAxis(blocks, stepped, 1, stepHeight);
+        translate(&stepped, 1, d.y);
+        d.x = clipAxis(blocks, stepped, 0, move.x);
+        translate(&stepped, 0, d.x);
+        d.z = clipAxis(blocks, stepped, 2, move.z);
+        translate(&stepped, 2, d.z);
+        float down = clipAxis(blocks, stepped, 1, glm::min(move.y, 0.f) - d.y);
+        translate(&stepped, 1, down);
+        d.y += down;
+
+        glm::vec2 across(d.x, d.z), without(result.moved.x, result.moved.z);
+        if (glm::dot(across, across) > glm::dot(without, without) + EPSILON) {
+            result.moved = d;
+            result.blocked = glm::bvec3(d.x != move.x, false, d.z != move.z);
+            result.steppedUp = true;
+            moved = stepped;
+        }
+    }
+
+    result.onGround = resting(blocks, moved);
+    return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "glm_includes.h"
+
+class Terrain;
+
+// An axis-aligned box, given by its minimum and maximum corners
+struct AABB {
+    glm::vec3 min, max;
+};
+
+// What happened to a box moved by sweepAABB
+struct SweepResult {
+    glm::vec3 moved; // How far the box actually went
+    glm::bvec3 blocked; // Axes along which it was stopped short
+    bool onGround; // Resting on top of a block once moved
+    bool steppedUp; // Climbed onto a ledge to get there
+};
+
+// Moves box by move through the terrain, stopping it against solid blocks.
+//
+// Every block the box could touch on the way is gathered once for the
+// whole swept volume. The move is then resolved one axis at a time,
+// vertical first, by clipping it against those blocks; whatever is not
+// blocked along an axis is kept, so boxes slide along walls and floors.
+// Each axis is clipped against every block in the way rather than
+// sampled along it, so this is exact for moves of any length.
+//
+// A box that starts on the ground and is blocked sideways also tries
+// climbing by up to stepHeight first, and does so if that gets it further.
+//
+// Blocks in missing Chunks and below the world count as solid.
+// Only reads the terrain, so any thread may call it.
+SweepResult sweepAABB(const Terrain &terrain, const AABB &box, glm::vec3 move, float stepHeight = 0.f);
@@ -145,7 +145,7 @@ void Cube::createVBOdata()
     generateIdx();
     // Tell OpenGL that we want to perform subsequent operations on the VBO referred to by bufIdx
     // and that it will be treated as an element array buffer (since it will contain triangle indices)
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
+    mp_context->glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
     // Pass the data stored in cyl_idx into the bound buffer, reading a number of bytes equal to
     // SPH_IDX_COUNT multiplied by the size of a GLuint. This data is sent to the GPU to be read by shader programs.
     mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, CUB_IDX_COUNT * sizeof(GLuint), sph_idx, GL_STATIC_DRAW);
@@ -153,25 +153,35 @@ void Cube::createVBOdata()
     // The next few sets of function calls are basically the same as above, except bufPos and bufNor are
     // array buffers rather than element array buffers, as they store vertex attributes like position.
     generatePos();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufPos);
+    mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufPos);
     mp_context->glBufferData(GL_ARRAY_BUFFER, CUB_VERT_COUNT * sizeof(glm::vec4), sph_vert_pos, GL_STATIC_DRAW);
 
     generateNor();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufNor);
+    mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufNor);
     mp_context->glBufferData(GL_ARRAY_BUFFER, CUB_VERT_COUNT * sizeof(glm::vec4), sph_vert_nor, GL_STATIC_DRAW);
 
 }
 
 
-void Cube::createInstancedVBOdata(std::vector<glm::vec3> &offsets, std::vector<glm::vec3> &colors) {
+void Cube::createInstancedVBOdata(std::vector<glm::vec3> &offsets, std::vector<glm::vec3> &scales,
+                                  std::vector<glm::vec3> &colors) {
     m_numInstances = offsets.size();
 
-    generateOffsetBuf();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufPosOffset);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, offsets.size() * sizeof(glm::vec3), offsets.data(), GL_STATIC_DRAW);
+    if(!m_offsetGenerated) {
+        generateOffsetBuf();
+    }
+    mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufPosOffset);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, offsets.size() * sizeof(glm::vec3), offsets.data(), GL_STREAM_DRAW);
 
+    if(!m_scaleGenerated) {
+        generateScaleBuf();
+    }
+    mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufScale);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, scales.size() * sizeof(glm::vec3), scales.data(), GL_STREAM_DRAW);
 
-    generateCol();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufCol);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(glm::vec3), colors.data(), GL_STATIC_DRAW);
+    if(!m_colGenerated) {
+        generateCol();
+    }
+    mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, m_bufCol);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(glm::vec3), colors.data(), GL_STREAM_DRAW);
 }
@@ -13,5 +13,7 @@ public:
     Cube(OpenGLContext* context) : InstancedDrawable(context){}
     virtual ~Cube(){}
     void createVBOdata() override;
-    void createInstancedVBOdata(std::vector<glm::vec3> &offsets, std::vector<glm::vec3> &colors) override;
+    // Can be called every frame; the instance buffers are reused
+    void createInstancedVBOdata(std::vector<glm::vec3> &offsets, std::vector<glm::vec3> &scales,
+                                std::vector<glm::vec3> &colors) override;
 };
@@ -0,0 +1,261 @@
+#include "entitysystem.h"
+#include "terrain.h"
+#include "blockregistry.h"
+#include "parallelfor.h"
+#include "collision.h"
+
+static const float GRAVITY = 25.f; // Blocks per second squared
+static const float TERMINAL_SPEED = 40.f;
+static const float MOB_SPEED = 1.5f;
+static const float MOB_JUMP_SPEED = 8.f; // Enough to hop up one block
+static const float ITEM_FRICTION = 8.f; // Fraction of sliding speed lost per second
+static const float ITEM_LIFETIME = 300.f; // Seconds before a dropped item vanishes
+// How close to the middle of a path cell a mob gets before heading to the next
+static const float WAYPOINT_RADIUS = 0.35f;
+static const float SEPARATION_STIFFNESS = 60.f; // Push apart per block of overlap, in blocks per second squared
+// Smallest range of entities worth handing to another thread
+static const int MIN_BATCH = 256;
+
+static const glm::vec3 HALF_EXTENTS[2] = {
+    glm::vec3(0.3f, 0.9f, 0.3f), // MOB
+    glm::vec3(0.125f), // ITEM_DROP
+};
+static const glm::vec3 COLORS[2] = {
+    glm::vec3(0.85f, 0.45f, 0.35f), // MOB
+    glm::vec3(0.95f, 0.85f, 0.3f), // ITEM_DROP
+};
+
+// Small deterministic hash, so mobs wander the same way whichever
+// thread updates them
+static uint32_t entityRandom(uint32_t id, uint32_t tick) {
+    uint32_t h = id * 0x9E3779B1u ^ tick * 0x85EBCA77u;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    h *= 0x297A2D39u;
+    return h ^ (h >> 15);
+}
+
+EntitySystem::EntitySystem()
+    : m_position(), m_velocity(), m_halfExtent(), m_kind(), m_onGround(),
+      m_age(), m_wanderTimer(), m_path(), m_pathStep(), m_indexOf(), m_ids(), m_freeIds(),
+      m_broadphase(2.f), m_tickCount(0)
+{}
+
+EntityId EntitySystem::spawn(EntityKind kind, glm::vec3 position, glm::vec3 velocity) {
+    EntityId id;
+    if (!m_freeIds.empty()) {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+    } else {
+        id = static_cast<EntityId>(m_indexOf.size());
+        m_indexOf.push_back(0);
+    }
+    m_indexOf[id] = static_cast<uint32_t>(m_ids.size());
+    m_ids.push_back(id);
+
+    m_position.push_back(position);
+    m_velocity.push_back(velocity);
+    m_halfExtent.push_back(HALF_EXTENTS[kind]);
+    m_kind.push_back(kind);
+    m_onGround.push_back(false);
+    m_age.push_back(0.f);
+    m_wanderTimer.push_back(0.f);
+    m_path.push_back(std::vector<glm::ivec3>());
+    m_pathStep.push_back(0);
+    return id;
+}
+
+void EntitySystem::despawn(EntityId id) {
+    if (!isAlive(id)) {
+        return;
+    }
+    uint32_t i = m_indexOf[id];
+    uint32_t last = static_cast<uint32_t>(m_ids.size() - 1);
+    // Fill the hole with the last entity
+    m_position[i] = m_position[last];
+    m_velocity[i] = m_velocity[last];
+    m_halfExtent[i] = m_halfExtent[last];
+    m_kind[i] = m_kind[last];
+    m_onGround[i] = m_onGround[last];
+    m_age[i] = m_age[last];
+    m_wanderTimer[i] = m_wanderTimer[last];
+    m_path[i] = std::move(m_path[last]);
+    m_pathStep[i] = m_pathStep[last];
+    m_ids[i] = m_ids[last];
+    m_indexOf[m_ids[i]] = i;
+
+    m_position.pop_back();
+    m_velocity.pop_back();
+    m_halfExtent.pop_back();
+    m_kind.pop_back();
+    m_onGround.pop_back();
+    m_age.pop_back();
+    m_wanderTimer.pop_back();
+    m_path.pop_back();
+    m_pathStep.pop_back();
+    m_ids.pop_back();
+
+    m_indexOf[id] = INVALID_ENTITY;
+    m_freeIds.push_back(id);
+}
+
+bool EntitySystem::isAlive(EntityId id) const {
+    return id < m_indexOf.size() && m_indexOf[id] != INVALID_ENTITY;
+}
+
+int EntitySystem::count() const {
+    return static_cast<int>(m_ids.size());
+}
+
+glm::vec3 EntitySystem::getPosition(EntityId id) const {
+    return m_position[m_indexOf[id]];
+}
+
+void EntitySystem::getIds(EntityKind kind, std::vector<EntityId> *ids) const {
+    for (size_t i = 0; i < m_ids.size(); i++) {
+        if (m_kind[i] == kind) {
+            ids->push_back(m_ids[i]);
+        }
+    }
+}
+
+void EntitySystem::setPath(EntityId id, std::vector<glm::ivec3> &&path) {
+    if (!isAlive(id)) {
+        return;
+    }
+    uint32_t i = m_indexOf[id];
+    m_path[i] = std::move(path);
+    m_pathStep[i] = 0;
+}
+
+void EntitySystem::steeringSystem(int begin, int end, float seconds) {
+    for (int i = begin; i < end; i++) {
+        glm::vec3 &v = m_velocity[i];
+        if (m_kind[i] == MOB && m_pathStep[i] < m_path[i].size()) {
+            // Head for the middle of the next cell of the path. Steps up
+            // are climbed by the hop in movementSystem.
+            glm::vec3 feet = m_position[i] - glm::vec3(0.f, m_halfExtent[i].y, 0.f);
+            glm::vec3 target = glm::vec3(m_path[i][m_pathStep[i]]) + glm::vec3(0.5f, 0.f, 0.5f);
+            glm::vec2 toTarget(target.x - feet.x, target.z - feet.z);
+            float dist = glm::length(toTarget);
+            if (dist < WAYPOINT_RADIUS && glm::abs(target.y - feet.y) < 1.f) {
+                if (++m_pathStep[i] == m_path[i].size()) {
+                    // Arrived; stand still for a moment before wandering again
+                    m_path[i].clear();
+                    m_pathStep[i] = 0;
+                    m_wanderTimer[i] = 2.f;
+                    v.x = v.z = 0.f;
+                }
+            } else {
+                v.x = toTarget.x / dist * MOB_SPEED;
+                v.z = toTarget.y / dist * MOB_SPEED;
+            }
+        } else if (m_kind[i] == MOB) {
+            m_wanderTimer[i] -= seconds;
+            if (m_wanderTimer[i] <= 0.f) {
+                uint32_t r = entityRandom(m_ids[i], m_tickCount);
+                // A quarter of the time the mob stands still for a while
+                float angle = (r & 0xFFFF) / 65536.f * 6.2831853f;
+                float speed = (r >> 16) % 4 == 0 ? 0.f : MOB_SPEED;
+                v.x = glm::cos(angle) * speed;
+                v.z = glm::sin(angle) * speed;
+                m_wanderTimer[i] = 2.f + ((r >> 18) & 0xFF) / 255.f * 3.f;
+            }
+        } else if (m_onGround[i]) {
+            float keep = glm::max(0.f, 1.f - ITEM_FRICTION * seconds);
+            v.x *= keep;
+            v.z *= keep;
+        }
+        v.y = glm::max(v.y - GRAVITY * seconds, -TERMINAL_SPEED);
+        m_age[i] += seconds;
+    }
+}
+
+void EntitySystem::separationSystem(int begin, int end, float seconds) {
+    for (int i = begin; i < end; i++) {
+        glm::vec3 p = m_position[i], h = m_halfExtent[i];
+        glm::vec2 push(0.f);
+        m_broadphase.forEachNear(p, [&](uint32_t j) {
+            if (j == static_cast<uint32_t>(i)) {
+                return;
+            }
+            glm::vec3 d = p - m_position[j];
+            glm::vec3 overlap = h + m_halfExtent[j] - glm::abs(d);
+            if (overlap.x <= 0.f || overlap.y <= 0.f || overlap.z <= 0.f) {
+                return;
+            }
+            glm::vec2 away(d.x, d.z);
+            float len = glm::length(away);
+            // Entities stacked exactly on top of each other split along x
+            away = len > 1e-4f ? away / len : glm::vec2(i < static_cast<int>(j) ? -1.f : 1.f, 0.f);
+            push += away * glm::min(overlap.x, overlap.z);
+        });
+        m_velocity[i].x += push.x * SEPARATION_STIFFNESS * seconds;
+        m_velocity[i].z += push.y * SEPARATION_STIFFNESS * seconds;
+    }
+}
+
+void EntitySystem::movementSystem(int begin, int end, float seconds, const Terrain &terrain) {
+    for (int i = begin; i < end; i++) {
+        glm::vec3 p = m_position[i], v = m_velocity[i], h = m_halfExtent[i];
+        SweepResult result = sweepAABB(terrain, AABB{p - h, p + h}, v * seconds);
+        if (result.blocked.y) {
+            v.y = 0.f;
+        }
+        for (int a : {0, 2}) {
+            if (!result.blocked[a]) {
+                continue;
+            }
+            if (m_kind[i] == MOB) {
+                // Mobs keep walking and hop up when they run into a wall
+                if (m_onGround[i]) {
+                    v.y = MOB_JUMP_SPEED;
+                }
+            } else {
+                v[a] = 0.f;
+            }
+        }
+        m_position[i] = p + result.moved;
+        m_velocity[i] = v;
+        m_onGround[i] = result.onGround;
+    }
+}
+
+void EntitySystem::tick(float dT, const Terrain &terrain) {
+    if (m_ids.empty()) {
+        return;
+    }
+    float seconds = glm::min(dT * 0.01f, 0.1f);
+    m_tickCount++;
+
+    parallelFor(count(), MIN_BATCH, [&](int begin, int end) {
+        steeringSystem(begin, end, seconds);
+    });
+    m_broadphase.build(m_position);
+    parallelFor(count(), MIN_BATCH, [&](int begin, int end) {
+        separationSystem(begin, end, seconds);
+    });
+    parallelFor(count(), MIN_BATCH, [&](int begin, int end) {
+        movementSystem(begin, end, seconds, terrain);
+    });
+
+    // Removal reorders entities, so it happens after the parallel systems
+    for (int i = count() - 1; i >= 0; i--) {
+        if ((m_kind[i] == ITEM_DROP && m_age[i] > ITEM_LIFETIME) || m_position[i].y < -64.f) {
+            despawn(m_ids[i]);
+        }
+    }
+}
+
+void EntitySystem::getInstanceData(std::vector<glm::vec3> *offsets, std::vector<glm::vec3> *scales,
+                                   std::vector<glm::vec3> *colors) const {
+    offsets->resize(m_ids.size());
+    scales->resize(m_ids.size());
+    colors->resize(m_ids.size());
+    for (size_t i = 0; i < m_ids.size(); i++) {
+        (*offsets)[i] = m_position[i] - m_halfExtent[i];
+        (*scales)[i] = 2.f * m_halfExtent[i];
+        (*colors)[i] = COLORS[m_kind[i]];
+    }
+}
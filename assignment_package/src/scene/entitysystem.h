@@ -0,0 +1,78 @@
+#pragma once
+#include "glm_includes.h"
+#include "spatialhash.h"
+#include <cstdint>
+#include <vector>
+
+class Terrain;
+
+enum EntityKind : unsigned char {
+    MOB, ITEM_DROP
+};
+
+// Stays valid while the entity lives, unlike its index into the
+// component arrays, which changes when other entities are removed
+typedef uint32_t EntityId;
+
+// Simple mobs and dropped items, kept apart from the Entity class
+// hierarchy used by Player and Camera so that thousands of them stay cheap.
+//
+// Components are stored as structure-of-arrays: one densely packed vector
+// per component, all indexed by the same entity index, so each system only
+// touches the data it needs. Removing an entity moves the last one into
+// its slot. Each system is a function over a range of indices that only
+// writes to entities in its range, and runs in parallel through parallelFor.
+class EntitySystem {
+public:
+    static const EntityId INVALID_ENTITY = ~EntityId(0);
+
+    EntitySystem();
+
+    // position is the center of the entity's bounding box.
+    // Velocities are in blocks per second.
+    EntityId spawn(EntityKind kind, glm::vec3 position, glm::vec3 velocity = glm::vec3(0.f));
+    void despawn(EntityId id);
+    bool isAlive(EntityId id) const;
+    int count() const;
+    glm::vec3 getPosition(EntityId id) const;
+    // Appends the id of every live entity of this kind to ids
+    void getIds(EntityKind kind, std::vector<EntityId> *ids) const;
+
+    // Makes a mob walk through these cells (see NavGraph) instead of
+    // wandering, until it reaches the last one
+    void setPath(EntityId id, std::vector<glm::ivec3> &&path);
+
+    // Advances every entity by dT (in MyGL::tick units). Reads terrain from
+    // worker threads, so nothing may modify it until this returns.
+    void tick(float dT, const Terrain &terrain);
+
+    // Per-instance data for drawing every entity as a box with a unit
+    // Cube: each box's minimum corner, size and color
+    void getInstanceData(std::vector<glm::vec3> *offsets, std::vector<glm::vec3> *scales,
+                         std::vector<glm::vec3> *colors) const;
+
+private:
+    // Components, indexed by entity index
+    std::vector<glm::vec3> m_position;
+    std::vector<glm::vec3> m_velocity;
+    std::vector<glm::vec3> m_halfExtent; // Bounding box half size
+    std::vector<EntityKind> m_kind;
+    std::vector<unsigned char> m_onGround;
+    std::vector<float> m_age; // Seconds since spawning
+    std::vector<float> m_wanderTimer; // Seconds until a mob picks a new direction
+    std::vector<std::vector<glm::ivec3>> m_path; // Cells a mob is walking through
+    std::vector<uint32_t> m_pathStep; // Index in m_path of the next cell
+
+    // Index of every live entity's id, and id of every index
+    std::vector<uint32_t> m_indexOf;
+    std::vector<EntityId> m_ids;
+    std::vector<EntityId> m_freeIds;
+
+    SpatialHash m_broadphase;
+    uint32_t m_tickCount;
+
+    // Systems, each run over entity indices [begin, end)
+    void steeringSystem(int begin, int end, float seconds);
+    void separationSystem(int begin, int end, float seconds);
+    void movementSystem(int begin, int end, float seconds, const Terrain &terrain);
+};
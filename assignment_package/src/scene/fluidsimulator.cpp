@@ -0,0 +1,229 @@
+#include "fluidsimulator.h"
+#include "blockregistry.h"
+#include "lightengine.h"
+#include "zoneprefetcher.h"
+#include "fluidworker.h"
+#include <QThreadPool>
+
+// Fluid workers are short, so they go ahead of terrain generation
+static const int FLUID_WORKER_PRIORITY = ZonePrefetcher::RING_PRIORITY + 1;
+
+// Chunk::getChunkContaining, but Chunks still being generated
+// belong to their worker and count as missing
+static const Chunk* resolve(const Chunk *c, int &x, int &z) {
+    const Chunk *n = c->getChunkContaining(x, z);
+    return n != nullptr && n->m_generationState == GENERATED ? n : nullptr;
+}
+
+// Missing Chunks and the bottom of the world act like a wall
+static BlockType blockAt(const Chunk *c, int x, int y, int z) {
+    if (y >= 256) {
+        return EMPTY;
+    } else if (y < 0) {
+        return BEDROCK;
+    }
+    c = resolve(c, x, z);
+    return c == nullptr ? UNDETERMINED : c->getBlockAt(x, y, z);
+}
+
+FluidSimulator::FluidSimulator()
+    : m_tickLength(20.f), m_levels(), m_active(), m_tickTimer(0.f),
+      m_workersInFlight(0), m_workersFinished(0), m_changes(), m_changesLock()
+{}
+
+void FluidSimulator::activate(Chunk *c, int x, int y, int z) {
+    static const int offsets[7][3] = {
+        {0, 0, 0}, {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}
+    };
+    for (const int *o : offsets) {
+        int nx = x + o[0], ny = y + o[1], nz = z + o[2];
+        if (ny < 0 || ny >= 256) {
+            continue;
+        }
+        // Only generated Chunks can be resolved, so this cast is safe
+        Chunk *n = const_cast<Chunk*>(resolve(c, nx, nz));
+        if (n != nullptr) {
+            m_active[n].insert(blockIndex(nx, ny, nz));
+        }
+    }
+}
+
+void FluidSimulator::onBlockEdited(Chunk *c, int x, int y, int z) {
+    int i = blockIndex(x, y, z);
+    if (m_workersInFlight > 0) {
+        // Workers may be reading m_levels
+        m_edited[c].insert(i);
+    } else {
+        auto chunkLevels = m_levels.find(c);
+        if (chunkLevels != m_levels.end()) {
+            chunkLevels->second.erase(i);
+        }
+    }
+    activate(c, x, y, z);
+}
+
+unsigned char FluidSimulator::getLevel(const Chunk *c, int x, int y, int z) const {
+    c = resolve(c, x, z);
+    if (c == nullptr) {
+        return SOURCE_LEVEL;
+    }
+    auto chunkLevels = m_levels.find(c);
+    if (chunkLevels == m_levels.end()) {
+        return SOURCE_LEVEL;
+    }
+    auto level = chunkLevels->second.find(blockIndex(x, y, z));
+    return level == chunkLevels->second.end() ? SOURCE_LEVEL : level->second;
+}
+
+bool FluidSimulator::nextState(const Chunk *c, int x, int y, int z,
+                               BlockType *newType, unsigned char *newLevel) const {
+    BlockType t = c->getBlockAt(x, y, z);
+    unsigned char level = isFluid(t) ? getLevel(c, x, y, z) : SOURCE_LEVEL;
+    // Sources never change, and fluid never flows into anything but air
+    if ((isFluid(t) && level == SOURCE_LEVEL) || (t != EMPTY && !isFluid(t))) {
+        return false;
+    }
+
+    BlockType bestType = EMPTY;
+    int bestLevel = 256;
+    BlockType above = blockAt(c, x, y + 1, z);
+    if (isFluid(above)) {
+        // Falling fluid refills its full sideways range where it lands
+        bestType = above;
+        bestLevel = 1;
+    } else {
+        static const int sides[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+        for (const int *s : sides) {
+            int nx = x + s[0], nz = z + s[1];
+            BlockType n = blockAt(c, nx, y, nz);
+            if (!isFluid(n)) {
+                continue;
+            }
+            int nLevel = getLevel(c, nx, y, nz);
+            // Flowing fluid only spreads sideways once it has landed
+            if (nLevel != SOURCE_LEVEL && !isSolid(blockAt(c, nx, y - 1, nz))) {
+                continue;
+            }
+            int candidate = nLevel + 1;
+            if (candidate > flowRange(n)) {
+                continue;
+            }
+            if (candidate < bestLevel || (candidate == bestLevel && n == WATER)) {
+                bestType = n;
+                bestLevel = candidate;
+            }
+        }
+    }
+
+    if (bestType == EMPTY) {
+        if (t == EMPTY) {
+            return false;
+        }
+        *newType = EMPTY;
+        *newLevel = SOURCE_LEVEL;
+        return true;
+    }
+    if (bestType == t && bestLevel == level) {
+        return false;
+    }
+    *newType = bestType;
+    *newLevel = static_cast<unsigned char>(bestLevel);
+    return true;
+}
+
+int FluidSimulator::activeBlockCount() const {
+    int count = 0;
+    for (const auto &chunkBlocks : m_active) {
+        count += static_cast<int>(chunkBlocks.second.size());
+    }
+    return count;
+}
+
+void FluidSimulator::reportChanges(const std::vector<BlockChange> &changes) {
+    m_changesLock.lock();
+    m_changes.insert(m_changes.end(), changes.begin(), changes.end());
+    m_workersFinished++;
+    m_changesLock.unlock();
+}
+
+void FluidSimulator::update(float dT, std::unordered_set<Chunk*> *changed) {
+    m_tickTimer += dT;
+
+    if (m_workersInFlight > 0) {
+        m_changesLock.lock();
+        bool done = m_workersFinished == m_workersInFlight;
+        m_changesLock.unlock();
+        if (!done) {
+            return;
+        }
+        applyChanges(changed);
+    }
+
+    if (m_tickTimer < m_tickLength || m_active.empty()) {
+        return;
+    }
+    m_tickTimer = 0.f;
+
+    std::unordered_map<Chunk*, std::unordered_set<int>> active;
+    std::swap(active, m_active);
+    m_workersInFlight = static_cast<int>(active.size());
+    for (auto &chunkBlocks : active) {
+        std::vector<int> blocks(chunkBlocks.second.begin(), chunkBlocks.second.end());
+        QThreadPool::globalInstance()->start(new FluidWorker(this, chunkBlocks.first, std::move(blocks)),
+                                             FLUID_WORKER_PRIORITY);
+    }
+}
+
+void FluidSimulator::applyChanges(std::unordered_set<Chunk*> *changed) {
+    m_changesLock.lock();
+    std::vector<BlockChange> changes;
+    std::swap(changes, m_changes);
+    m_workersInFlight = 0;
+    m_workersFinished = 0;
+    m_changesLock.unlock();
+
+    for (const BlockChange &ch : changes) {
+        Chunk *c = ch.chunk;
+        BlockType t = c->getBlockAt(ch.x, ch.y, ch.z);
+        if (t != ch.expectedType) {
+            continue;
+        }
+
+        int i = blockIndex(ch.x, ch.y, ch.z);
+        // Worked out from the block as it was before the edit
+        auto edited = m_edited.find(c);
+        if (edited != m_edited.end() && edited->second.count(i)) {
+            continue;
+        }
+        if (ch.newType == EMPTY) {
+            m_levels[c].erase(i);
+        } else {
+            m_levels[c][i] = ch.newLevel;
+        }
+        activate(c, ch.x, ch.y, ch.z);
+        // A new flow level alone does not change how the block looks
+        if (ch.newType == t) {
+            continue;
+        }
+
+        c->setBlockAt(ch.x, ch.y, ch.z, ch.newType);
+        changed->insert(c);
+        LightEngine::onBlockChanged(c, ch.x, ch.y, ch.z, changed);
+        if (ch.x == 0) changed->insert(c->getNeighbor(XNEG));
+        if (ch.x == 15) changed->insert(c->getNeighbor(XPOS));
+        if (ch.z == 0) changed->insert(c->getNeighbor(ZNEG));
+        if (ch.z == 15) changed->insert(c->getNeighbor(ZPOS));
+    }
+    changed->erase(nullptr);
+
+    for (const auto &chunkBlocks : m_edited) {
+        auto chunkLevels = m_levels.find(chunkBlocks.first);
+        if (chunkLevels == m_levels.end()) {
+            continue;
+        }
+        for (int i : chunkBlocks.second) {
+            chunkLevels->second.erase(i);
+        }
+    }
+    m_edited.clear();
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "chunk.h"
+#include <QMutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// A block a FluidWorker wants changed. The world may be edited while
+// the worker runs, so it is only applied if the block still has the
+// type the worker saw.
+struct BlockChange {
+    Chunk *chunk;
+    unsigned char x, y, z;
+    BlockType expectedType;
+    BlockType newType;
+    unsigned char newLevel;
+};
+
+// Cellular automaton for WATER and LAVA. Every fluid block has a flow
+// level: 0 for the source blocks made by terrain generation, and the
+// number of blocks travelled sideways from a source for flowing ones.
+// Fluid falls straight down, spreads sideways off anything solid up to
+// its flowRange, and drains away once nothing feeds it.
+//
+// Only blocks in the active set are evaluated. A block becomes active
+// when it or one of its neighbors changes, so a still world costs
+// nothing and the work per tick grows with the number of changing
+// blocks rather than the size of the world.
+//
+// Each tick the active blocks are split up by Chunk and evaluated in
+// parallel, one FluidWorker per Chunk. Workers only read the world,
+// including their neighbors' border blocks, and return the changes they
+// want; every change is then applied together on the main thread, so all
+// Chunks see the same snapshot of the previous tick.
+class FluidSimulator {
+public:
+    static const unsigned char SOURCE_LEVEL = 0;
+    // Time between ticks, in the same units as the dT passed to update()
+    float m_tickLength;
+
+private:
+    // Flow level of every non-source fluid block, by Chunk and block index.
+    // Fluid blocks without an entry are sources. Only written while no
+    // FluidWorkers are running.
+    std::unordered_map<const Chunk*, std::unordered_map<int, unsigned char>> m_levels;
+    // Block indices to evaluate on the next tick, by Chunk
+    std::unordered_map<Chunk*, std::unordered_set<int>> m_active;
+    // Blocks edited while FluidWorkers were running, by Chunk. Their
+    // levels are cleared, and the workers' changes to them dropped,
+    // once the workers are done.
+    std::unordered_map<Chunk*, std::unordered_set<int>> m_edited;
+
+    float m_tickTimer;
+    int m_workersInFlight;
+    int m_workersFinished;
+    std::vector<BlockChange> m_changes;
+    QMutex m_changesLock;
+
+    void applyChanges(std::unordered_set<Chunk*> *changed);
+
+public:
+    FluidSimulator();
+
+    // Marks the block at local x, y, z of c and its six neighbors
+    // to be evaluated on the next tick. Main thread only.
+    void activate(Chunk *c, int x, int y, int z);
+    // Call after anything but the simulation itself changes the block at
+    // local x, y, z of c. Whatever it is now, it has no flow level: a
+    // fluid placed there is a source. Also activates it. Main thread only.
+    void onBlockEdited(Chunk *c, int x, int y, int z);
+
+    // Advances the simulation clock. Once the workers from the last tick
+    // are done their changes are applied, and every Chunk whose blocks
+    // changed is added to changed so it can be remeshed. Main thread only.
+    void update(float dT, std::unordered_set<Chunk*> *changed);
+
+    // Flow level of the fluid block at local x, y, z of c. The
+    // coordinates may reach one block into a neighboring Chunk.
+    unsigned char getLevel(const Chunk *c, int x, int y, int z) const;
+
+    // What the block at local x, y, z of c should turn into given its
+    // neighbors. Returns false if it should stay as it is.
+    // Only reads the world, so workers may call it concurrently.
+    bool nextState(const Chunk *c, int x, int y, int z,
+                   BlockType *newType, unsigned char *newLevel) const;
+
+    // Number of blocks waiting to be evaluated
+    int activeBlockCount() const;
+
+    // Called by each FluidWorker when it is done
+    void reportChanges(const std::vector<BlockChange> &changes);
+};
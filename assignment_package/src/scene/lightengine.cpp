@@ -0,0 +1,279 @@
+#include "lightengine.h"
+#include "blockregistry.h"
+#include <algorithm>
+#include <cstring>
+
+static const Direction ALL_DIRECTIONS[6] = {XPOS, XNEG, YPOS, YNEG, ZPOS, ZNEG};
+
+unsigned char LightEngine::getLevel(const LightNode &n, Channel ch) {
+    unsigned char light = n.chunk->m_light[blockIndex(n.x, n.y, n.z)];
+    return ch == SKY ? skyLight(light) : blockLight(light);
+}
+
+void LightEngine::setLevel(const LightNode &n, Channel ch, unsigned char level) {
+    unsigned char &light = n.chunk->m_light[blockIndex(n.x, n.y, n.z)];
+    light = ch == SKY ? packLight(level, blockLight(light)) : packLight(skyLight(light), level);
+}
+
+BlockType LightEngine::getBlock(const LightNode &n) {
+    return n.chunk->m_blocks[blockIndex(n.x, n.y, n.z)];
+}
+
+bool LightEngine::step(const LightNode &n, Direction dir, LightNode *out) {
+    *out = n;
+    switch(dir) {
+    case XPOS:
+        if(n.x == 15) {
+            out->chunk = n.chunk->getNeighbor(XPOS);
+            out->x = 0;
+        } else {
+            out->x++;
+        }
+        break;
+    case XNEG:
+        if(n.x == 0) {
+            out->chunk = n.chunk->getNeighbor(XNEG);
+            out->x = 15;
+        } else {
+            out->x--;
+        }
+        break;
+    case YPOS:
+        if(n.y == 255) {
+            return false;
+        }
+        out->y++;
+        break;
+    case YNEG:
+        if(n.y == 0) {
+            return false;
+        }
+        out->y--;
+        break;
+    case ZPOS:
+        if(n.z == 15) {
+            out->chunk = n.chunk->getNeighbor(ZPOS);
+            out->z = 0;
+        } else {
+            out->z++;
+        }
+        break;
+    case ZNEG:
+        if(n.z == 0) {
+            out->chunk = n.chunk->getNeighbor(ZNEG);
+            out->z = 15;
+        } else {
+            out->z--;
+        }
+        break;
+    }
+    return out->chunk != nullptr;
+}
+
+bool LightEngine::stepGenerated(const LightNode &n, Direction dir, LightNode *out) {
+    // Chunks still being generated belong to their worker thread
+    return step(n, dir, out) && out->chunk->m_generationState == GENERATED;
+}
+
+unsigned char LightEngine::spreadLevel(unsigned char level, Channel ch, Direction dir, BlockType into) {
+    if(level == 0 || isOpaque(into)) {
+        return 0;
+    }
+    // Full sunlight falls through air without fading
+    if(ch == SKY && dir == YNEG && level == MAX_LIGHT && into == EMPTY) {
+        return MAX_LIGHT;
+    }
+    return level - 1;
+}
+
+void LightEngine::propagate(std::vector<LightNode> &queue, Channel ch,
+                            std::unordered_set<Chunk*> *changed, Chunk *only) {
+    for(size_t head = 0; head < queue.size(); head++) {
+        LightNode n = queue[head];
+        unsigned char level = getLevel(n, ch);
+        if(level <= 1) {
+            continue;
+        }
+        for(Direction dir : ALL_DIRECTIONS) {
+            LightNode m;
+            bool inRange = only != nullptr ? step(n, dir, &m) && m.chunk == only
+                                           : stepGenerated(n, dir, &m);
+            if(!inRange) {
+                continue;
+            }
+            unsigned char spread = spreadLevel(level, ch, dir, getBlock(m));
+            if(spread > getLevel(m, ch)) {
+                setLevel(m, ch, spread);
+                if(changed != nullptr) {
+                    changed->insert(m.chunk);
+                }
+                queue.push_back(m);
+            }
+        }
+    }
+}
+
+void LightEngine::unpropagate(std::vector<LightNode> &queue, Channel ch,
+                              std::unordered_set<Chunk*> *changed) {
+    std::vector<LightNode> refill;
+    for(size_t head = 0; head < queue.size(); head++) {
+        LightNode n = queue[head];
+        for(Direction dir : ALL_DIRECTIONS) {
+            LightNode m;
+            if(!stepGenerated(n, dir, &m)) {
+                continue;
+            }
+            unsigned char level = getLevel(m, ch);
+            if(level == 0) {
+                continue;
+            }
+            // m was lit through n if its light is what n's would have
+            // spread to it (or less); otherwise it has another source
+            // and will refill the darkened region
+            bool litThroughN = level < n.level
+                    || (ch == SKY && dir == YNEG && n.level == MAX_LIGHT && level == MAX_LIGHT);
+            if(litThroughN) {
+                m.level = level;
+                setLevel(m, ch, 0);
+                changed->insert(m.chunk);
+                queue.push_back(m);
+            } else {
+                refill.push_back(m);
+            }
+        }
+        // Emitters inside the darkened region light it back up
+        if(ch == BLOCK && lightEmission(getBlock(n)) > 0) {
+            setLevel(n, ch, lightEmission(getBlock(n)));
+            refill.push_back(n);
+        }
+    }
+    propagate(refill, ch, changed, nullptr);
+}
+
+void LightEngine::lightChunk(Chunk *c) {
+    std::memset(c->m_light.data(), 0, c->m_light.size());
+    int maxHeight = c->getMaxHeight();
+
+    std::vector<LightNode> skyQueue, blockQueue;
+    for(int z = 0; z < 16; z++) {
+        for(int x = 0; x < 16; x++) {
+            // Columns are contiguous, so open sky above the column's
+            // highest block is a single memset
+            int top = c->getColumnMaxHeight(x, z);
+            unsigned char *column = &c->m_light[blockIndex(x, 0, z)];
+            std::memset(column + top + 1, packLight(MAX_LIGHT, 0), 255 - top);
+
+            // Sunlight falls straight down until something opaque
+            // stops it, dimming once it has passed through a liquid
+            unsigned char level = MAX_LIGHT;
+            int y = top;
+            for(; y >= 0; y--) {
+                level = spreadLevel(level, SKY, YNEG, c->m_blocks[blockIndex(x, y, z)]);
+                if(level == 0) {
+                    break;
+                }
+                column[y] = packLight(level, 0);
+            }
+            // Only the sunlit blocks at or below the terrain's top can
+            // spread light sideways into anything darker
+            for(int ly = std::min(maxHeight + 1, 255); ly > y && ly >= 0; ly--) {
+                if(skyLight(column[ly]) > 1) {
+                    skyQueue.push_back(LightNode{c, (unsigned char)x, (unsigned char)ly, (unsigned char)z, 0});
+                }
+            }
+
+            for(int ly = c->getColumnMinHeight(x, z); ly >= 0 && ly <= top; ly++) {
+                unsigned char emission = lightEmission(c->m_blocks[blockIndex(x, ly, z)]);
+                if(emission > 0) {
+                    column[ly] = packLight(skyLight(column[ly]), emission);
+                    blockQueue.push_back(LightNode{c, (unsigned char)x, (unsigned char)ly, (unsigned char)z, 0});
+                }
+            }
+        }
+    }
+    propagate(skyQueue, SKY, nullptr, c);
+    propagate(blockQueue, BLOCK, nullptr, c);
+}
+
+void LightEngine::pullBorderLight(Chunk *c) {
+    struct Border {
+        Direction dir; // Toward the neighbor
+        Direction back; // From the neighbor into c
+        int x0, z0, dx, dz; // First block along this edge of c and the step along it
+    };
+    static const Border borders[4] = {
+        {XPOS, XNEG, 15, 0, 0, 1}, {XNEG, XPOS, 0, 0, 0, 1},
+        {ZPOS, ZNEG, 0, 15, 1, 0}, {ZNEG, ZPOS, 0, 0, 1, 0},
+    };
+
+    std::vector<LightNode> skyQueue, blockQueue;
+    for(const Border &b : borders) {
+        Chunk *n = c->getNeighbor(b.dir);
+        if(n == nullptr || n->m_generationState != GENERATED) {
+            continue;
+        }
+        // Above both Chunks' terrain everything is already full sunlight
+        int maxY = std::min(255, std::max(c->getMaxHeight(), n->getMaxHeight()) + 1);
+        for(int i = 0; i < 16; i++) {
+            LightNode here{c, (unsigned char)(b.x0 + b.dx * i), 0, (unsigned char)(b.z0 + b.dz * i), 0};
+            LightNode there;
+            for(int y = 0; y <= maxY; y++) {
+                here.y = y;
+                step(here, b.dir, &there);
+                BlockType t = getBlock(here);
+                unsigned char sky = spreadLevel(getLevel(there, SKY), SKY, b.back, t);
+                unsigned char block = spreadLevel(getLevel(there, BLOCK), BLOCK, b.back, t);
+                if(sky > getLevel(here, SKY)) {
+                    setLevel(here, SKY, sky);
+                    skyQueue.push_back(here);
+                }
+                if(block > getLevel(here, BLOCK)) {
+                    setLevel(here, BLOCK, block);
+                    blockQueue.push_back(here);
+                }
+            }
+        }
+    }
+    propagate(skyQueue, SKY, nullptr, c);
+    propagate(blockQueue, BLOCK, nullptr, c);
+}
+
+void LightEngine::onBlockChanged(Chunk *c, int x, int y, int z,
+                                 std::unordered_set<Chunk*> *changed) {
+    LightNode p{c, (unsigned char)x, (unsigned char)y, (unsigned char)z, 0};
+    BlockType t = getBlock(p);
+
+    for(Channel ch : {SKY, BLOCK}) {
+        // Take away whatever light passed through this block...
+        unsigned char old = getLevel(p, ch);
+        std::vector<LightNode> removal;
+        if(old > 0) {
+            p.level = old;
+            setLevel(p, ch, 0);
+            changed->insert(c);
+            removal.push_back(p);
+            unpropagate(removal, ch, changed);
+        }
+
+        // ...then let the neighbors (and the block itself, if it
+        // glows) light it back up as far as its new type allows
+        std::vector<LightNode> refill;
+        if(ch == BLOCK && lightEmission(t) > getLevel(p, ch)) {
+            setLevel(p, ch, lightEmission(t));
+            changed->insert(c);
+            refill.push_back(p);
+        }
+        for(Direction dir : ALL_DIRECTIONS) {
+            LightNode m;
+            if(stepGenerated(p, dir, &m) && getLevel(m, ch) > 0) {
+                refill.push_back(m);
+            }
+        }
+        // Open sky above the world's top block
+        if(ch == SKY && y == 255 && !isOpaque(t) && getLevel(p, ch) < MAX_LIGHT) {
+            setLevel(p, ch, MAX_LIGHT);
+            refill.push_back(p);
+        }
+        propagate(refill, ch, changed, nullptr);
+    }
+}
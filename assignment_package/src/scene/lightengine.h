@@ -0,0 +1,66 @@
+#pragma once
+#include "chunk.h"
+#include <unordered_set>
+#include <vector>
+
+// Flood-fill voxel lighting with two channels per block:
+// sky light, which enters from the top of the world and travels
+// straight down through air without dimming, and block light,
+// which spreads from emitting blocks such as lava. Both lose one
+// level per block travelled otherwise and are stopped by opaque blocks.
+//
+// New Chunks are lit on their generation worker with a BFS that stays
+// inside the Chunk. Light that crosses Chunk borders is pulled in from
+// the neighbors right before a Chunk is meshed. Block edits relight only
+// the area they affect, using the usual removal-then-refill BFS.
+class LightEngine {
+public:
+    static const unsigned char MAX_LIGHT = 15;
+
+    // Computes sky and block light for a freshly generated Chunk,
+    // ignoring its neighbors. Safe to call from a worker thread as
+    // long as nothing else is touching c.
+    static void lightChunk(Chunk *c);
+
+    // Spreads light from the border blocks of c's neighbors into c.
+    // Only modifies c. Call on the main thread before meshing c.
+    static void pullBorderLight(Chunk *c);
+
+    // Relights around the block at local x, y, z of c after it changed
+    // type. The block must already hold its new type. Every Chunk whose
+    // light changed is added to changed.
+    static void onBlockChanged(Chunk *c, int x, int y, int z,
+                               std::unordered_set<Chunk*> *changed);
+
+private:
+    enum Channel { SKY, BLOCK };
+
+    // One block in a BFS queue
+    struct LightNode {
+        Chunk *chunk;
+        unsigned char x, y, z;
+        unsigned char level; // Only used by the removal pass
+    };
+
+    static unsigned char getLevel(const LightNode &n, Channel ch);
+    static void setLevel(const LightNode &n, Channel ch, unsigned char level);
+    static BlockType getBlock(const LightNode &n);
+    // Finds the block next to n in direction dir. Returns false
+    // if it is outside the world or in a Chunk that does not exist.
+    static bool step(const LightNode &n, Direction dir, LightNode *out);
+    // Like step, but also fails for Chunks that are not done generating
+    static bool stepGenerated(const LightNode &n, Direction dir, LightNode *out);
+    // The level light at the given level has after moving one block
+    // in direction dir into a block of type into
+    static unsigned char spreadLevel(unsigned char level, Channel ch, Direction dir, BlockType into);
+
+    // Breadth-first spreads light outward from every node in queue.
+    // If only is not null the fill never leaves that Chunk.
+    static void propagate(std::vector<LightNode> &queue, Channel ch,
+                          std::unordered_set<Chunk*> *changed, Chunk *only);
+    // Darkens everything that was lit through the nodes in queue (whose
+    // level holds the light they had), then refills from the edges of
+    // the darkened region.
+    static void unpropagate(std::vector<LightNode> &queue, Channel ch,
+                            std::unordered_set<Chunk*> *changed);
+};
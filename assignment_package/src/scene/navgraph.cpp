@@ -0,0 +1,573 @@
+#include "navgraph.h"
+#include "terrain.h"
+#include "blockregistry.h"
+#include "zoneprefetcher.h"
+#include "navclusterworker.h"
+#include "pathworker.h"
+#include <QThreadPool>
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+// Path requests are short, so they go ahead of terrain generation.
+// Cluster rebuilds wait behind it, like meshing.
+static const int PATH_WORKER_PRIORITY = ZonePrefetcher::RING_PRIORITY + 1;
+static const int CLUSTER_WORKER_PRIORITY = 0;
+
+static const float STEP_COST = 1.f;
+static const float CLIMB_COST = 0.5f; // Extra for stepping up or down a block
+// How many blocks below a requested position to look for a cell
+static const int SNAP_DEPTH = 4;
+
+static float stepCost(int dy) {
+    return dy == 0 ? STEP_COST : STEP_COST + CLIMB_COST;
+}
+
+// A cell as found by scanning its column
+struct ColumnCell {
+    unsigned char y;
+    unsigned char clearance;
+};
+
+// Appends the cells of local column x, z of c, lowest first.
+// Nothing can stand on the bottom of the world.
+static void scanColumn(const Chunk *c, int x, int z, std::vector<ColumnCell> *out) {
+    int top = c->getColumnMaxHeight(x, z);
+    if (top < 0) {
+        return;
+    }
+    // Solidity of heights 0 up to top + 3; everything above top is empty
+    int height = std::min(top + 1, 255);
+    bool solid[260] = {};
+    for (int y = 0; y <= top; y++) {
+        solid[y] = isSolid(c->getBlockAt(x, y, z));
+    }
+    for (int y = 1; y <= height; y++) {
+        if (solid[y - 1] && !solid[y] && !solid[y + 1]) {
+            out->push_back(ColumnCell{static_cast<unsigned char>(y),
+                                      static_cast<unsigned char>(solid[y + 2] ? 2 : 3)});
+        }
+    }
+}
+
+// Appends the cells k already holds for local column x, z, lowest first
+static void clusterColumn(const NavCluster &k, int x, int z, std::vector<ColumnCell> *out) {
+    int column = x + 16 * z;
+    for (int i = k.columnStart[column]; i < k.columnStart[column + 1]; i++) {
+        out->push_back(ColumnCell{k.cellY[i], k.cellClearance[i]});
+    }
+}
+
+static bool canStep(ColumnCell a, ColumnCell b) {
+    int dy = b.y - a.y;
+    if (dy == 0) {
+        return true;
+    } else if (dy == 1) {
+        return a.clearance >= 3;
+    } else if (dy == -1) {
+        return b.clearance >= 3;
+    }
+    return false;
+}
+
+// Calls f(neighbor) for every cell of k a mob can step to from cell
+template <typename F>
+static void forEachStep(const NavCluster &k, int cell, F f) {
+    static const int sides[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    int column = k.cellColumn[cell];
+    int x = column & 15, z = column >> 4;
+    ColumnCell here{k.cellY[cell], k.cellClearance[cell]};
+    for (const int *s : sides) {
+        int nx = x + s[0], nz = z + s[1];
+        if (nx < 0 || nx >= 16 || nz < 0 || nz >= 16) {
+            continue;
+        }
+        int n = nx + 16 * nz;
+        for (int i = k.columnStart[n]; i < k.columnStart[n + 1]; i++) {
+            if (canStep(here, ColumnCell{k.cellY[i], k.cellClearance[i]})) {
+                f(i);
+            }
+        }
+    }
+}
+
+// Dijkstra from source over the cells of k, or A* if target is not -1.
+// dist and prev are filled in for every cell reached.
+static void searchCluster(const NavCluster &k, int source, int target,
+                          std::vector<float> *dist, std::vector<int> *prev) {
+    dist->assign(k.cellCount(), NavGraph::NO_PATH);
+    prev->assign(k.cellCount(), -1);
+    glm::ivec3 goal = target >= 0 ? k.cellPos(target) : glm::ivec3(0);
+    auto heuristic = [&](int cell) {
+        if (target < 0) {
+            return 0.f;
+        }
+        glm::ivec3 p = k.cellPos(cell);
+        return STEP_COST * (std::abs(p.x - goal.x) + std::abs(p.z - goal.z));
+    };
+
+    typedef std::pair<float, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    (*dist)[source] = 0.f;
+    open.push(Entry(heuristic(source), source));
+    while (!open.empty()) {
+        int cell = open.top().second;
+        float f = open.top().first;
+        open.pop();
+        float g = (*dist)[cell];
+        if (f > g + heuristic(cell)) {
+            continue; // Already reached more cheaply
+        }
+        if (cell == target) {
+            return;
+        }
+        forEachStep(k, cell, [&](int n) {
+            float cost = g + stepCost(k.cellY[n] - k.cellY[cell]);
+            if (cost < (*dist)[n]) {
+                (*dist)[n] = cost;
+                (*prev)[n] = cell;
+                open.push(Entry(cost + heuristic(n), n));
+            }
+        });
+    }
+}
+
+// The cells from cell back to the source of the search that filled prev
+static std::vector<int> traceBack(const std::vector<int> &prev, int cell) {
+    std::vector<int> cells;
+    for (; cell >= 0; cell = prev[cell]) {
+        cells.push_back(cell);
+    }
+    return cells;
+}
+
+template <typename It>
+static void appendCells(const NavCluster &k, It begin, It end, std::vector<glm::ivec3> *path) {
+    for (auto it = begin; it != end; ++it) {
+        path->push_back(k.cellPos(*it));
+    }
+}
+
+// Groups the ways across one border into entrances. steps[i] holds the
+// heights (on the lower Chunk's side, then the other) of every pair of
+// cells that can be stepped between at position i along the border.
+// Neighboring pairs that are no more than a block apart on both sides
+// form one entrance, represented by its middle pair as (i, lower side's
+// height, other side's height).
+static std::vector<glm::ivec3> findEntrances(const std::array<std::vector<glm::ivec2>, 16> &steps) {
+    struct Run {
+        int last; // Position of the last pair
+        std::vector<glm::ivec3> pairs;
+    };
+    std::vector<Run> open;
+    std::vector<glm::ivec3> entrances;
+    auto close = [&](const Run &r) {
+        entrances.push_back(r.pairs[r.pairs.size() / 2]);
+    };
+    for (int i = 0; i < 16; i++) {
+        for (glm::ivec2 s : steps[i]) {
+            auto run = std::find_if(open.begin(), open.end(), [&](const Run &r) {
+                glm::ivec3 end = r.pairs.back();
+                return r.last == i - 1 && std::abs(end.y - s.x) <= 1 && std::abs(end.z - s.y) <= 1;
+            });
+            if (run != open.end()) {
+                run->last = i;
+                run->pairs.push_back(glm::ivec3(i, s.x, s.y));
+            } else {
+                open.push_back(Run{i, {glm::ivec3(i, s.x, s.y)}});
+            }
+        }
+        for (auto it = open.begin(); it != open.end();) {
+            if (it->last != i) {
+                close(*it);
+                it = open.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (const Run &r : open) {
+        close(r);
+    }
+    return entrances;
+}
+
+int NavCluster::cellCount() const {
+    return static_cast<int>(cellY.size());
+}
+
+int NavCluster::findCell(int x, int y, int z) const {
+    int column = x + 16 * z;
+    for (int i = columnStart[column]; i < columnStart[column + 1]; i++) {
+        if (cellY[i] == y) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+glm::ivec3 NavCluster::cellPos(int cell) const {
+    int column = cellColumn[cell];
+    return glm::ivec3(origin.x + (column & 15), cellY[cell], origin.y + (column >> 4));
+}
+
+int NavCluster::findPortal(glm::ivec3 pos, glm::ivec3 link) const {
+    for (size_t i = 0; i < portals.size(); i++) {
+        if (portals[i].pos == pos && portals[i].link == link) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+NavGraph::NavGraph()
+    : m_maxBuildsInFlight(4), m_maxSearchNodes(20000),
+      m_clusters(), m_clustersLock(), m_dirty(), m_building(),
+      m_built(), m_builtLock(), m_nextTicket(0), m_paths(), m_pathsLock()
+{}
+
+void NavGraph::markDirty(Chunk *c) {
+    if (c != nullptr && c->m_generationState == GENERATED) {
+        m_dirty.insert(c);
+    }
+}
+
+void NavGraph::onChunkGenerated(Chunk *c) {
+    markDirty(c);
+    // Their borders with c had no entrances until now
+    for (Direction dir : {XPOS, XNEG, ZPOS, ZNEG}) {
+        markDirty(c->getNeighbor(dir));
+    }
+}
+
+void NavGraph::onBlockChanged(Chunk *c, int x, int z) {
+    markDirty(c);
+    if (x == 0) markDirty(c->getNeighbor(XNEG));
+    if (x == 15) markDirty(c->getNeighbor(XPOS));
+    if (z == 0) markDirty(c->getNeighbor(ZNEG));
+    if (z == 15) markDirty(c->getNeighbor(ZPOS));
+}
+
+void NavGraph::update() {
+    std::vector<std::pair<Chunk*, std::shared_ptr<const NavCluster>>> built;
+    m_builtLock.lock();
+    std::swap(built, m_built);
+    m_builtLock.unlock();
+    if (!built.empty()) {
+        QMutexLocker locker(&m_clustersLock);
+        for (const auto &b : built) {
+            m_clusters[toKey(b.second->origin.x, b.second->origin.y)] = b.second;
+        }
+    }
+    // A Chunk edited while it was being rebuilt is still dirty, so it
+    // is rebuilt again once this one is in
+    for (const auto &b : built) {
+        m_building.erase(b.first);
+    }
+
+    for (auto it = m_dirty.begin();
+         it != m_dirty.end() && static_cast<int>(m_building.size()) < m_maxBuildsInFlight;) {
+        if (m_building.count(*it)) {
+            ++it;
+            continue;
+        }
+        m_building.insert(*it);
+        QThreadPool::globalInstance()->start(new NavClusterWorker(this, *it), CLUSTER_WORKER_PRIORITY);
+        it = m_dirty.erase(it);
+    }
+}
+
+std::shared_ptr<const NavCluster> NavGraph::buildCluster(const Chunk *c) {
+    std::shared_ptr<NavCluster> k = std::make_shared<NavCluster>();
+    k->origin = c->m_coords;
+
+    std::vector<ColumnCell> cells;
+    for (int column = 0; column < 256; column++) {
+        k->columnStart[column] = static_cast<uint16_t>(cells.size());
+        scanColumn(c, column & 15, column >> 4, &cells);
+        k->cellColumn.resize(cells.size(), static_cast<unsigned char>(column));
+    }
+    k->columnStart[256] = static_cast<uint16_t>(cells.size());
+    for (const ColumnCell &cell : cells) {
+        k->cellY.push_back(cell.y);
+        k->cellClearance.push_back(cell.clearance);
+    }
+
+    for (Direction dir : {XPOS, XNEG, ZPOS, ZNEG}) {
+        const Chunk *n = c->getNeighbor(dir);
+        if (n == nullptr || n->m_generationState != GENERATED) {
+            continue;
+        }
+        // Both Chunks must place the same portals on their shared border,
+        // so the one with the lower coordinates is always scanned first
+        bool lowerSide = dir == XPOS || dir == ZPOS;
+        const Chunk *a = lowerSide ? c : n, *b = lowerSide ? n : c;
+        bool alongZ = dir == XPOS || dir == XNEG;
+
+        std::array<std::vector<glm::ivec2>, 16> steps;
+        std::vector<ColumnCell> cellsA, cellsB;
+        for (int i = 0; i < 16; i++) {
+            cellsA.clear();
+            cellsB.clear();
+            // c may be edited while this runs, so its own border uses the
+            // cells found above; every portal then lands on one of them
+            if (lowerSide) {
+                clusterColumn(*k, alongZ ? 15 : i, alongZ ? i : 15, &cellsA);
+                scanColumn(b, alongZ ? 0 : i, alongZ ? i : 0, &cellsB);
+            } else {
+                scanColumn(a, alongZ ? 15 : i, alongZ ? i : 15, &cellsA);
+                clusterColumn(*k, alongZ ? 0 : i, alongZ ? i : 0, &cellsB);
+            }
+            for (ColumnCell ca : cellsA) {
+                for (ColumnCell cb : cellsB) {
+                    if (canStep(ca, cb)) {
+                        steps[i].push_back(glm::ivec2(ca.y, cb.y));
+                    }
+                }
+            }
+        }
+
+        for (glm::ivec3 e : findEntrances(steps)) {
+            int ownY = lowerSide ? e.y : e.z, otherY = lowerSide ? e.z : e.y;
+            int ownEdge = lowerSide ? 15 : 0, otherEdge = 15 - ownEdge;
+            glm::ivec3 own = alongZ ? glm::ivec3(ownEdge, ownY, e.x) : glm::ivec3(e.x, ownY, ownEdge);
+            glm::ivec3 other = alongZ ? glm::ivec3(otherEdge, otherY, e.x) : glm::ivec3(e.x, otherY, otherEdge);
+            NavCluster::Portal p;
+            p.cell = k->findCell(own.x, own.y, own.z);
+            if (p.cell < 0) {
+                continue;
+            }
+            p.pos = own + glm::ivec3(c->m_coords.x, 0, c->m_coords.y);
+            p.link = other + glm::ivec3(n->m_coords.x, 0, n->m_coords.y);
+            k->portals.push_back(p);
+        }
+    }
+
+    size_t count = k->portals.size();
+    k->portalCost.assign(count * count, NO_PATH);
+    std::vector<float> dist;
+    std::vector<int> prev;
+    for (size_t from = 0; from < count; from++) {
+        searchCluster(*k, k->portals[from].cell, -1, &dist, &prev);
+        for (size_t to = 0; to < count; to++) {
+            k->portalCost[from * count + to] = dist[k->portals[to].cell];
+        }
+    }
+    return k;
+}
+
+void NavGraph::reportCluster(Chunk *c, std::shared_ptr<const NavCluster> cluster) {
+    m_builtLock.lock();
+    m_built.push_back(std::make_pair(c, std::move(cluster)));
+    m_builtLock.unlock();
+}
+
+std::shared_ptr<const NavCluster> NavGraph::getCluster(glm::ivec2 origin) const {
+    QMutexLocker locker(&m_clustersLock);
+    auto k = m_clusters.find(toKey(origin.x, origin.y));
+    return k == m_clusters.end() ? nullptr : k->second;
+}
+
+int NavGraph::clusterCount() const {
+    QMutexLocker locker(&m_clustersLock);
+    return static_cast<int>(m_clusters.size());
+}
+
+PathTicket NavGraph::requestPath(glm::vec3 from, glm::vec3 to) {
+    PathTicket ticket = m_nextTicket++;
+    QThreadPool::globalInstance()->start(new PathWorker(this, ticket, from, to), PATH_WORKER_PRIORITY);
+    return ticket;
+}
+
+bool NavGraph::takePath(PathTicket ticket, bool *found, std::vector<glm::ivec3> *path) {
+    QMutexLocker locker(&m_pathsLock);
+    auto result = m_paths.find(ticket);
+    if (result == m_paths.end()) {
+        return false;
+    }
+    *found = result->second.found;
+    std::swap(*path, result->second.cells);
+    m_paths.erase(result);
+    return true;
+}
+
+void NavGraph::reportPath(PathTicket ticket, bool found, std::vector<glm::ivec3> &&path) {
+    m_pathsLock.lock();
+    m_paths[ticket] = PathResult{found, std::move(path)};
+    m_pathsLock.unlock();
+}
+
+// The clusters one search has looked at. Each is only looked up once,
+// and holding on to them keeps them alive if they are rebuilt mid-search.
+class ClusterCache {
+    const NavGraph &graph;
+    std::unordered_map<int64_t, std::shared_ptr<const NavCluster>> held;
+public:
+    explicit ClusterCache(const NavGraph &g) : graph(g), held() {}
+    // The cluster holding the cell at this world position, or nullptr
+    const NavCluster* at(glm::ivec3 cell) {
+        glm::ivec2 origin(cell.x & ~15, cell.z & ~15);
+        int64_t key = toKey(origin.x, origin.y);
+        auto k = held.find(key);
+        if (k == held.end()) {
+            k = held.emplace(key, graph.getCluster(origin)).first;
+        }
+        return k->second.get();
+    }
+};
+
+// Finds the cell a position should start or end at
+static bool snapToCell(ClusterCache &clusters, glm::vec3 pos, const NavCluster **k, int *cell) {
+    glm::ivec3 p = glm::ivec3(glm::floor(pos));
+    *k = clusters.at(p);
+    if (*k == nullptr) {
+        return false;
+    }
+    int x = p.x - (*k)->origin.x, z = p.z - (*k)->origin.y;
+    for (int y = std::min(p.y + 1, 255); y >= std::max(p.y - SNAP_DEPTH, 0); y--) {
+        *cell = (*k)->findCell(x, y, z);
+        if (*cell >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool NavGraph::findPath(glm::vec3 from, glm::vec3 to, std::vector<glm::ivec3> *path) const {
+    path->clear();
+    ClusterCache clusters(*this);
+    const NavCluster *startK, *goalK;
+    int start, goal;
+    if (!snapToCell(clusters, from, &startK, &start) || !snapToCell(clusters, to, &goalK, &goal)) {
+        return false;
+    }
+
+    std::vector<float> dist;
+    std::vector<int> prev;
+    if (startK == goalK) {
+        searchCluster(*startK, start, goal, &dist, &prev);
+        if (dist[goal] < NO_PATH) {
+            std::vector<int> cells = traceBack(prev, goal);
+            appendCells(*startK, cells.rbegin(), cells.rend(), path);
+            return true;
+        }
+        // The way may lead out of the Chunk and back in
+    }
+
+    // How far every portal of the start and goal Chunks is from the
+    // start and goal, which joins them to the abstract graph
+    std::vector<float> startDist, goalDist;
+    std::vector<int> startPrev, goalPrev;
+    searchCluster(*startK, start, -1, &startDist, &startPrev);
+    searchCluster(*goalK, goal, -1, &goalDist, &goalPrev);
+
+    struct Node {
+        const NavCluster *k;
+        int portal;
+    };
+    struct Visit {
+        std::vector<float> g;
+        std::vector<Node> prev;
+    };
+    std::unordered_map<const NavCluster*, Visit> visits;
+    auto visit = [&](const NavCluster *k) -> Visit& {
+        auto v = visits.find(k);
+        if (v == visits.end()) {
+            Visit fresh{std::vector<float>(k->portals.size(), NO_PATH),
+                        std::vector<Node>(k->portals.size(), Node{nullptr, -1})};
+            v = visits.emplace(k, std::move(fresh)).first;
+        }
+        return v->second;
+    };
+
+    struct Open {
+        float f, g;
+        Node node;
+        bool operator>(const Open &o) const { return f > o.f; }
+    };
+    std::priority_queue<Open, std::vector<Open>, std::greater<Open>> open;
+    glm::ivec3 goalPos = goalK->cellPos(goal);
+    auto relax = [&](const NavCluster *k, int portal, float g, Node from) {
+        Visit &v = visit(k);
+        if (g < v.g[portal]) {
+            v.g[portal] = g;
+            v.prev[portal] = from;
+            glm::ivec3 p = k->portals[portal].pos;
+            float h = STEP_COST * (std::abs(p.x - goalPos.x) + std::abs(p.z - goalPos.z));
+            open.push(Open{g + h, g, Node{k, portal}});
+        }
+    };
+
+    for (size_t p = 0; p < startK->portals.size(); p++) {
+        float d = startDist[startK->portals[p].cell];
+        if (d < NO_PATH) {
+            relax(startK, static_cast<int>(p), d, Node{nullptr, -1});
+        }
+    }
+
+    float best = NO_PATH;
+    Node last{nullptr, -1};
+    int expanded = 0;
+    while (!open.empty()) {
+        Open o = open.top();
+        open.pop();
+        if (o.f >= best || expanded >= m_maxSearchNodes) {
+            break;
+        }
+        const NavCluster *k = o.node.k;
+        int p = o.node.portal;
+        if (o.g > visit(k).g[p]) {
+            continue;
+        }
+        expanded++;
+        const NavCluster::Portal &portal = k->portals[p];
+        if (k == goalK && goalDist[portal.cell] < NO_PATH && o.g + goalDist[portal.cell] < best) {
+            best = o.g + goalDist[portal.cell];
+            last = o.node;
+        }
+
+        // Over the border to this portal's twin
+        const NavCluster *n = clusters.at(portal.link);
+        if (n != nullptr) {
+            int twin = n->findPortal(portal.link, portal.pos);
+            if (twin >= 0) {
+                relax(n, twin, o.g + stepCost(portal.link.y - portal.pos.y), o.node);
+            }
+        }
+        // To the other portals of this Chunk
+        size_t count = k->portals.size();
+        for (size_t q = 0; q < count; q++) {
+            float cost = k->portalCost[p * count + q];
+            if (static_cast<int>(q) != p && cost < NO_PATH) {
+                relax(k, static_cast<int>(q), o.g + cost, o.node);
+            }
+        }
+    }
+    if (last.k == nullptr) {
+        return false;
+    }
+
+    std::vector<Node> nodes;
+    for (Node n = last; n.k != nullptr; n = visit(n.k).prev[n.portal]) {
+        nodes.push_back(n);
+    }
+    std::reverse(nodes.begin(), nodes.end());
+
+    // Refine the abstract path into cells one Chunk at a time
+    std::vector<int> cells = traceBack(startPrev, startK->portals[nodes.front().portal].cell);
+    appendCells(*startK, cells.rbegin(), cells.rend(), path);
+    for (size_t i = 1; i < nodes.size(); i++) {
+        const Node &a = nodes[i - 1], &b = nodes[i];
+        if (a.k != b.k) {
+            path->push_back(b.k->portals[b.portal].pos);
+            continue;
+        }
+        int target = b.k->portals[b.portal].cell;
+        searchCluster(*a.k, a.k->portals[a.portal].cell, target, &dist, &prev);
+        cells = traceBack(prev, target);
+        appendCells(*a.k, cells.rbegin() + 1, cells.rend(), path);
+    }
+    cells = traceBack(goalPrev, goalK->portals[last.portal].cell);
+    appendCells(*goalK, cells.begin() + 1, cells.end(), path);
+    return true;
+}
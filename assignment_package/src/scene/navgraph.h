@@ -0,0 +1,130 @@
+#pragma once
+#include "chunk.h"
+#include "glm_includes.h"
+#include <QMutex>
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Identifies a path requested from a NavGraph
+typedef uint32_t PathTicket;
+
+// The walkable surface of one Chunk, and the cost of walking between
+// each pair of places where a mob can step over into a neighboring
+// Chunk (its portals). A cell is a block a mob can stand in: it and
+// the block above are not solid and the block below is. Mobs step
+// between side-by-side cells up or down at most one block.
+//
+// A NavCluster is never changed once built. Editing a Chunk builds it
+// a new one, so searches still holding the old one are unaffected.
+struct NavCluster {
+    struct Portal {
+        int cell;
+        glm::ivec3 pos; // World position of the cell
+        glm::ivec3 link; // The cell across the border that it steps to
+    };
+
+    glm::ivec2 origin; // The Chunk's m_coords
+    // Cells are ordered by column (x + 16 * z) and then height. Those
+    // of column i are columnStart[i] up to columnStart[i + 1].
+    std::array<uint16_t, 257> columnStart;
+    std::vector<unsigned char> cellY;
+    std::vector<unsigned char> cellColumn;
+    // Non-solid blocks from the cell upward, at most 3. Stepping
+    // between cells of different heights needs 3 above the lower one.
+    std::vector<unsigned char> cellClearance;
+    std::vector<Portal> portals;
+    // Cost of the cheapest path inside this Chunk between every pair of
+    // portals, indexed [from * portals.size() + to], or NO_PATH
+    std::vector<float> portalCost;
+
+    int cellCount() const;
+    // Index of the cell at these local coords, or -1
+    int findCell(int x, int y, int z) const;
+    glm::ivec3 cellPos(int cell) const;
+    // Index of the portal at world position pos that links to the cell
+    // at world position link, or -1
+    int findPortal(glm::ivec3 pos, glm::ivec3 link) const;
+};
+
+// Hierarchical A* (HPA*) over the walkable surface of the world.
+//
+// Each generated Chunk gets a NavCluster. Where two Chunks' cells can be
+// walked between, the stretches of border they share are grouped into
+// entrances and one portal is placed in the middle of each, on both
+// sides. The portals form a small abstract graph: within a Chunk every
+// portal is joined to every other by the cached cost of walking between
+// them, and across a border each portal is joined to its twin. A long
+// path is found by searching this graph, which only touches a few
+// portals per Chunk crossed, and is then refined into blocks with small
+// searches inside one Chunk at a time.
+//
+// Clusters are rebuilt on worker threads when a Chunk is generated or
+// one of its blocks changes; an edit on a Chunk's edge rebuilds the
+// neighbor across it too, since both sides place the same portals.
+// Path requests are also answered on worker threads.
+class NavGraph {
+public:
+    static constexpr float NO_PATH = 1e30f;
+    // Cluster rebuilds allowed to run at once, so they never crowd out
+    // terrain generation
+    int m_maxBuildsInFlight;
+    // Portals the abstract search may expand before giving up
+    int m_maxSearchNodes;
+
+private:
+    std::unordered_map<int64_t, std::shared_ptr<const NavCluster>> m_clusters;
+    mutable QMutex m_clustersLock;
+
+    // Chunks whose clusters are out of date, and those being rebuilt.
+    // Main thread only.
+    std::unordered_set<Chunk*> m_dirty;
+    std::unordered_set<Chunk*> m_building;
+
+    std::vector<std::pair<Chunk*, std::shared_ptr<const NavCluster>>> m_built;
+    QMutex m_builtLock;
+
+    struct PathResult {
+        bool found;
+        std::vector<glm::ivec3> cells;
+    };
+    PathTicket m_nextTicket; // Main thread only
+    std::unordered_map<PathTicket, PathResult> m_paths;
+    QMutex m_pathsLock;
+
+    void markDirty(Chunk *c);
+
+public:
+    NavGraph();
+
+    // Main thread only
+    void onChunkGenerated(Chunk *c);
+    // x and z are local to c
+    void onBlockChanged(Chunk *c, int x, int z);
+    // Installs rebuilt clusters and starts rebuilding dirty ones
+    void update();
+
+    // Reads c and the border columns of its neighbors. Any thread.
+    static std::shared_ptr<const NavCluster> buildCluster(const Chunk *c);
+    // Called by each NavClusterWorker when it is done
+    void reportCluster(Chunk *c, std::shared_ptr<const NavCluster> cluster);
+
+    // The cluster of the Chunk with these m_coords, or nullptr. Any thread.
+    std::shared_ptr<const NavCluster> getCluster(glm::ivec2 origin) const;
+    int clusterCount() const;
+
+    // Queues a search from one position to another on a worker thread.
+    // Each position is snapped to the nearest cell in its column, a few
+    // blocks down at most, so feet or bounding box centers both work.
+    PathTicket requestPath(glm::vec3 from, glm::vec3 to);
+    // If the search for ticket is done, forgets it, sets found and
+    // fills in the cells to walk through, from and to included
+    bool takePath(PathTicket ticket, bool *found, std::vector<glm::ivec3> *path);
+
+    // Searches right away on the calling thread. Any thread.
+    bool findPath(glm::vec3 from, glm::vec3 to, std::vector<glm::ivec3> *path) const;
+    // Called by each PathWorker when it is done
+    void reportPath(PathTicket ticket, bool found, std::vector<glm::ivec3> &&path);
+};
@@ -0,0 +1,201 @@
+#include "particlesystem.h"
+#include "terrain.h"
+#include "blockregistry.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PARTICLES_USE_SSE
+#endif
+
+// How each material moves and how big it is drawn
+struct ParticleMaterialInfo {
+    float gravity; // Blocks per second squared; negative floats upward
+    float drag; // Fraction of speed lost per second
+    float bounce; // Fraction of vertical speed kept when landing, or -1 to die on landing
+    float size; // Edge length in blocks
+};
+
+static const ParticleMaterialInfo MATERIALS[NUM_PARTICLE_MATERIALS] = {
+    {20.f, 0.5f, 0.3f, 0.1f}, // DEBRIS
+    {-1.5f, 1.f, -1.f, 0.06f}, // SPARK
+    {18.f, 0.8f, -1.f, 0.07f}, // SPLASH
+};
+
+// Columns sampled per emitAmbient call
+static const int AMBIENT_SAMPLES = 4;
+
+ParticleSystem::ParticleSystem()
+    : m_pools(), m_rngState(0x2545F491u)
+{
+    static_assert(MAX_PARTICLES % 4 == 0, "Pools are integrated four particles at a time");
+    for (Pool &p : m_pools) {
+        p.count = 0;
+        for (std::vector<float> *v : {&p.x, &p.y, &p.z, &p.vx, &p.vy, &p.vz, &p.life, &p.r, &p.g, &p.b}) {
+            v->assign(MAX_PARTICLES, 0.f);
+        }
+    }
+}
+
+float ParticleSystem::random(float lo, float hi) {
+    // xorshift32
+    m_rngState ^= m_rngState << 13;
+    m_rngState ^= m_rngState >> 17;
+    m_rngState ^= m_rngState << 5;
+    return lo + (hi - lo) * ((m_rngState >> 8) / 16777216.f);
+}
+
+void ParticleSystem::spawnParticle(ParticleMaterial m, glm::vec3 pos, glm::vec3 vel, float life, glm::vec3 color) {
+    Pool &p = m_pools[m];
+    if (p.count == MAX_PARTICLES) {
+        return;
+    }
+    int i = p.count++;
+    p.x[i] = pos.x; p.y[i] = pos.y; p.z[i] = pos.z;
+    p.vx[i] = vel.x; p.vy[i] = vel.y; p.vz[i] = vel.z;
+    p.life[i] = life;
+    p.r[i] = color.r; p.g[i] = color.g; p.b[i] = color.b;
+}
+
+void ParticleSystem::move(Pool &p, int from, int to) {
+    for (std::vector<float> *v : {&p.x, &p.y, &p.z, &p.vx, &p.vy, &p.vz, &p.life, &p.r, &p.g, &p.b}) {
+        (*v)[to] = (*v)[from];
+    }
+}
+
+void ParticleSystem::emitBlockBreak(glm::ivec3 block, BlockType t) {
+    glm::vec3 center = glm::vec3(block) + glm::vec3(0.5f);
+    glm::vec3 color = blockColor(t);
+    for (int i = 0; i < 24; i++) {
+        glm::vec3 pos = glm::vec3(block) + glm::vec3(random(0.2f, 0.8f), random(0.2f, 0.8f), random(0.2f, 0.8f));
+        glm::vec3 vel = (pos - center) * 6.f + glm::vec3(0.f, random(2.f, 4.f), 0.f);
+        spawnParticle(DEBRIS, pos, vel, random(0.6f, 1.2f), color * random(0.75f, 1.1f));
+    }
+}
+
+void ParticleSystem::emitLavaSparks(glm::vec3 surface, int count) {
+    for (int i = 0; i < count; i++) {
+        glm::vec3 pos = surface + glm::vec3(random(0.f, 1.f), 0.05f, random(0.f, 1.f));
+        glm::vec3 vel(random(-0.5f, 0.5f), random(1.f, 3.f), random(-0.5f, 0.5f));
+        glm::vec3 color = glm::mix(glm::vec3(1.f, 0.35f, 0.05f), glm::vec3(1.f, 0.85f, 0.3f), random(0.f, 1.f));
+        spawnParticle(SPARK, pos, vel, random(0.8f, 1.6f), color);
+    }
+}
+
+void ParticleSystem::emitSplash(glm::vec3 surface, float strength) {
+    int count = 8 + static_cast<int>(16.f * strength);
+    for (int i = 0; i < count; i++) {
+        float angle = random(0.f, 6.2831853f);
+        float out = random(0.5f, 1.5f) * strength;
+        glm::vec3 vel(glm::cos(angle) * out, random(3.f, 5.f) * strength, glm::sin(angle) * out);
+        spawnParticle(SPLASH, surface, vel, random(0.5f, 1.f), glm::vec3(0.6f, 0.75f, 1.f) * random(0.85f, 1.f));
+    }
+}
+
+void ParticleSystem::emitAmbient(glm::vec3 center, float radius, const Terrain &terrain) {
+    for (int i = 0; i < AMBIENT_SAMPLES; i++) {
+        int x = static_cast<int>(glm::floor(center.x + random(-radius, radius)));
+        int z = static_cast<int>(glm::floor(center.z + random(-radius, radius)));
+        int top = terrain.getHeightAt(x, z);
+        if (top >= 0 && terrain.getBlockAt(x, top, z) == LAVA) {
+            emitLavaSparks(glm::vec3(x, top + 1, z), 2);
+        }
+    }
+}
+
+void ParticleSystem::tick(float dT, const Terrain &terrain) {
+    float dt = glm::min(dT * 0.01f, 0.1f);
+    for (int m = 0; m < NUM_PARTICLE_MATERIALS; m++) {
+        Pool &p = m_pools[m];
+        const ParticleMaterialInfo &info = MATERIALS[m];
+        float fall = info.gravity * dt;
+        float keep = glm::max(0.f, 1.f - info.drag * dt);
+        // Pools are padded, so the last partial group of four is
+        // integrated along with whatever lies past the end
+        int padded = (p.count + 3) & ~3;
+
+#ifdef PARTICLES_USE_SSE
+        __m128 vDt = _mm_set1_ps(dt), vFall = _mm_set1_ps(fall), vKeep = _mm_set1_ps(keep);
+        for (int i = 0; i < padded; i += 4) {
+            __m128 vx = _mm_mul_ps(_mm_loadu_ps(&p.vx[i]), vKeep);
+            __m128 vy = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&p.vy[i]), vFall), vKeep);
+            __m128 vz = _mm_mul_ps(_mm_loadu_ps(&p.vz[i]), vKeep);
+            _mm_storeu_ps(&p.vx[i], vx);
+            _mm_storeu_ps(&p.vy[i], vy);
+            _mm_storeu_ps(&p.vz[i], vz);
+            _mm_storeu_ps(&p.x[i], _mm_add_ps(_mm_loadu_ps(&p.x[i]), _mm_mul_ps(vx, vDt)));
+            _mm_storeu_ps(&p.y[i], _mm_add_ps(_mm_loadu_ps(&p.y[i]), _mm_mul_ps(vy, vDt)));
+            _mm_storeu_ps(&p.z[i], _mm_add_ps(_mm_loadu_ps(&p.z[i]), _mm_mul_ps(vz, vDt)));
+            _mm_storeu_ps(&p.life[i], _mm_sub_ps(_mm_loadu_ps(&p.life[i]), vDt));
+        }
+#else
+        for (int i = 0; i < padded; i++) {
+            p.vx[i] *= keep;
+            p.vy[i] = (p.vy[i] - fall) * keep;
+            p.vz[i] *= keep;
+            p.x[i] += p.vx[i] * dt;
+            p.y[i] += p.vy[i] * dt;
+            p.z[i] += p.vz[i] * dt;
+            p.life[i] -= dt;
+        }
+#endif
+
+        // Heightmap collision and removal. Neighboring particles usually
+        // share a column, so the last lookup is reused.
+        int lastX = INT32_MIN, lastZ = INT32_MIN, lastTop = -1;
+        for (int i = 0; i < p.count;) {
+            int cx = static_cast<int>(glm::floor(p.x[i]));
+            int cz = static_cast<int>(glm::floor(p.z[i]));
+            if (cx != lastX || cz != lastZ) {
+                lastX = cx;
+                lastZ = cz;
+                lastTop = terrain.getHeightAt(cx, cz);
+            }
+            bool dead = p.life[i] <= 0.f;
+            // Only particles that fell through the top of the column this
+            // step hit it; ones already below, e.g. in a cave, are left be
+            float prevY = p.y[i] - p.vy[i] * dt;
+            if (!dead && lastTop >= 0 && p.y[i] < lastTop + 1 && prevY >= lastTop + 1) {
+                if (info.bounce < 0.f) {
+                    dead = true;
+                } else {
+                    p.y[i] = lastTop + 1;
+                    p.vy[i] = -p.vy[i] * info.bounce;
+                    p.vx[i] *= 0.7f;
+                    p.vz[i] *= 0.7f;
+                }
+            }
+            if (dead) {
+                move(p, --p.count, i);
+            } else {
+                i++;
+            }
+        }
+    }
+}
+
+int ParticleSystem::count() const {
+    int total = 0;
+    for (const Pool &p : m_pools) {
+        total += p.count;
+    }
+    return total;
+}
+
+int ParticleSystem::count(ParticleMaterial m) const {
+    return m_pools[m].count;
+}
+
+void ParticleSystem::getInstanceData(std::vector<glm::vec3> *instances) const {
+    instances->resize(3 * count());
+    glm::vec3 *out = instances->data();
+    for (int m = 0; m < NUM_PARTICLE_MATERIALS; m++) {
+        const Pool &p = m_pools[m];
+        float size = MATERIALS[m].size;
+        glm::vec3 scale(size);
+        for (int i = 0; i < p.count; i++) {
+            *out++ = glm::vec3(p.x[i], p.y[i], p.z[i]) - 0.5f * size;
+            *out++ = scale;
+            *out++ = glm::vec3(p.r[i], p.g[i], p.b[i]);
+        }
+    }
+}
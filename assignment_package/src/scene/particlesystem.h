@@ -0,0 +1,78 @@
+#pragma once
+#include "glm_includes.h"
+#include "chunkhelpers.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+class Terrain;
+
+// Each material is simulated with its own constants and drawn with
+// one instanced draw call
+enum ParticleMaterial : unsigned char {
+    DEBRIS, // Bits of a broken block
+    SPARK, // Embers rising off lava
+    SPLASH, // Droplets thrown up by water
+    NUM_PARTICLE_MATERIALS
+};
+
+// Short-lived cosmetic particles. Every material has a pool stored as
+// structure-of-arrays, one float vector per component, padded to a
+// multiple of four so the integration step runs four particles at a
+// time with SSE (or as a plain loop the compiler can vectorize where
+// SSE is unavailable). Collision is only against the terrain heightmap,
+// which is one lookup per particle rather than a box test.
+//
+// All live particles are written into one interleaved instance buffer
+// each frame, streamed with a single upload, and each material is drawn
+// as one instanced range of it, so the number of particles never
+// changes the number of draw calls.
+class ParticleSystem {
+public:
+    // Upper bound on live particles per material; emitters stop once it is hit
+    static const int MAX_PARTICLES = 16384;
+
+    ParticleSystem();
+
+    // Debris flying out of a block of type t that was just broken
+    // at the block with this minimum corner
+    void emitBlockBreak(glm::ivec3 block, BlockType t);
+    // Sparks rising from the top of a lava block
+    void emitLavaSparks(glm::vec3 surface, int count);
+    // Droplets thrown up where something hit water
+    void emitSplash(glm::vec3 surface, float strength);
+
+    // Looks at a few random columns within radius blocks of center and
+    // lets off sparks from any lava on top, so lava near the player
+    // crackles without the whole area being scanned each frame
+    void emitAmbient(glm::vec3 center, float radius, const Terrain &terrain);
+
+    // Advances every particle by dT (in MyGL::tick units)
+    void tick(float dT, const Terrain &terrain);
+
+    int count() const;
+    int count(ParticleMaterial m) const;
+
+    // Fills instances with an (offset, scale, color) triple per particle,
+    // materials one after another in enum order, for
+    // ShaderProgram::drawInstancedInterleaved
+    void getInstanceData(std::vector<glm::vec3> *instances) const;
+
+private:
+    // One material's particles
+    struct Pool {
+        int count;
+        std::vector<float> x, y, z;
+        std::vector<float> vx, vy, vz;
+        std::vector<float> life; // Seconds left to live
+        std::vector<float> r, g, b;
+    };
+    std::array<Pool, NUM_PARTICLE_MATERIALS> m_pools;
+    uint32_t m_rngState;
+
+    // Uniform random number in [lo, hi)
+    float random(float lo, float hi);
+    void spawnParticle(ParticleMaterial m, glm::vec3 pos, glm::vec3 vel, float life, glm::vec3 color);
+    // Moves the particle at index from to index to, e.g. to fill a hole
+    static void move(Pool &p, int from, int to);
+};
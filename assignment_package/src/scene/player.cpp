@@ -1,54 +1,11 @@
 #include "player.h"
+#include "blockregistry.h"
+#include "collision.h"
+#include "raycast.h"
 #include <QString>
 
-bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit) {
-    float maxLen = glm::length(rayDirection); // Farthest we search
-    glm::ivec3 currCell = glm::ivec3(glm::floor(rayOrigin));
-    rayDirection = glm::normalize(rayDirection); // Now all t values represent world dist.
-
-    float curr_t = 0.f;
-    while(curr_t < maxLen) {
-        float min_t = glm::sqrt(3.f);
-        float interfaceAxis = -1; // Track axis for which t is smallest
-        for(int i = 0; i < 3; ++i) { // Iterate over the three axes
-            if(rayDirection[i] != 0) { // Is ray parallel to axis i?
-                float offset = glm::max(0.f, glm::sign(rayDirection[i])); // See slide 5
-                // If the player is *exactly* on an interface then
-                // they'll never move if they're looking in a negative direction
-                if(currCell[i] == rayOrigin[i] && offset == 0.f) {
-                    offset = -1.f;
-                }
-                int nextIntercept = currCell[i] + offset;
-                float axis_t = (nextIntercept - rayOrigin[i]) / rayDirection[i];
-                axis_t = glm::min(axis_t, maxLen); // Clamp to max len to avoid super out of bounds errors
-                if(axis_t < min_t) {
-                    min_t = axis_t;
-                    interfaceAxis = i;
-                }
-            }
-        }
-        if(interfaceAxis == -1) {
-            throw std::out_of_range("interfaceAxis was -1 after the for loop in gridMarch!");
-        }
-        curr_t += min_t; // min_t is declared in slide 7 algorithm
-        rayOrigin += rayDirection * min_t;
-        glm::ivec3 offset = glm::ivec3(0,0,0);
-        // Sets it to 0 if sign is +, -1 if sign is -
-        offset[interfaceAxis] = glm::min(0.f, glm::sign(rayDirection[interfaceAxis]));
-        currCell = glm::ivec3(glm::floor(rayOrigin)) + offset;
-        // If currCell contains something other than EMPTY, return
-        // curr_t
-        BlockType cellType = terrain.getBlockAt(currCell.x, currCell.y, currCell.z);
-        if(cellType != EMPTY && cellType != WATER && cellType != LAVA) {
-            *out_blockHit = currCell;
-            *out_dist = glm::min(maxLen, curr_t);
-            return true;
-        }
-
-    }
-    *out_dist = glm::min(maxLen, curr_t);
-    return false;
-}
+// Converts m_velocity * dT into a distance in blocks
+static const float VELOCITY_SCALE = 0.0003f;
 
 Player::Player(glm::vec3 pos, Terrain &terrain)
     : Entity(pos), m_velocity(0,0,0), m_acceleration(0,0,0),
@@ -68,6 +25,10 @@ void Player::toggleFlight() {
     isFlight = !isFlight;
 }
 
+glm::vec3 Player::getWorldVelocity() const {
+    return m_velocity * VELOCITY_SCALE;
+}
+
 void Player::processInputs(InputBundle &inputs) {
     // TODO: Update the Player's velocity and acceleration based on the
     // state of the inputs.
@@ -96,7 +57,12 @@ void Player::processInputs(InputBundle &inputs) {
 
         m_acceleration *= 10;
     } else {
-        BlockType underPlayer = mcr_terrain.getBlockAt(m_position.x, m_position.y - 0.5, m_position.z);
+        // Anything above the column's highest block is air, which saves
+        // the block lookup for most of a fall
+        int footX = glm::floor(m_position.x), footZ = glm::floor(m_position.z);
+        float footY = m_position.y - 0.5;
+        BlockType underPlayer = footY >= mcr_terrain.getHeightAt(footX, footZ) + 1
+                ? EMPTY : mcr_terrain.getBlockAt(footX, glm::floor(footY), footZ);
         if (inputs.wPressed) {
             glm::vec3 tempAcc = acceleration * m_forward;
             tempAcc.y = 0;
@@ -121,11 +87,11 @@ void Player::processInputs(InputBundle &inputs) {
         m_acceleration *= 10;
 
         // Apply vertical motion
-        if (underPlayer == EMPTY) {
-            m_acceleration.y = -g * m_up.y;
-        } else if (underPlayer == WATER || underPlayer == LAVA) {
+        if (isFluid(underPlayer)) {
             m_acceleration.y = -(g/5) * m_up.y;
             m_velocity.y = glm::clamp(m_velocity.y, -1.f, 0.f);
+        } else if (!isSolid(underPlayer)) {
+            m_acceleration.y = -g * m_up.y;
         } else {
             m_acceleration.y = 0;
             if (inputs.spacePressed) {
@@ -155,7 +121,7 @@ void Player::computePhysics(float dT, Terrain &terrain) {
 
     // Clamp velocity
     m_velocity = glm::clamp(m_velocity, glm::vec3(-50.f, -100.f, -50.f), glm::vec3(50.f, 400.f, 50.f));
-    glm::vec3 move = m_velocity * dT * 0.0003f;
+    glm::vec3 move = m_velocity * dT * VELOCITY_SCALE;
     if (isFlight) {
         moveAlongVector(move);
     } else {
@@ -164,68 +130,52 @@ void Player::computePhysics(float dT, Terrain &terrain) {
 }
 
 void Player::moveWithCollisions(glm::vec3 move) {
-    float out_dist = -1.f;
-    glm::ivec3 out_blockHit = glm::ivec3();
-
-    auto p1 = glm::vec3(m_position.x + 0.5, m_position.y, m_position.z - 0.5);
-    auto p2 = glm::vec3(m_position.x - 0.5, m_position.y, m_position.z - 0.5);
-    auto p3 = glm::vec3(m_position.x + 0.5, m_position.y, m_position.z + 0.5);
-    auto p4 = glm::vec3(m_position.x - 0.5, m_position.y, m_position.z + 0.5);
-    auto p5 = glm::vec3(m_position.x + 0.5, m_position.y + 1, m_position.z - 0.5);
-    auto p6 = glm::vec3(m_position.x - 0.5, m_position.y + 1, m_position.z - 0.5);
-    auto p7 = glm::vec3(m_position.x + 0.5, m_position.y + 1, m_position.z + 0.5);
-    auto p8 = glm::vec3(m_position.x - 0.5, m_position.y + 1, m_position.z + 0.5);
-    auto p9 = glm::vec3(m_position.x + 0.5, m_position.y + 2, m_position.z - 0.5);
-    auto p10 = glm::vec3(m_position.x - 0.5, m_position.y + 2, m_position.z - 0.5);
-    auto p11 = glm::vec3(m_position.x + 0.5, m_position.y + 2, m_position.z + 0.5);
-    auto p12 = glm::vec3(m_position.x - 0.5, m_position.y + 2, m_position.z + 0.5);
-    std::vector<glm::vec3> box = {p1, p2, p3, p4, p5, p6, p7, p8, p9, p10, p11, p12};
-    for (int j = 0; j < 12; j++) {
-        for (int i = 0; i < 3; i++) {
-            //(0,1,0), (1, 0, 0), (0, 0, 1)
-            glm::vec3 detectDir = glm::vec3();
-            detectDir[i] = move[i];
-            bool isBlock = gridMarch(box[j], detectDir, mcr_terrain, &out_dist, &out_blockHit);
-            if (isBlock) {
-                //super robust block detector
-                if (out_dist > 0.001f) {
-                    move[i] = glm::sign(move[i]) * (glm::min(glm::abs(move[i]), out_dist) - 0.0001f);
-                } else {
-                    move[i] = 0;
-                }
-            }
+    AABB box{m_position - glm::vec3(0.5f, 0.f, 0.5f), m_position + glm::vec3(0.5f, 2.f, 0.5f)};
+    SweepResult result = sweepAABB(mcr_terrain, box, move, stepHeight);
+    // Only the blocked part of the velocity is lost, so the player
+    // keeps sliding along whatever they ran into
+    for (int i = 0; i < 3; i++) {
+        if (result.blocked[i]) {
+            m_velocity[i] = 0.f;
         }
     }
-    moveAlongVector(move);
+    moveAlongVector(result.moved);
 }
 
 void Player::addBlock() {
-    float out_dist = -1.f;
-    glm::ivec3 out_blockHit = glm::ivec3();
-    bool isBlock = gridMarch(m_camera.mcr_position, m_forward, mcr_terrain, &out_dist, &out_blockHit);
-    if (!isBlock) {
-        out_blockHit = m_camera.mcr_position + 3.f * glm::normalize(this->m_forward);
-        Chunk* c = mcr_terrain.getChunkAt(out_blockHit.x, out_blockHit.z).get();
-        glm::vec2 chunkOrigin = glm::vec2(floor(out_blockHit.x / 16.f) * 16, floor(out_blockHit.z / 16.f) * 16);
-
-        if (c->getBlockAt(glm::vec3(static_cast<unsigned int>(out_blockHit.x - chunkOrigin.x),
-                          static_cast<unsigned int>(out_blockHit.y),
-                          static_cast<unsigned int>(out_blockHit.z - chunkOrigin.y))) == EMPTY) {
-            c->setBlockAt(static_cast<unsigned int>(out_blockHit.x - chunkOrigin.x),
-                                 static_cast<unsigned int>(out_blockHit.y),
-                                 static_cast<unsigned int>(out_blockHit.z - chunkOrigin.y), STONE);
+    RayHit hit;
+    if (!raycast(mcr_terrain, m_camera.mcr_position, m_forward, glm::length(m_forward), &hit)) {
+        glm::ivec3 out_blockHit = glm::ivec3(glm::floor(m_camera.mcr_position + 3.f * glm::normalize(this->m_forward)));
+        if (mcr_terrain.getBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z) == EMPTY) {
+            mcr_terrain.editBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z, STONE);
         }
     }
 }
 
-void Player::removeBlock() {
-    float out_dist = -1.f;
-    glm::ivec3 out_blockHit = glm::ivec3();
-    bool isBlock = gridMarch(m_camera.mcr_position, 3.f * m_forward, mcr_terrain, &out_dist, &out_blockHit);
+bool Player::removeBlock(glm::ivec3 *out_removed, BlockType *out_type) {
+    RayHit hit;
+    bool isBlock = raycast(mcr_terrain, m_camera.mcr_position, m_forward, 3.f * glm::length(m_forward), &hit);
     if (isBlock) {
-        mcr_terrain.setBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z, EMPTY);
+        if (out_type != nullptr) {
+            *out_type = hit.type;
+        }
+        mcr_terrain.editBlockAt(hit.block.x, hit.block.y, hit.block.z, EMPTY);
+        if (out_removed != nullptr) {
+            *out_removed = hit.block;
+        }
     }
-
+    return isBlock;
+}
+
+void Player::setCameraPose(const CameraPose &pose) {
+    m_position = pose.position - glm::vec3(0.f, 1.5f, 0.f);
+    mcr_posPrev = m_position;
+    m_forward = pose.forward;
+    m_right = pose.right;
+    m_up = pose.up;
+    m_velocity = glm::vec3(0.f);
+    m_acceleration = glm::vec3(0.f);
+    m_camera.setPose(pose);
 }
 
 void Player::setCameraWidthHeight(unsigned int w, unsigned int h) {
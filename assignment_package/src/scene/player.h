@@ -25,13 +25,22 @@ public:
     float jumpSpeed = 200.f;
     float friction = 0.1f;
     float g = 10.f;
+    // Height of ledge the player walks up without jumping
+    float stepHeight = 1.f;
 
     glm::vec3 mcr_posPrev;
 
 	void addBlock();
-	void removeBlock();
+	// Returns whether a block was removed, and where and of what
+	// type it was if the out parameters are given
+	bool removeBlock(glm::ivec3 *out_removed = nullptr, BlockType *out_type = nullptr);
 	void moveWithCollisions(glm::vec3 move);
 	void toggleFlight();
+	// Moves and turns the player so its camera has this pose, and stops it
+	void setCameraPose(const CameraPose &pose);
+
+	// Velocity converted to blocks moved per unit of the dT passed to tick()
+	glm::vec3 getWorldVelocity() const;
 
 	Player(glm::vec3 pos, Terrain& terrain);
 	virtual ~Player() override;
@@ -0,0 +1,190 @@
+#include "raycast.h"
+#include "terrain.h"
+#include <limits>
+
+static const float INF = std::numeric_limits<float>::infinity();
+
+namespace {
+// State of one ray walking the block grid
+struct RayWalk {
+    glm::vec3 origin, dir; // dir is normalized
+    glm::ivec3 step; // -1, 0 or 1 along each axis
+    glm::vec3 tDelta; // Distance between grid planes along each axis
+    glm::vec3 tMax; // Distance to the next grid plane along each axis
+    glm::ivec3 block;
+    glm::ivec3 normal;
+    float t;
+
+    // Points tMax at the planes leaving block
+    void resetPlanes() {
+        for (int i = 0; i < 3; i++) {
+            tMax[i] = step[i] == 0 ? INF : (block[i] + (step[i] > 0) - origin[i]) / dir[i];
+        }
+    }
+
+    // One block onward, across whichever plane comes first
+    void advance() {
+        int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+        t = tMax[axis];
+        block[axis] += step[axis];
+        tMax[axis] += tDelta[axis];
+        normal = glm::ivec3(0);
+        normal[axis] = -step[axis];
+    }
+
+    // Jumps to the first block past the box lo to hi (inclusive), which
+    // must hold the current block
+    void skip(glm::ivec3 lo, glm::ivec3 hi) {
+        int axis = -1;
+        float exit = INF;
+        for (int i = 0; i < 3; i++) {
+            if (step[i] != 0) {
+                float d = ((step[i] > 0 ? hi[i] + 1 : lo[i]) - origin[i]) / dir[i];
+                if (d < exit) {
+                    exit = d;
+                    axis = i;
+                }
+            }
+        }
+        t = glm::max(t, exit);
+        // The other axes stay inside the box; clamping keeps rounding
+        // from putting the ray back where it came from
+        glm::ivec3 at = glm::ivec3(glm::floor(origin + dir * t));
+        block = glm::clamp(at, lo, hi);
+        block[axis] = step[axis] > 0 ? hi[axis] + 1 : lo[axis] - 1;
+        normal = glm::ivec3(0);
+        normal[axis] = -step[axis];
+        resetPlanes();
+    }
+};
+}
+
+// Sets up walk for the part of the ray inside the world's height,
+// returning false if there is none. end is set to where that part ends.
+static bool beginWalk(glm::vec3 origin, glm::vec3 direction, float maxDist, RayWalk *walk, float *end) {
+    float len = glm::length(direction);
+    if (len == 0.f) {
+        return false;
+    }
+    glm::vec3 dir = direction / len;
+    float start = 0.f;
+    *end = maxDist;
+    if (dir.y != 0.f) {
+        float a = -origin.y / dir.y, b = (256.f - origin.y) / dir.y;
+        start = glm::max(start, glm::min(a, b));
+        *end = glm::min(*end, glm::max(a, b));
+    } else if (origin.y < 0.f || origin.y >= 256.f) {
+        return false;
+    }
+    if (start > *end) {
+        return false;
+    }
+
+    walk->origin = origin;
+    walk->dir = dir;
+    walk->t = start;
+    for (int i = 0; i < 3; i++) {
+        walk->step[i] = dir[i] > 0.f ? 1 : (dir[i] < 0.f ? -1 : 0);
+        walk->tDelta[i] = walk->step[i] == 0 ? INF : glm::abs(1.f / dir[i]);
+    }
+    walk->block = glm::ivec3(glm::floor(origin + dir * start));
+    walk->block.y = glm::clamp(walk->block.y, 0, 255);
+    walk->normal = glm::ivec3(0);
+    if (start > 0.f) {
+        walk->normal.y = -walk->step.y; // Came in through the top or bottom
+    }
+    walk->resetPlanes();
+    return true;
+}
+
+// Walks the ray from the Chunk containing its first block
+static bool walkChunks(const Chunk *c, RayWalk &walk, float end, BlockFilter stopAt, RayHit *out) {
+    out->hit = false;
+    while (c != nullptr && walk.t <= end) {
+        glm::ivec3 &b = walk.block;
+        int lx = b.x - c->m_coords.x, lz = b.z - c->m_coords.y;
+        if (lx < 0 || lx >= 16 || lz < 0 || lz >= 16) {
+            // Only one axis can have left the Chunk since the last step
+            c = c->getNeighbor(lx < 0 ? XNEG : (lx >= 16 ? XPOS : (lz < 0 ? ZNEG : ZPOS)));
+            continue;
+        }
+        if (b.y < 0 || b.y > 255) {
+            break;
+        }
+
+        glm::ivec3 corner(c->m_coords.x, 0, c->m_coords.y);
+        int top = c->getMaxHeight();
+        if (b.y > top) {
+            walk.skip(corner + glm::ivec3(0, top + 1, 0), corner + glm::ivec3(15, 255, 15));
+            continue;
+        }
+        int section = b.y / 16;
+        if (c->getSectionBlockCount(section) == 0) {
+            walk.skip(corner + glm::ivec3(0, 16 * section, 0), corner + glm::ivec3(15, 16 * section + 15, 15));
+            continue;
+        }
+        int colMin = c->getColumnMinHeight(lx, lz), colMax = c->getColumnMaxHeight(lx, lz);
+        if (colMax < 0) {
+            walk.skip(glm::ivec3(b.x, 0, b.z), glm::ivec3(b.x, 255, b.z));
+            continue;
+        } else if (b.y > colMax) {
+            walk.skip(glm::ivec3(b.x, colMax + 1, b.z), glm::ivec3(b.x, 255, b.z));
+            continue;
+        } else if (b.y < colMin) {
+            walk.skip(glm::ivec3(b.x, 0, b.z), glm::ivec3(b.x, colMin - 1, b.z));
+            continue;
+        }
+
+        BlockType t = c->getBlockAt(lx, b.y, lz);
+        if (stopAt(t)) {
+            *out = RayHit{true, b, walk.normal, walk.t, t};
+            return true;
+        }
+        walk.advance();
+    }
+    return false;
+}
+
+// The Chunk holding world x, z, or nullptr
+static const Chunk *chunkAt(const Terrain &terrain, int x, int z) {
+    return terrain.hasChunkAt(x, z) ? terrain.getChunkAt(x, z).get() : nullptr;
+}
+
+bool raycast(const Terrain &terrain, glm::vec3 origin, glm::vec3 direction, float maxDist,
+             RayHit *out, BlockFilter stopAt) {
+    RayWalk walk;
+    float end;
+    out->hit = false;
+    if (!beginWalk(origin, direction, maxDist, &walk, &end)) {
+        return false;
+    }
+    return walkChunks(chunkAt(terrain, walk.block.x, walk.block.z), walk, end, stopAt, out);
+}
+
+void raycastBatch(const Terrain &terrain, const std::vector<Ray> &rays,
+                  std::vector<RayHit> *hits, BlockFilter stopAt) {
+    hits->resize(rays.size());
+    const Chunk *last = nullptr;
+    glm::ivec2 lastCoords(INT32_MIN);
+    for (size_t i = 0; i < rays.size(); i++) {
+        const Ray &r = rays[i];
+        RayWalk walk;
+        float end;
+        (*hits)[i].hit = false;
+        if (!beginWalk(r.origin, r.direction, r.maxDist, &walk, &end)) {
+            continue;
+        }
+        glm::ivec2 coords(16 * static_cast<int>(glm::floor(walk.block.x / 16.f)),
+                          16 * static_cast<int>(glm::floor(walk.block.z / 16.f)));
+        if (coords != lastCoords) {
+            last = chunkAt(terrain, coords.x, coords.y);
+            lastCoords = coords;
+        }
+        walkChunks(last, walk, end, stopAt, &(*hits)[i]);
+    }
+}
+
+bool hasLineOfSight(const Terrain &terrain, glm::vec3 from, glm::vec3 to) {
+    RayHit hit;
+    return !raycast(terrain, from, to - from, glm::length(to - from), &hit, isOpaque);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "glm_includes.h"
+#include "blockregistry.h"
+#include <vector>
+
+class Terrain;
+
+// Which blocks stop a ray
+typedef bool (*BlockFilter)(BlockType);
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction; // Need not be normalized
+    float maxDist;
+};
+
+struct RayHit {
+    bool hit;
+    glm::ivec3 block;
+    // Outward normal of the face the ray entered the block through,
+    // or zero if the ray started inside it
+    glm::ivec3 normal;
+    float dist; // Along the ray, in blocks
+    BlockType type;
+};
+
+// Casts a ray through the terrain up to maxDist blocks and reports the
+// first block that stopAt accepts.
+//
+// The ray walks the block grid with an integer DDA, but only where
+// there can be something to hit. Space above a Chunk's highest block,
+// 16-block sections of a Chunk that hold no blocks at all, and the
+// stretches of a column above or below its blocks are each crossed in
+// a single step using the Chunks' height bounds and section counts, so
+// rays over open terrain or into the sky take a few steps per Chunk.
+// Neighboring Chunks are reached through their links rather than looked
+// up, so the terrain's map is only searched once per ray.
+//
+// Rays end at missing Chunks and at the top and bottom of the world.
+// Only reads the terrain, so any thread may call it.
+bool raycast(const Terrain &terrain, glm::vec3 origin, glm::vec3 direction, float maxDist,
+             RayHit *out, BlockFilter stopAt = isSolid);
+
+// Casts every ray in rays, filling in hits in the same order. Rays that
+// start in the same Chunk as the one before share its lookup, so
+// batches of rays from one place, such as a camera, are cheapest.
+void raycastBatch(const Terrain &terrain, const std::vector<Ray> &rays,
+                  std::vector<RayHit> *hits, BlockFilter stopAt = isSolid);
+
+// Whether no opaque block lies between from and to
+bool hasLineOfSight(const Terrain &terrain, glm::vec3 from, glm::vec3 to);
@@ -0,0 +1,34 @@
+#include "spatialhash.h"
+
+SpatialHash::SpatialHash(float cellSize)
+    : m_cellSize(cellSize), m_bucketMask(0), m_bucketStart(2, 0), m_entries()
+{}
+
+void SpatialHash::build(const std::vector<glm::vec3> &centers) {
+    // About two buckets per entity keeps collisions rare
+    uint32_t buckets = 1;
+    while (buckets < 2 * centers.size()) {
+        buckets <<= 1;
+    }
+    m_bucketMask = buckets - 1;
+
+    std::vector<uint32_t> bucket(centers.size());
+    m_bucketStart.assign(buckets + 1, 0);
+    for (size_t i = 0; i < centers.size(); i++) {
+        bucket[i] = bucketOf(cellOf(centers[i]));
+        m_bucketStart[bucket[i] + 1]++;
+    }
+    for (uint32_t b = 0; b < buckets; b++) {
+        m_bucketStart[b + 1] += m_bucketStart[b];
+    }
+
+    std::vector<uint32_t> next(m_bucketStart.begin(), m_bucketStart.end() - 1);
+    m_entries.resize(centers.size());
+    for (size_t i = 0; i < centers.size(); i++) {
+        m_entries[next[bucket[i]]++] = static_cast<uint32_t>(i);
+    }
+}
+
+float SpatialHash::getCellSize() const {
+    return m_cellSize;
+}
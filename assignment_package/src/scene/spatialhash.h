@@ -0,0 +1,59 @@
+#pragma once
+#include "glm_includes.h"
+#include <cstdint>
+#include <vector>
+
+// Uniform grid broadphase for entity-entity tests. Every entity is filed
+// under the grid cell holding its center, and cells are hashed into a
+// table sized to the number of entities, so memory does not depend on
+// how spread out they are. The table is rebuilt from scratch each tick
+// with a counting sort, which leaves each bucket's entities contiguous.
+//
+// Entities no larger than a cell can only overlap entities filed within
+// one cell of them, so queries look at the 27 surrounding cells. Hash
+// collisions can return unrelated entities, so callers still need an
+// exact overlap test.
+class SpatialHash {
+public:
+    explicit SpatialHash(float cellSize);
+
+    void build(const std::vector<glm::vec3> &centers);
+
+    // Calls f(i) for every entity i filed in the cells around p
+    // (possibly more than once if cells share a bucket).
+    // Safe to call from several threads between builds.
+    template <typename F>
+    void forEachNear(glm::vec3 p, F f) const {
+        if (m_entries.empty()) {
+            return;
+        }
+        glm::ivec3 center = cellOf(p);
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dz = -1; dz <= 1; dz++) {
+                    uint32_t b = bucketOf(center + glm::ivec3(dx, dy, dz));
+                    for (uint32_t e = m_bucketStart[b]; e < m_bucketStart[b + 1]; e++) {
+                        f(m_entries[e]);
+                    }
+                }
+            }
+        }
+    }
+
+    float getCellSize() const;
+
+private:
+    float m_cellSize;
+    uint32_t m_bucketMask; // Bucket count minus one; the count is a power of two
+    // Entities in bucket b are m_entries[m_bucketStart[b]] to m_entries[m_bucketStart[b + 1] - 1]
+    std::vector<uint32_t> m_bucketStart;
+    std::vector<uint32_t> m_entries;
+
+    glm::ivec3 cellOf(glm::vec3 p) const {
+        return glm::ivec3(glm::floor(p / m_cellSize));
+    }
+    uint32_t bucketOf(glm::ivec3 cell) const {
+        uint32_t h = uint32_t(cell.x) * 73856093u ^ uint32_t(cell.y) * 19349663u ^ uint32_t(cell.z) * 83492791u;
+        return h & m_bucketMask;
+    }
+};
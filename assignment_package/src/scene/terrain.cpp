@@ -1,18 +1,28 @@
 #include "terrain.h"
+#include "lightengine.h"
 #include "cube.h"
+#include "parallelfor.h"
 #include <stdexcept>
 #include <iostream>
 #include <math.h>
 #include <algorithm>
+#include <QElapsedTimer>
+
+// Block ticks until the blocks around an edit react to it
+static const int EDIT_TICK_DELAY = 10;
 
 Terrain::Terrain(OpenGLContext *context)
     : m_chunks(), m_generatedTerrain(), mp_context(context),
-      m_tryExpansionTimer(0.f)
+      m_tryExpansionTimer(0.f), m_zoneRadius(2),
+      m_pendingBlockDataChunks(0), m_pendingVBOChunks(0)
 {}
 
 Terrain::~Terrain() {
-    for (std::pair<const long long int, uPtr<Chunk>>& c : m_chunks) {
-        c.second->destroyVBOdata();
+    for (auto& c : m_chunks) {
+        // Terrain made without a GL context never has any VBOs
+        if (c.second->hasVBOdata) {
+            c.second->destroyVBOdata();
+        }
     }
 }
 
@@ -34,6 +44,12 @@ int64_t toKey(int x, int z) {
     return xz;
 }
 
+// Key of the terrain generation zone containing the Chunk at these coords
+static int64_t zoneKeyOf(glm::ivec2 chunkCoords) {
+    glm::ivec2 zone = 64 * glm::ivec2(glm::floor(glm::vec2(chunkCoords) / 64.f));
+    return toKey(zone.x, zone.y);
+}
+
 glm::ivec2 toCoords(int64_t k) {
     // Z is lower 32 bits
     int64_t z = k & 0x00000000ffffffff;
@@ -75,6 +91,22 @@ BlockType Terrain::getBlockAt(glm::vec3 p) const {
     return getBlockAt(p.x, p.y, p.z);
 }
 
+int Terrain::getHeightAt(int x, int z) const {
+    if(!hasChunkAt(x, z)) {
+        return -1;
+    }
+    const uPtr<Chunk> &c = getChunkAt(x, z);
+    return c->getColumnMaxHeight(x - c->m_coords.x, z - c->m_coords.y);
+}
+
+int Terrain::getMinHeightAt(int x, int z) const {
+    if(!hasChunkAt(x, z)) {
+        return -1;
+    }
+    const uPtr<Chunk> &c = getChunkAt(x, z);
+    return c->getColumnMinHeight(x - c->m_coords.x, z - c->m_coords.y);
+}
+
 bool Terrain::hasChunkAt(int x, int z) const {
     // Map x and z to their nearest Chunk corner
     // By flooring x and z, then multiplying by 16,
@@ -119,6 +151,63 @@ void Terrain::setBlockAt(int x, int y, int z, BlockType t)
     }
 }
 
+void Terrain::editBlockAt(int x, int y, int z, BlockType t)
+{
+    if(!hasChunkAt(x, z) || y < 0 || y >= 256) {
+        throw std::out_of_range("Coordinates " + std::to_string(x) +
+                                " " + std::to_string(y) + " " +
+                                std::to_string(z) + " have no Chunk!");
+    }
+    Chunk *c = getChunkAt(x, z).get();
+    int localX = x - c->m_coords.x, localZ = z - c->m_coords.y;
+    if(c->getBlockAt(localX, y, localZ) == t) {
+        return;
+    }
+    c->setBlockAt(localX, y, localZ, t);
+
+    std::unordered_set<Chunk*> needsMesh;
+    needsMesh.insert(c);
+    LightEngine::onBlockChanged(c, localX, y, localZ, &needsMesh);
+    // Faces of the neighboring Chunk that touch this block may appear or vanish
+    if(localX == 0) needsMesh.insert(c->getNeighbor(XNEG));
+    if(localX == 15) needsMesh.insert(c->getNeighbor(XPOS));
+    if(localZ == 0) needsMesh.insert(c->getNeighbor(ZNEG));
+    if(localZ == 15) needsMesh.insert(c->getNeighbor(ZPOS));
+    remeshChunks(needsMesh);
+
+    // Fluid next to this block may now be able to flow, or lost its source
+    m_fluids.onBlockEdited(c, localX, y, localZ);
+    m_blockTicks.scheduleAround(c, localX, y, localZ, EDIT_TICK_DELAY);
+    m_navGraph.onBlockChanged(c, localX, localZ);
+}
+
+void Terrain::applyBlockTicks()
+{
+    QElapsedTimer timer;
+    timer.start();
+    qint64 budgetNs = static_cast<qint64>(m_blockTicks.m_applyBudgetMs * 1e6f);
+    BlockChange change;
+    while(timer.nsecsElapsed() < budgetNs && m_blockTicks.takeChange(&change)) {
+        Chunk *c = change.chunk;
+        // The world may have changed since the worker looked at it
+        if(c->m_generationState != GENERATED
+                || c->getBlockAt(change.x, change.y, change.z) != change.expectedType) {
+            continue;
+        }
+        editBlockAt(c->m_coords.x + change.x, change.y, c->m_coords.y + change.z, change.newType);
+    }
+}
+
+void Terrain::remeshChunks(const std::unordered_set<Chunk*> &changed)
+{
+    for(Chunk *chunk : changed) {
+        if(chunk != nullptr && m_activeZones.contains(zoneKeyOf(chunk->m_coords))) {
+            m_chunksAwaitingMesh.insert(chunk);
+        }
+    }
+    spawnReadyVBOWorkers();
+}
+
 Chunk* Terrain::instantiateChunkAt(int x, int z) {
     // Turn coordinates into multiples of 16
     x = 16 * glm::floor(x / 16.f);
@@ -146,14 +235,6 @@ Chunk* Terrain::instantiateChunkAt(int x, int z) {
         cPtr->linkNeighbor(chunkWest, XNEG);
     }
 
-    // Populate blocks
-    for(int i = 0; i < 16; i++){
-        for(int j = 0; j < 16; j++){
-            setBlock(x + i, z+ j);
-        }
-    }
-
-    return cPtr;
     return cPtr;
 }
 
@@ -166,223 +247,25 @@ void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shader
     // Draw all opaque elements
     for(int x = minX; x < maxX; x += 16) {
         for(int z = minZ; z < maxZ; z += 16) {
-            if (hasChunkAt(x, z)) {
-                const uPtr<Chunk> &chunk = getChunkAt(x, z);
-                // std::cout << "draw " << glm::to_string(chunk->m_coords) << " addr " << chunk.get() << std::endl;
-                if(!chunk->hasVBOdata) {
-                    continue;
-                }
+            auto drawable = m_drawableChunks.find(toKey(x, z));
+            if (drawable != m_drawableChunks.end()) {
+                Chunk *chunk = drawable->second;
+                // std::cout << "draw " << glm::to_string(chunk->m_coords) << " addr " << chunk << std::endl;
                 // Set model matrix to appropriate offset
                 glm::mat4 modelMatrix = glm::mat4(1.f);
                 modelMatrix[3][0] = x;
                 modelMatrix[3][2] = z;
                 shaderProgram->setModelMatrix(modelMatrix);
-                shaderProgram->drawInterleaved(*chunk.get(), PRIMARY);
-                shaderProgram->drawInterleaved(*chunk.get(), SECONDARY);
+                shaderProgram->drawInterleaved(*chunk, PRIMARY);
+                shaderProgram->drawInterleaved(*chunk, SECONDARY);
             }
         }
     }
 }
 
-glm::vec2 random2( glm::vec2 p ) {
-    return glm::fract(glm::sin(glm::vec2(glm::dot(p, glm::vec2(127.1, 311.7)),
-                 glm::dot(p, glm::vec2(269.5,183.3))))
-                 * (float)43758.5453);
-}
-
-float surflet(glm::vec2 P, glm::vec2 gridPoint) {
-    // Compute falloff function by converting linear distance to a polynomial
-    float distX = abs(P.x - gridPoint.x);
-    float distY = abs(P.y - gridPoint.y);
-    float tX = 1 - 6 * pow(distX, 5.f) + 15 * pow(distX, 4.f) - 10 * pow(distX, 3.f);
-    float tY = 1 - 6 * pow(distY, 5.f) + 15 * pow(distY, 4.f) - 10 * pow(distY, 3.f);
-    // Get the random vector for the grid point
-    glm::vec2 gradient = 2.f * random2(gridPoint) - glm::vec2(1.f);
-    // Get the vector from the grid point to P
-    glm::vec2 diff = P - gridPoint;
-    // Get the value of our height field by dotting grid->P with our gradient
-    float height = glm::dot(diff, gradient);
-    // Scale our height field (i.e. reduce it) by our polynomial falloff function
-    return height * tX * tY;
-}
-
-float perlinNoise(glm::vec2 uv) {
-    float surfletSum = 0.f;
-    // Iterate over the four integer corners surrounding uv
-    for(int dx = 0; dx <= 1; ++dx) {
-        for(int dy = 0; dy <= 1; ++dy) {
-            surfletSum += surflet(uv, glm::floor(uv) + glm::vec2(dx, dy));
-        }
-    }
-    return surfletSum;
-}
-
-glm::vec3 random3( glm::vec3 p ) {
-    return glm::fract(glm::sin(glm::vec3(glm::dot(p, glm::vec3(127.1, 311.7,114.9)),
-                 glm::dot(p, glm::vec3(269.5,183.3,341.7)),glm::dot(p, glm::vec3(315.2,123.8,235.5))))
-                 * (float)43758.5453);
-}
-
-float surflet3D(glm::vec3 P, glm::vec3 gridPoint) {
-    // Compute falloff function by converting linear distance to a polynomial
-    float distX = abs(P.x - gridPoint.x);
-    float distY = abs(P.y - gridPoint.y);
-    float distZ = abs(P.z - gridPoint.z);
-    float tX = 1 - 6 * pow(distX, 5.f) + 15 * pow(distX, 4.f) - 10 * pow(distX, 3.f);
-    float tY = 1 - 6 * pow(distY, 5.f) + 15 * pow(distY, 4.f) - 10 * pow(distY, 3.f);
-    float tZ = 1 - 6 * pow(distZ, 5.f) + 15 * pow(distZ, 4.f) - 10 * pow(distZ, 3.f);
-    // Get the random vector for the grid point
-    glm::vec3 gradient = 2.f * random3(gridPoint) - glm::vec3(1.f);
-    //cout << glm::to_string(random3(gridPoint));
-    // Get the vector from the grid point to P
-    glm::vec3 diff = P - gridPoint;
-    // Get the value of our height field by dotting grid->P with our gradient
-    float height = glm::dot(diff, gradient);
-    // Scale our height field (i.e. reduce it) by our polynomial falloff function
-    return height * tX * tY * tZ;
-}
-
-float perlinNoise3D(glm::vec3 uv) {
-    float surfletSum = 0.f;
-    // Iterate over the four integer corners surrounding uv
-    for(int dx = 0; dx <= 1; ++dx) {
-        for(int dy = 0; dy <= 1; ++dy) {
-            for(int dz = 0; dz <= 1; ++dz) {
-                surfletSum += surflet3D(uv, glm::floor(uv) + glm::vec3(dx, dy, dz));
-            }
-
-        }
-    }
-    return surfletSum;
-}
-
-
-float noise1D(int x) {
-    double intPart, fractPart;
-    fractPart = std::modf(sin(x*127.1) *
-            43758.5453, &intPart);
-    return fractPart;
-}
-
-
-
-float interpNoise1D(float x) {
-    int intX = int(floor(x));
-    float fractX = x - intX;
-
-    float v1 = noise1D(intX);
-    float v2 = noise1D(intX+1);
-    return v1 + fractX*(v2-v1);
-}
-
-float fbm(float x) {
-    float total = 0;
-    float persistence = 0.5f;
-    int octaves = 8;
-    float freq = 2.f;
-    float amp = 0.5f;
-    for(int i = 1; i <= octaves; i++) {
-        total += interpNoise1D(x * freq) * amp;
-
-        freq *= 2.f;
-        amp *= persistence;
-    }
-    return total;
-}
-
-float WorleyDist(glm::vec2 uv) {
-    float grid = 2.0;
-    uv *= grid; // Now the space is 10x10 instead of 1x1. Change this to any number you want.
-    glm::vec2 uvInt = glm::floor(uv);
-    glm::vec2 uvFract = glm::fract(uv);
-
-    float minDist = 1000; // Minimuxm distance initialized to max.
-    glm::vec2 minPoint = glm::vec2(200,200);
-    for(int y = -1; y <= 1; ++y) {
-        for(int x = -1; x <= 1; ++x) {
-            glm::vec2 neighbor = glm::vec2(float(x), float(y)); // Direction in which neighbor cell lies
-            glm::vec2 point = random2(uvInt + neighbor); // Get the Voronoi centerpoint for the neighboring cell
-            glm::vec2 diff = neighbor + point - uvFract; // Distance between fragment coord and neighbor’s Voronoi point
-            float dist = glm::length(diff);
-            if(dist < minDist){
-                minPoint = glm::vec2((uv+diff)/grid);
-            }
-            minDist = std::min(minDist, dist);
-        }
-    }
-    return minDist;
-}
-
 void Terrain::setBlock(int x, int z){
-    float b = perlinNoise(glm::vec2(x/300.0, z/300.0))+0.5;
-
-    float p = (perlinNoise(glm::vec2(x/64.0 ,z/64.0) ) + 0.5);
-    float r = fbm(p);
-    float m = -508*r + 203.2 ;
-
-    m = std::max(std::min(
-                     m,127.f),0.f); // mountain height
-
-    m+=128;
-
-    float w = WorleyDist(glm::vec2(x/64.0 ,z/64.0));
-    float g = -25*w + 25;
-
-    g = std::max(std::min(
-                     g,40.f),0.f); // hill height
-
-    g+=128;
-
-    int f;
-
-    if(b > 0.6){
-        f = int(m);
-    }else if (b < 0.4){
-        f = int(g);
-    }else{
-        f = int(glm::mix(g, m, b));
-    }
-
-    f = std::max(std::min(
-                     f,254),0); // interpolated value
-
-
-    //caves
-    for(int i = 108; i <= 128; i++){
-        float p = perlinNoise3D(glm::vec3(x/10.0,i/10.0,z/10.0));
-
-        if(p > 0){
-            setBlockAt(x, i, z, STONE);
-        }else if (i < 113){ // should be 25 (just for testing)
-            setBlockAt(x, i, z, LAVA);
-        }else{
-            setBlockAt(x, i, z, EMPTY);
-        }
-    }
-    setBlockAt(x, 107, z, BEDROCK); // bottom layer is bedrock
-
-    if(b > 0.5){
-        for(int i = 129; i <= f; i++){
-            if(i == f && f >= 200){
-                setBlockAt(x, i, z, SNOW); // top of mountain
-            }else{
-                setBlockAt(x, i, z, STONE); // set mountains stone
-            }
-        }
-
-    }
-    else{
-        for(int i = 129; i <= f; i++){
-            if(i == f){
-                setBlockAt(x, i, z, GRASS); // top of hills
-            }else{
-                setBlockAt(x, i, z, DIRT); // set hills dirt
-            }
-        }
-    }
-    for(int i = f; i < 138; i++){
-        setBlockAt(x, i, z, WATER); // water 128 - 138
-    }
+    uPtr<Chunk> &c = getChunkAt(x, z);
+    c->generateColumn(x - c->m_coords.x, z - c->m_coords.y);
 }
 
 
@@ -405,65 +288,188 @@ void Terrain::CreateTestScene()
     m_generatedTerrain.insert(toKey(0, 0));
 
     // Create the basic terrain floor
-    for(int x = 0; x < 64; ++x) {
-        for(int z = 0; z < 64; ++z) {
-            setBlock(x,z);
+    for(int x = 0; x < 64; x += 16) {
+        for(int z = 0; z < 64; z += 16) {
+            const uPtr<Chunk> &chunk = getChunkAt(x, z);
+            chunk->generateChunk();
+            LightEngine::lightChunk(chunk.get());
+            chunk->m_generationState = GENERATED;
+            m_navGraph.onChunkGenerated(chunk.get());
         }
     }
 
 }
 
-void Terrain::spawnVBOWorkers(const vector<Chunk*> &chunksNeedingVBOs) {
-    for (Chunk* c : chunksNeedingVBOs) {
-        spawnVBOWorker(c);
+bool Terrain::isReadyToMesh(const Chunk *c) const {
+    if(c->m_generationState != GENERATED) {
+        return false;
+    }
+    // Neighbors that nobody is generating are meshed against as they
+    // are; if they are generated later this Chunk is remeshed then
+    for(Direction dir : {XPOS, XNEG, ZPOS, ZNEG}) {
+        Chunk *n = c->getNeighbor(dir);
+        if(n != nullptr && n->m_generationState == GENERATING) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Terrain::spawnReadyVBOWorkers() {
+    for(auto it = m_chunksAwaitingMesh.begin(); it != m_chunksAwaitingMesh.end();) {
+        if(!m_chunksBeingMeshed.count(*it) && isReadyToMesh(*it)) {
+            LightEngine::pullBorderLight(*it);
+            spawnVBOWorker(*it);
+            it = m_chunksAwaitingMesh.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void Terrain::finishChunkGeneration(Chunk *c) {
+    c->m_generationState = GENERATED;
+    int64_t zone = zoneKeyOf(c->m_coords);
+    auto remaining = m_zoneChunksRemaining.find(zone);
+    if(remaining != m_zoneChunksRemaining.end() && --remaining->second == 0) {
+        m_zoneChunksRemaining.erase(remaining);
+    }
+    if(m_activeZones.contains(zone)) {
+        m_chunksAwaitingMesh.insert(c);
+    }
+    m_navGraph.onChunkGenerated(c);
+    // Neighbors already meshed against this Chunk's missing blocks
+    // need their border faces rebuilt
+    for(Direction dir : {XPOS, XNEG, ZPOS, ZNEG}) {
+        Chunk *n = c->getNeighbor(dir);
+        if(n != nullptr && n->m_generationState == GENERATED && m_activeZones.contains(zoneKeyOf(n->m_coords))) {
+            m_chunksAwaitingMesh.insert(n);
+        }
     }
 }
 
 void Terrain::checkThreadResults() {
     m_chunksThatHaveBlockDataLock.lock();
-    spawnVBOWorkers(m_chunksThatHaveBlockData);
+    for (Chunk* c : m_chunksThatHaveBlockData) {
+        finishChunkGeneration(c);
+    }
+    m_pendingBlockDataChunks -= m_chunksThatHaveBlockData.size();
     m_chunksThatHaveBlockData.clear();
     m_chunksThatHaveBlockDataLock.unlock();
+    spawnReadyVBOWorkers();
+
+    m_chunksUploadedLock.lock();
+    for(Chunk *c : m_chunksUploaded) {
+        m_chunksBeingMeshed.erase(c);
+        if(m_chunksReleasedWhileMeshing.erase(c)) {
+            releaseChunk(c);
+        }
+    }
+    m_pendingVBOChunks -= m_chunksUploaded.size();
+    m_chunksUploaded.clear();
+    m_chunksUploadedLock.unlock();
+}
 
+void Terrain::uploadVBOResults() {
+    std::vector<Chunk*> released;
+    m_chunksToReleaseLock.lock();
+    std::swap(released, m_chunksToRelease);
+    m_chunksToReleaseLock.unlock();
+    for(Chunk *c : released) {
+        c->destroyVBOdata();
+        m_drawableChunks.erase(toKey(c->m_coords.x, c->m_coords.y));
+    }
+
+    std::vector<ChunkVBOData> finished;
     m_chunksThatHaveVBOsLock.lock();
-    for(auto& cd: m_chunksThatHaveVBOs) {
+    std::swap(finished, m_chunksThatHaveVBOs);
+    m_chunksThatHaveVBOsLock.unlock();
+    if(finished.empty()) {
+        return;
+    }
+    std::vector<Chunk*> uploaded;
+    for(auto& cd: finished) {
 //        std::cout << "buffering chunk VBOs to GPU" << std::endl;
         cd.mp_chunk->bufferVBOdata(cd.m_vboDataOpaque, cd.m_idxDataOpaque,
                                    cd.m_vboDataTransparent, cd.m_idxDataTransparent);
         cd.mp_chunk->hasVBOdata = true;
-        // std::cout << "chunk at " << glm::to_string(cd.mp_chunk->m_coords) << " address " << cd.mp_chunk << std::endl;
+        m_drawableChunks[toKey(cd.mp_chunk->m_coords.x, cd.mp_chunk->m_coords.y)] = cd.mp_chunk;
+        uploaded.push_back(cd.mp_chunk);
     }
-    m_chunksThatHaveVBOs.clear();
-    m_chunksThatHaveVBOsLock.unlock();
+    m_chunksUploadedLock.lock();
+    m_chunksUploaded.insert(m_chunksUploaded.end(), uploaded.begin(), uploaded.end());
+    m_chunksUploadedLock.unlock();
+}
+
+void Terrain::releaseChunk(Chunk *c) {
+    m_chunksToReleaseLock.lock();
+    m_chunksToRelease.push_back(c);
+    m_chunksToReleaseLock.unlock();
 }
 
-void Terrain::multithreadedWork(glm::vec3 playerPos, glm::vec3 playerPosPrev, float dT) {
+void Terrain::multithreadedWork(glm::vec3 playerPos, glm::vec3 playerVel, glm::vec3 playerLook, float dT) {
+    // Results are collected every tick so block edits show up right away
+    checkThreadResults();
+    // Every Chunk touched by a fluid tick is remeshed once, however
+    // many of its blocks changed
+    std::unordered_set<Chunk*> fluidChanged;
+    m_fluids.update(dT, &fluidChanged);
+    if(!fluidChanged.empty()) {
+        remeshChunks(fluidChanged);
+    }
+
+    std::vector<Chunk*> tickedChunks;
+    for(int64_t zone : m_activeZones) {
+        glm::ivec2 coords = toCoords(zone);
+        for(int x = coords.x; x < coords.x + 64; x += 16) {
+            for(int z = coords.y; z < coords.y + 64; z += 16) {
+                auto chunk = m_chunks.find(toKey(x, z));
+                if(chunk != m_chunks.end() && chunk->second->m_generationState == GENERATED) {
+                    tickedChunks.push_back(chunk->second.get());
+                }
+            }
+        }
+    }
+    m_blockTicks.update(dT, tickedChunks);
+    applyBlockTicks();
+    m_navGraph.update();
     m_tryExpansionTimer += dT;
     if (m_tryExpansionTimer < 5.f) {
         return;
     }
 //    cout << "multithreadedWork" << endl;
-    tryExpansion(playerPos, playerPosPrev);
-    checkThreadResults();
+    tryExpansion(playerPos, playerVel, playerLook);
     m_tryExpansionTimer = 0.f;
 }
 
-void Terrain::tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev) {
+void Terrain::tryExpansion(glm::vec3 playerPos, glm::vec3 playerVel, glm::vec3 playerLook) {
+    m_prefetcher.update(playerPos, playerVel, playerLook, m_zoneRadius);
+    reprioritizeZoneWorkers();
+
     glm::ivec2 currZone = glm::ivec2(glm::floor(playerPos.x / 64.f) * 64.f, glm::floor(playerPos.z / 64.f) * 64.f);
-    glm::ivec2 prevZone = glm::ivec2(glm::floor(playerPosPrev.x / 64.f) * 64.f, glm::floor(playerPosPrev.z / 64.f) * 64.f);
 
-    QSet<int64_t> terrainZonesBorderingCurrPos = terrainZonesBoarderingZone(currZone);
-    QSet<int64_t> terrainZonesBorderingPrevPos = terrainZonesBoarderingZone(prevZone);
+    // Compared against the ring of the last call rather than one built
+    // from an earlier position, so crossings between calls and changes
+    // of radius are never missed
+    QSet<int64_t> terrainZonesBorderingCurrPos = terrainZonesBoarderingZone(currZone, m_zoneRadius);
 //    cout << "tryExpansion" << endl;
     //destroy
-    for(auto id: terrainZonesBorderingPrevPos) {
+    for(auto id: m_activeZones) {
         if(!terrainZonesBorderingCurrPos.contains(id)) {
             glm::ivec2 coord = toCoords(id);
             for(int x = coord.x; x < coord.x + 64; x += 16) {
                 for(int z = coord.y; z < coord.y + 64; z += 16) {
-                    auto& chunk = getChunkAt(x, z);
+                    if(!hasChunkAt(x, z)) {
+                        continue;
+                    }
+                    Chunk *chunk = getChunkAt(x, z).get();
 //                    cout << "destroyVBOdata" << endl;
-                    chunk->destroyVBOdata();
+                    if(m_chunksBeingMeshed.count(chunk)) {
+                        m_chunksReleasedWhileMeshing.insert(chunk);
+                    } else {
+                        releaseChunk(chunk);
+                    }
+                    m_chunksAwaitingMesh.erase(chunk);
                 }
             }
         }
@@ -471,26 +477,86 @@ void Terrain::tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev) {
     for(auto id: terrainZonesBorderingCurrPos) {
         glm::ivec2 zone = toCoords(id);
         if(terrainZoneExists(zone.x,zone.y)) {
-            if(!terrainZonesBorderingPrevPos.contains(id)) {
+            if(!m_activeZones.contains(id)) {
+                // Chunks of a prefetched zone that are still generating
+                // are queued for meshing by checkThreadResults instead
                 for(int x = zone.x; x < zone.x + 64; x += 16) {
                     for(int z = zone.y; z < zone.y + 64; z += 16) {
                         auto& chunk = getChunkAt(x, z);
-                        spawnVBOWorker(chunk.get());
+                        m_chunksReleasedWhileMeshing.erase(chunk.get());
+                        if(chunk->m_generationState == GENERATED) {
+                            m_chunksAwaitingMesh.insert(chunk.get());
+                        }
                     }
                 }
             }
         }else{
-            spawnBlockTypeWorker(id);
+            spawnBlockTypeWorker(id, m_prefetcher.zonePriority(zone));
+        }
+    }
+    m_activeZones = terrainZonesBorderingCurrPos;
+
+    // Start generating the zones the player is heading into
+    for(const ZoneRequest &request : m_prefetcher.predictedZones()) {
+        glm::ivec2 zone = toCoords(request.zone);
+        if(!terrainZoneExists(zone.x, zone.y)) {
+            spawnBlockTypeWorker(request.zone, request.priority);
+        }
+    }
+}
+
+void Terrain::reprioritizeZoneWorkers() {
+    QMutexLocker locker(&m_pendingZoneWorkersLock);
+    for(auto it = m_pendingZoneWorkers.begin(); it != m_pendingZoneWorkers.end();) {
+        int priority = m_prefetcher.zonePriority(toCoords(it->first));
+        PendingZoneWorkers &pending = it->second;
+        if(priority == pending.priority) {
+            ++it;
+            continue;
+        }
+        // A worker that has already been dequeued will remove itself
+        // from the map as soon as it can take the lock, so tryTake
+        // failing just means it is running and we leave it alone
+        std::vector<BlockTypeWorker*> taken;
+        for(BlockTypeWorker *worker : pending.workers) {
+            if(QThreadPool::globalInstance()->tryTake(worker)) {
+                taken.push_back(worker);
+            }
+        }
+        if(priority < 0) {
+            // The player turned away; forget the zone so it is
+            // requested again if they come back this way. Chunks
+            // that are already being generated are kept.
+            for(BlockTypeWorker *worker : taken) {
+                worker->getChunk()->m_generationState = UNGENERATED;
+                delete worker;
+            }
+            m_pendingBlockDataChunks -= taken.size();
+            auto remaining = m_zoneChunksRemaining.find(it->first);
+            if(remaining != m_zoneChunksRemaining.end()
+                    && (remaining->second -= taken.size()) <= 0) {
+                m_zoneChunksRemaining.erase(remaining);
+            }
+            m_generatedTerrain.erase(it->first);
+            it = m_pendingZoneWorkers.erase(it);
+        } else if(taken.empty()) {
+            it = m_pendingZoneWorkers.erase(it);
+        } else {
+            pending.workers = taken;
+            pending.priority = priority;
+            for(BlockTypeWorker *worker : taken) {
+                QThreadPool::globalInstance()->start(worker, priority);
+            }
+            ++it;
         }
     }
-    if(currZone == prevZone) return;
 }
 
-QSet<int64_t> Terrain::terrainZonesBoarderingZone(glm::ivec2 zone) {
+QSet<int64_t> Terrain::terrainZonesBoarderingZone(glm::ivec2 zone, int radius) {
     QSet<int64_t> neighbors;
-    //5x5
-    for (int i = -128; i <= 128; i += 64) {
-        for (int j = -128; j <= 128; j += 64) {
+    // (2 * radius + 1) x (2 * radius + 1) zones centered on zone
+    for (int i = -64 * radius; i <= 64 * radius; i += 64) {
+        for (int j = -64 * radius; j <= 64 * radius; j += 64) {
             neighbors.insert(toKey(zone.x + i, zone.y + j));
         }
     }
@@ -503,28 +569,93 @@ bool Terrain::terrainZoneExists(int x, int z) const {
     return m_generatedTerrain.find(toKey(64 * xFloor, 64 * zFloor)) != m_generatedTerrain.end();
 }
 
-void Terrain::spawnBlockTypeWorker(int64_t zoneToGenerate) {
+void Terrain::spawnBlockTypeWorker(int64_t zoneToGenerate, int priority) {
 //    cout << "spawnBlockTypeWorker" << endl;
     m_generatedTerrain.insert(zoneToGenerate);
-    vector<Chunk*> chunksforWorker;
+    vector<BlockTypeWorker*> workers;
     glm::ivec2 coords = toCoords(zoneToGenerate);
     for(int x = coords.x; x < coords.x + 64; x += 16) {
         for(int z = coords.y; z < coords.y + 64; z += 16) {
-            Chunk* c = instantiateChunkAt(x,z);
-            // c->m_countOpq = 0; //allow it to be drawn even without VBO data
-            // c->m_countTra = 0; //allow it to be drawn even without VBO data
-            chunksforWorker.push_back(c);
+            // A zone whose workers were cancelled keeps its Chunks, and
+            // its neighbors still point at them, so reuse them
+            Chunk* c = hasChunkAt(x, z) ? getChunkAt(x, z).get() : instantiateChunkAt(x,z);
+            // Some of those may have been generated (or still be
+            // generating) before the rest of the zone was cancelled
+            if(c->m_generationState != UNGENERATED) {
+                continue;
+            }
+            c->m_generationState = GENERATING;
+            workers.push_back(new BlockTypeWorker(zoneToGenerate, c,
+                                                  &m_chunksThatHaveBlockData, &m_chunksThatHaveBlockDataLock,
+                                                  &m_pendingZoneWorkers, &m_pendingZoneWorkersLock));
         }
     }
-    BlockTypeWorker *worker = new BlockTypeWorker(coords.x, coords.y, chunksforWorker, &m_chunksThatHaveBlockData, &m_chunksThatHaveBlockDataLock);
-    QThreadPool::globalInstance()->start(worker);
+    if(workers.empty()) {
+        return;
+    }
+    m_pendingBlockDataChunks += workers.size();
+    m_zoneChunksRemaining[zoneToGenerate] += workers.size();
+    // Register the workers before any of them can start and look themselves up
+    m_pendingZoneWorkersLock.lock();
+    m_pendingZoneWorkers[zoneToGenerate] = PendingZoneWorkers{workers, priority};
+    m_pendingZoneWorkersLock.unlock();
+    for(BlockTypeWorker *worker : workers) {
+        QThreadPool::globalInstance()->start(worker, priority);
+    }
 }
 
 void Terrain::spawnVBOWorker(Chunk* chunkNeedingVBOData) {
 //    cout << "spawnVBOWorker" << endl;
+    m_pendingVBOChunks++;
+    m_chunksBeingMeshed.insert(chunkNeedingVBOData);
     VBOWorker *worker = new VBOWorker(chunkNeedingVBOData, &m_chunksThatHaveVBOs, &m_chunksThatHaveVBOsLock);
     QThreadPool::globalInstance()->start(worker);
 }
 
+void Terrain::setZoneRadius(int radius) {
+    m_zoneRadius = radius;
+}
+
+int Terrain::getZoneRadius() const {
+    return m_zoneRadius;
+}
 
+int Terrain::pendingJobCount() const {
+    return m_pendingBlockDataChunks + m_pendingVBOChunks;
+}
+
+bool Terrain::terrainZoneComplete(int x, int z) const {
+    int xFloor = static_cast<int>(glm::floor(x / 64.f));
+    int zFloor = static_cast<int>(glm::floor(z / 64.f));
+    int64_t zone = toKey(64 * xFloor, 64 * zFloor);
+    return m_generatedTerrain.count(zone) && !m_zoneChunksRemaining.count(zone);
+}
 
+void Terrain::generateZonesNow(int x, int z, int radius) {
+    glm::ivec2 center = 64 * glm::ivec2(glm::floor(glm::vec2(x, z) / 64.f));
+    std::vector<Chunk*> chunks;
+    for(int dx = -radius; dx <= radius; dx++) {
+        for(int dz = -radius; dz <= radius; dz++) {
+            glm::ivec2 zone = center + 64 * glm::ivec2(dx, dz);
+            m_generatedTerrain.insert(toKey(zone.x, zone.y));
+            for(int cx = zone.x; cx < zone.x + 64; cx += 16) {
+                for(int cz = zone.y; cz < zone.y + 64; cz += 16) {
+                    Chunk* c = hasChunkAt(cx, cz) ? getChunkAt(cx, cz).get() : instantiateChunkAt(cx, cz);
+                    if(c->m_generationState == UNGENERATED) {
+                        c->m_generationState = GENERATING;
+                        chunks.push_back(c);
+                    }
+                }
+            }
+        }
+    }
+    parallelFor(static_cast<int>(chunks.size()), 1, [&chunks](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            chunks[i]->generateChunk();
+            LightEngine::lightChunk(chunks[i]);
+        }
+    });
+    for(Chunk *c : chunks) {
+        finishChunkGeneration(c);
+    }
+}
@@ -9,6 +9,10 @@
 #include "cube.h"
 #include "blocktypeworker.h"
 #include "vboworker.h"
+#include "zoneprefetcher.h"
+#include "fluidsimulator.h"
+#include "blocktickscheduler.h"
+#include "navgraph.h"
 #include <QThreadPool>
 
 
@@ -61,13 +65,79 @@ private:
 
     std::vector<ChunkVBOData> m_chunksThatHaveVBOs;
     QMutex m_chunksThatHaveVBOsLock;
+
+    // GL objects may only be touched on the render thread, so the
+    // simulation thread leaves VBO uploads and frees to uploadVBOResults.
+    // Chunks whose VBO data has been uploaded, for checkThreadResults
+    // to stop counting as being meshed
+    std::vector<Chunk*> m_chunksUploaded;
+    QMutex m_chunksUploadedLock;
+    // Chunks that left the active zones and whose VBOs should be freed
+    std::vector<Chunk*> m_chunksToRelease;
+    QMutex m_chunksToReleaseLock;
+    // Every Chunk with VBO data, by key. Render thread only, so draw()
+    // never reads m_chunks while the simulation thread adds to it.
+    std::unordered_map<int64_t, Chunk*> m_drawableChunks;
     float m_tryExpansionTimer;
 
+    // How many terrain zones around the player's zone are kept generated
+    // and meshed
+    int m_zoneRadius;
+
+    // Number of chunks handed to worker threads whose results
+    // have not yet been consumed by checkThreadResults()
+    int m_pendingBlockDataChunks;
+    int m_pendingVBOChunks;
+
+    // Zones in the ring around the player as of the last tryExpansion().
+    // Only chunks in these zones are meshed as soon as they are generated;
+    // prefetched zones are meshed once the player gets close to them.
+    QSet<int64_t> m_activeZones;
+
+    // BlockTypeWorkers that have been queued but not yet started, by zone
+    std::unordered_map<int64_t, PendingZoneWorkers> m_pendingZoneWorkers;
+    QMutex m_pendingZoneWorkersLock;
+
+    // Number of Chunks in each zone still waiting on a BlockTypeWorker.
+    // A zone is removed once all of its Chunks are generated.
+    std::unordered_map<int64_t, int> m_zoneChunksRemaining;
+
+    // Chunks in active zones that should be meshed as soon as they
+    // and their neighbors have finished generating
+    std::unordered_set<Chunk*> m_chunksAwaitingMesh;
+    // Chunks with a VBOWorker in flight; a Chunk is never meshed
+    // by two workers at once
+    std::unordered_set<Chunk*> m_chunksBeingMeshed;
+    // Chunks that left the active zones while being meshed. They are
+    // released once their upload is done, so it cannot rebuffer them.
+    std::unordered_set<Chunk*> m_chunksReleasedWhileMeshing;
+
+    // True once this Chunk and every existing neighbor that is still
+    // being generated are done, so its border faces can be meshed
+    bool isReadyToMesh(const Chunk *c) const;
+    void spawnReadyVBOWorkers();
+    // Queues c for uploadVBOResults to free its VBOs
+    void releaseChunk(Chunk *c);
+    void finishChunkGeneration(Chunk *c);
+    // Queues every Chunk in changed that lies in an active zone for remeshing
+    void remeshChunks(const std::unordered_set<Chunk*> &changed);
+
+    // Moves WATER and LAVA around after the blocks next to them change
+    FluidSimulator m_fluids;
+    // Random and scheduled block updates in the active zones
+    BlockTickScheduler m_blockTicks;
+    // Applies the changes m_blockTicks has ready until its time budget runs out
+    void applyBlockTicks();
+
+    // Re-prioritizes queued zone workers using the prefetcher's latest
+    // prediction and cancels those the player has moved away from
+    void reprioritizeZoneWorkers();
+
 public:
     Terrain(OpenGLContext *context);
     ~Terrain();
 
-    // Instantiates a new Chunk and stores it in
+    // Instantiates a new, empty Chunk and stores it in
     // our chunk map at the given coordinates.
     // Returns a pointer to the created Chunk.
     Chunk* instantiateChunkAt(int x, int z);
@@ -84,27 +154,62 @@ public:
     // values) return the block stored at that point in space.
     BlockType getBlockAt(int x, int y, int z) const;
     BlockType getBlockAt(glm::vec3 p) const;
+    // Height of the highest non-EMPTY block in the column at world x, z,
+    // or -1 if the column is empty or has no Chunk.
+    // Useful for spawning, minimaps and LOD.
+    int getHeightAt(int x, int z) const;
+    // Height of the lowest non-EMPTY block in that column, or -1
+    int getMinHeightAt(int x, int z) const;
     // Given a world-space coordinate (which may have negative
     // values) set the block at that point in space to the
     // given type.
     void setBlockAt(int x, int y, int z, BlockType t);
+    // Changes a block the way the player does: unlike setBlockAt this
+    // relights the area around it and remeshes every Chunk affected
+    void editBlockAt(int x, int y, int z, BlockType t);
 
     // Draws every Chunk that falls within the bounding box
     // described by the min and max coords, using the provided
-    // ShaderProgram
+    // ShaderProgram. Render thread only.
     void draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram);
+    // Buffers the VBO data that VBOWorkers have finished and frees the
+    // VBOs of Chunks that were released. Render thread only; everything
+    // else besides draw() belongs to the simulation thread.
+    void uploadVBOResults();
 
+    // Regenerates the column of blocks at world x, z from the terrain
+    // noise. Assumes a Chunk exists there.
     void setBlock(int x, int z);
 
     // Initializes the Chunks that store the 64 x 256 x 64 block scene you
     // see when the base code is run.
     void CreateTestScene();
-    void spawnVBOWorkers(const vector<Chunk*> &chunksNeedingVBOs);
     void checkThreadResults();
-    void multithreadedWork(glm::vec3 playerPos, glm::vec3 playerPosPrev, float dT);
-    void tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev);
-    QSet<int64_t> terrainZonesBoarderingZone(glm::ivec2 zone);
+    // Predicts which zones the player is heading into.
+    // Its tunables may be adjusted directly.
+    ZonePrefetcher m_prefetcher;
+    // Walkable surface of every generated Chunk, for mob pathfinding.
+    // Kept up to date as Chunks are generated and edited.
+    NavGraph m_navGraph;
+
+    void multithreadedWork(glm::vec3 playerPos, glm::vec3 playerVel, glm::vec3 playerLook, float dT);
+    void tryExpansion(glm::vec3 playerPos, glm::vec3 playerVel, glm::vec3 playerLook);
+    QSet<int64_t> terrainZonesBoarderingZone(glm::ivec2 zone, int radius);
     bool terrainZoneExists(int x, int z) const;
-    void spawnBlockTypeWorker(int64_t zoneToGenerate);
+    void spawnBlockTypeWorker(int64_t zoneToGenerate, int priority);
     void spawnVBOWorker(Chunk* chunkNeedingVBOData);
+
+    // Set the number of terrain zones around the player's zone that
+    // should be generated. Takes effect on the next tryExpansion().
+    void setZoneRadius(int radius);
+    int getZoneRadius() const;
+    // Number of chunks waiting on block generation or VBO workers
+    int pendingJobCount() const;
+    // True if every Chunk of the zone with this lower-left corner
+    // has finished generating
+    bool terrainZoneComplete(int x, int z) const;
+    // Generates and lights every zone within radius zones of the one
+    // holding world x, z before returning, using every core. For tools
+    // that need terrain without running the game loop or a GL context.
+    void generateZonesNow(int x, int z, int radius);
 };
@@ -0,0 +1,97 @@
+#include "zoneprefetcher.h"
+#include "terrain.h"
+#include <algorithm>
+
+// Below this speed (blocks per dT) the player is treated as standing still
+static const float MIN_PREFETCH_SPEED = 1e-5f;
+
+ZonePrefetcher::ZonePrefetcher()
+    : m_lookAheadTime(300.f), m_coneHalfAngle(35.f), m_lookWeight(0.3f),
+      m_maxPredictedZones(8),
+      m_position(0.f), m_direction(0.f), m_pathLength(0.f),
+      m_currZone(0), m_zoneRadius(2)
+{}
+
+void ZonePrefetcher::update(glm::vec3 playerPos, glm::vec3 velocity, glm::vec3 look, int zoneRadius) {
+    m_position = glm::vec2(playerPos.x, playerPos.z);
+    m_currZone = glm::ivec2(glm::floor(m_position / 64.f) * 64.f);
+    m_zoneRadius = zoneRadius;
+
+    glm::vec2 horizVel(velocity.x, velocity.z);
+    float speed = glm::length(horizVel);
+    if(speed < MIN_PREFETCH_SPEED) {
+        m_direction = glm::vec2(0.f);
+        m_pathLength = 0.f;
+        return;
+    }
+
+    glm::vec2 dir = horizVel / speed;
+    glm::vec2 horizLook(look.x, look.z);
+    if(glm::length(horizLook) > 0.f) {
+        glm::vec2 bent = glm::mix(dir, glm::normalize(horizLook), m_lookWeight);
+        // Looking straight back cancels out; keep the velocity direction then
+        if(glm::length(bent) > 0.01f) {
+            dir = glm::normalize(bent);
+        }
+    }
+    m_direction = dir;
+    m_pathLength = speed * m_lookAheadTime;
+}
+
+int ZonePrefetcher::zonePriority(glm::ivec2 zone) const {
+    glm::ivec2 offset = (zone - m_currZone) / 64;
+    int ringDist = std::max(std::abs(offset.x), std::abs(offset.y));
+    if(ringDist <= m_zoneRadius) {
+        return RING_PRIORITY - ringDist;
+    }
+    if(m_pathLength <= 0.f) {
+        return -1;
+    }
+
+    glm::vec2 toZone = glm::vec2(zone) + glm::vec2(32.f) - m_position;
+    float dist = glm::length(toZone);
+    // Anything beyond the predicted position plus the ring radius
+    // will be picked up by later updates
+    if(dist > m_pathLength + 64.f * (m_zoneRadius + 1)) {
+        return -1;
+    }
+    float cosAngle = glm::dot(toZone / dist, m_direction);
+    if(cosAngle < glm::cos(glm::radians(m_coneHalfAngle))) {
+        return -1;
+    }
+    // Nearer zones are reached sooner, so they run first
+    return std::max(0, PREDICTED_PRIORITY - static_cast<int>(dist / 64.f));
+}
+
+std::vector<ZoneRequest> ZonePrefetcher::predictedZones() const {
+    std::vector<ZoneRequest> requests;
+    if(m_pathLength <= 0.f) {
+        return requests;
+    }
+
+    // Bounding box of the path from the player to the predicted
+    // position, padded by the ring radius, in zone coordinates
+    glm::vec2 predicted = m_position + m_direction * m_pathLength;
+    float pad = 64.f * (m_zoneRadius + 1);
+    glm::ivec2 minZone = glm::ivec2(glm::floor((glm::min(m_position, predicted) - pad) / 64.f));
+    glm::ivec2 maxZone = glm::ivec2(glm::floor((glm::max(m_position, predicted) + pad) / 64.f));
+
+    for(int x = minZone.x; x <= maxZone.x; x++) {
+        for(int z = minZone.y; z <= maxZone.y; z++) {
+            glm::ivec2 zone(x * 64, z * 64);
+            int priority = zonePriority(zone);
+            // Ring zones are requested by Terrain::tryExpansion itself
+            if(priority >= 0 && priority <= PREDICTED_PRIORITY) {
+                requests.push_back(ZoneRequest(toKey(zone.x, zone.y), priority));
+            }
+        }
+    }
+
+    std::stable_sort(requests.begin(), requests.end(), [](const ZoneRequest &a, const ZoneRequest &b) {
+        return a.priority > b.priority;
+    });
+    if(static_cast<int>(requests.size()) > m_maxPredictedZones) {
+        requests.erase(requests.begin() + m_maxPredictedZones, requests.end());
+    }
+    return requests;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "glm_includes.h"
+#include <vector>
+#include <cstdint>
+
+// A terrain generation zone that should be generated, along
+// with the QThreadPool priority its worker should run at
+struct ZoneRequest {
+    int64_t zone;
+    int priority;
+    ZoneRequest(int64_t z, int p) : zone(z), priority(p)
+    {}
+};
+
+// Decides which terrain zones to generate ahead of a moving player.
+// Each update() extrapolates the player's horizontal velocity (bent
+// slightly towards where they are looking) over a look-ahead time,
+// and every zone inside a cone around that path is scored by how
+// soon the player will reach it. Zones in the ring around the player
+// always outrank predicted zones; zones that are neither in the ring
+// nor ahead of the player get a negative priority, meaning any worker
+// still queued for them can be cancelled.
+class ZonePrefetcher {
+public:
+    // How far ahead to extrapolate, in the same units as the
+    // dT passed to Player::tick (roughly tenths of a millisecond)
+    float m_lookAheadTime;
+    // Half angle of the prefetch cone around the travel direction, in degrees
+    float m_coneHalfAngle;
+    // How strongly the look direction bends the travel direction, 0 to 1
+    float m_lookWeight;
+    // Upper bound on the number of predicted zones returned per update
+    int m_maxPredictedZones;
+
+    static const int RING_PRIORITY = 100;
+    static const int PREDICTED_PRIORITY = 50;
+
+private:
+    glm::vec2 m_position; // Player position on the xz plane
+    glm::vec2 m_direction; // Normalized travel direction, or zero when not moving
+    float m_pathLength; // Distance the player is expected to cover within the look-ahead
+    glm::ivec2 m_currZone;
+    int m_zoneRadius;
+
+public:
+    ZonePrefetcher();
+
+    // velocity is in blocks per dT unit, see Player::getWorldVelocity
+    void update(glm::vec3 playerPos, glm::vec3 velocity, glm::vec3 look, int zoneRadius);
+
+    // Priority for the zone with this lower-left corner,
+    // or -1 if the player is not heading towards it
+    int zonePriority(glm::ivec2 zone) const;
+
+    // Zones outside the ring around the player that lie ahead
+    // of them, highest priority first
+    std::vector<ZoneRequest> predictedZones() const;
+};
@@ -1,4 +1,5 @@
 #include "shaderprogram.h"
+#include "frameuniforms.h"
 #include <QFile>
 #include <QStringBuilder>
 #include <QTextStream>
@@ -8,55 +9,24 @@
 
 ShaderProgram::ShaderProgram(OpenGLContext *context)
     : vertShader(), fragShader(), prog(),
-      attrPos(-1), attrNor(-1), attrCol(-1),
-      unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifColor(-1),
+      attrPos(-1), attrNor(-1), attrCol(-1), attrPosOffset(-1), attrScale(-1), attrUV(-1),
+      unifModel(-1), unifModelInvTr(-1), unifColor(-1), unifSampler2D(-1),
+      m_modelLinear(), m_modelInvTrSet(false), m_builder(context),
       context(context)
 {}
 
 void ShaderProgram::create(const char *vertfile, const char *fragfile)
 {
-    // Allocate space on our GPU for a vertex shader and a fragment shader and a shader program to manage the two
-    vertShader = context->glCreateShader(GL_VERTEX_SHADER);
-    fragShader = context->glCreateShader(GL_FRAGMENT_SHADER);
     prog = context->glCreateProgram();
-    // Get the body of text stored in our two .glsl files
-    QString qVertSource = qTextFileRead(vertfile);
-    QString qFragSource = qTextFileRead(fragfile);
-
-    char* vertSource = new char[qVertSource.size()+1];
-    strcpy(vertSource, qVertSource.toStdString().c_str());
-    char* fragSource = new char[qFragSource.size()+1];
-    strcpy(fragSource, qFragSource.toStdString().c_str());
-
-
-    // Send the shader text to OpenGL and store it in the shaders specified by the handles vertShader and fragShader
-    context->glShaderSource(vertShader, 1, (const char**)&vertSource, 0);
-    context->glShaderSource(fragShader, 1, (const char**)&fragSource, 0);
-    // Tell OpenGL to compile the shader text stored above
-    context->glCompileShader(vertShader);
-    context->glCompileShader(fragShader);
-    // Check if everything compiled OK
-    GLint compiled;
-    context->glGetShaderiv(vertShader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        printShaderInfoLog(vertShader);
-    }
-    context->glGetShaderiv(fragShader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        printShaderInfoLog(fragShader);
-    }
-
-    // Tell prog that it manages these particular vertex and fragment shaders
-    context->glAttachShader(prog, vertShader);
-    context->glAttachShader(prog, fragShader);
-    context->glLinkProgram(prog);
+    // Get the body of text stored in our two .glsl files, and hand it to
+    // the driver (or load last launch's binary). Nothing waits for the
+    // result until the program is first used.
+    m_builder.start(prog, qTextFileRead(vertfile).toUtf8(), qTextFileRead(fragfile).toUtf8());
+}
 
-    // Check for linking success
-    GLint linked;
-    context->glGetProgramiv(prog, GL_LINK_STATUS, &linked);
-    if (!linked) {
-        printLinkInfoLog(prog);
-    }
+void ShaderProgram::finishCreate()
+{
+    m_builder.finish();
 
     // Get the handles to the variables stored in our shaders
     // See shaderprogram.h for more information about these variables
@@ -67,18 +37,29 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     attrUV = context->glGetAttribLocation(prog, "vs_UV");
     if(attrCol == -1) attrCol = context->glGetAttribLocation(prog, "vs_ColInstanced");
     attrPosOffset = context->glGetAttribLocation(prog, "vs_OffsetInstanced");
+    attrScale = context->glGetAttribLocation(prog, "vs_ScaleInstanced");
 
     unifModel      = context->glGetUniformLocation(prog, "u_Model");
     unifModelInvTr = context->glGetUniformLocation(prog, "u_ModelInvTr");
-    unifViewProj   = context->glGetUniformLocation(prog, "u_ViewProj");
     unifColor      = context->glGetUniformLocation(prog, "u_Color");
     unifSampler2D  = context->glGetUniformLocation(prog, "u_Texture");
-    unifTime = context->glGetUniformLocation(prog, "u_Time");
+
+    // The camera, light and time come from the shared PerFrame block,
+    // and the sampler always reads unit 0, so neither is set per draw
+    FrameUniforms::attach(context, prog);
+    if(unifSampler2D != -1)
+    {
+        context->glState().useProgram(prog);
+        context->glUniform1i(unifSampler2D, /*GL_TEXTURE*/0);
+    }
 }
 
 void ShaderProgram::useMe()
 {
-    context->glUseProgram(prog);
+    if (m_builder.pending()) {
+        finishCreate();
+    }
+    context->glState().useProgram(prog);
 }
 
 void ShaderProgram::setModelMatrix(const glm::mat4 &model)
@@ -97,7 +78,12 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model)
                            &model[0][0]);
     }
 
-    if (unifModelInvTr != -1) {
+    // Chunks only differ by translation, which leaves the inverse
+    // transpose's 3x3 part, the only part the shaders use, unchanged
+    glm::mat3 linear(model);
+    if (unifModelInvTr != -1 && (!m_modelInvTrSet || linear != m_modelLinear)) {
+        m_modelLinear = linear;
+        m_modelInvTrSet = true;
         glm::mat4 modelinvtr = glm::inverse(glm::transpose(model));
         // Pass a 4x4 matrix into a uniform variable in our shader
                         // Handle to the matrix variable on the GPU
@@ -111,24 +97,6 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model)
     }
 }
 
-void ShaderProgram::setViewProjMatrix(const glm::mat4 &vp)
-{
-    // Tell OpenGL to use this shader program for subsequent function calls
-    useMe();
-
-    if(unifViewProj != -1) {
-    // Pass a 4x4 matrix into a uniform variable in our shader
-                    // Handle to the matrix variable on the GPU
-    context->glUniformMatrix4fv(unifViewProj,
-                    // How many matrices to pass
-                       1,
-                    // Transpose the matrix? OpenGL uses column-major, so no.
-                       GL_FALSE,
-                    // Pointer to the first element of the matrix
-                       &vp[0][0]);
-    }
-}
-
 void ShaderProgram::setGeometryColor(glm::vec4 color)
 {
     useMe();
@@ -157,36 +125,29 @@ void ShaderProgram::draw(Drawable &d)
     // glBindBuffer on the Drawable's VBO for vertex position,
     // meaning that glVertexAttribPointer associates vs_Pos
     // (referred to by attrPos) with that VBO
-
-    if(unifSampler2D != -1)
-    {
-        context->glUniform1i(unifSampler2D, /*GL_TEXTURE*/0);
-    }
-
+    unsigned int attribs = 0;
     if (attrPos != -1 && d.bindPos()) {
-        context->glEnableVertexAttribArray(attrPos);
         context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, NULL);
+        attribs |= 1u << attrPos;
     }
 
     if (attrNor != -1 && d.bindNor()) {
-        context->glEnableVertexAttribArray(attrNor);
         context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 0, NULL);
+        attribs |= 1u << attrNor;
     }
 
     if (attrCol != -1 && d.bindCol()) {
-        context->glEnableVertexAttribArray(attrCol);
         context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, 0, NULL);
+        attribs |= 1u << attrCol;
     }
+    // Arrays stay enabled between draws that use the same ones
+    context->glState().setAttribArrays(attribs);
 
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
     d.bindIdx();
     context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
 
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
-
     context->printGLErrorLog();
 }
 
@@ -198,11 +159,6 @@ void ShaderProgram::drawInstanced(InstancedDrawable &d)
         throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
     }
 
-    if(unifSampler2D != -1)
-    {
-        context->glUniform1i(unifSampler2D, /*GL_TEXTURE*/0);
-    }
-
     // Each of the following blocks checks that:
     //   * This shader has this attribute, and
     //   * This Drawable has a vertex buffer for this attribute.
@@ -212,29 +168,37 @@ void ShaderProgram::drawInstanced(InstancedDrawable &d)
     // glBindBuffer on the Drawable's VBO for vertex position,
     // meaning that glVertexAttribPointer associates vs_Pos
     // (referred to by attrPos) with that VBO
+    unsigned int attribs = 0;
     if (attrPos != -1 && d.bindPos()) {
-        context->glEnableVertexAttribArray(attrPos);
         context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, NULL);
         context->glVertexAttribDivisor(attrPos, 0);
+        attribs |= 1u << attrPos;
     }
 
     if (attrNor != -1 && d.bindNor()) {
-        context->glEnableVertexAttribArray(attrNor);
         context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 0, NULL);
         context->glVertexAttribDivisor(attrNor, 0);
+        attribs |= 1u << attrNor;
     }
 
     if (attrCol != -1 && d.bindCol()) {
-        context->glEnableVertexAttribArray(attrCol);
         context->glVertexAttribPointer(attrCol, 3, GL_FLOAT, false, 0, NULL);
         context->glVertexAttribDivisor(attrCol, 1);
+        attribs |= 1u << attrCol;
     }
 
     if (attrPosOffset != -1 && d.bindOffsetBuf()) {
-        context->glEnableVertexAttribArray(attrPosOffset);
         context->glVertexAttribPointer(attrPosOffset, 3, GL_FLOAT, false, 0, NULL);
         context->glVertexAttribDivisor(attrPosOffset, 1);
+        attribs |= 1u << attrPosOffset;
+    }
+
+    if (attrScale != -1 && d.bindScaleBuf()) {
+        context->glVertexAttribPointer(attrScale, 3, GL_FLOAT, false, 0, NULL);
+        context->glVertexAttribDivisor(attrScale, 1);
+        attribs |= 1u << attrScale;
     }
+    context->glState().setAttribArrays(attribs);
 
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
@@ -242,131 +206,112 @@ void ShaderProgram::drawInstanced(InstancedDrawable &d)
     context->glDrawElementsInstanced(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0, d.instanceCount());
     context->printGLErrorLog();
 
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
-    if (attrPosOffset != -1) context->glDisableVertexAttribArray(attrPosOffset);
+    // Divisors belong to the attribute slot, not this program, so other
+    // programs would otherwise read these slots per instance too
+    if (attrCol != -1) context->glVertexAttribDivisor(attrCol, 0);
+    if (attrPosOffset != -1) context->glVertexAttribDivisor(attrPosOffset, 0);
+    if (attrScale != -1) context->glVertexAttribDivisor(attrScale, 0);
 
 }
 
-//This function, as its name implies, uses the passed in GL widget
-void ShaderProgram::drawInterleaved(Drawable &d, RenderHelpers renderElement)
+void ShaderProgram::drawInstancedInterleaved(InstancedDrawable &d, int first, int count)
 {
-
     useMe();
 
-    // Check if the caller has requested the primary VBO to be drawn
-    if (renderElement == PRIMARY) {
-        if(d.elemCount() < 0) {
-            throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
-        }
-
-        if(unifSampler2D != -1)
-        {
-            context->glUniform1i(unifSampler2D, /*GL_TEXTURE*/0);
-        }
-
-        // Each of the following blocks checks that:
-        //   * This shader has this attribute, and
-        //   * This Drawable has a vertex buffer for this attribute.
-        // If so, it binds the appropriate buffers to each attribute.
-
-        // Remember, by calling bindPos(), we call
-        // glBindBuffer on the Drawable's VBO for vertex position,
-        // meaning that glVertexAttribPointer associates vs_Pos
-        // (referred to by attrPos) with that VBO
-        if (attrPos != -1 && d.bindPos()) {
-            context->glEnableVertexAttribArray(attrPos);
-            context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*)0);
-        }
-
-        if (attrNor != -1 && d.bindNor()) {
-            context->glEnableVertexAttribArray(attrNor);
-            context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*)sizeof(glm::vec4));
-        }
-
-        if (attrUV != -1 && d.bindUV()) {
-            context->glEnableVertexAttribArray(attrUV);
-            context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*) (2 * sizeof(glm::vec4)));
-        }
-
-        // Bind the index buffer and then draw shapes from it.
-        // This invokes the shader program, which accesses the vertex buffers.
-        d.bindIdx();
-        context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
-
-        if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-        if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-        if (attrUV  != -1) context->glDisableVertexAttribArray(attrUV);
-        return;
-    }
-
-    // Draw secondary VBO
     if(d.elemCount() < 0) {
         throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
     }
-
-    if (attrPos != -1 && d.bindPos_sec()) {
-       context->glEnableVertexAttribArray(attrPos);
-       context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*)0);
+    if(count <= 0) {
+        return;
     }
 
-    if (attrNor != -1 && d.bindNor_sec()) {
-        context->glEnableVertexAttribArray(attrNor);
-        context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*)sizeof(glm::vec4));
+    unsigned int attribs = 0;
+    if (attrPos != -1 && d.bindPos()) {
+        context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, NULL);
+        context->glVertexAttribDivisor(attrPos, 0);
+        attribs |= 1u << attrPos;
     }
 
-    if (attrUV != -1 && d.bindUV_sec()) {
-        context->glEnableVertexAttribArray(attrUV);
-        context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*) (2 * sizeof(glm::vec4)));
+    if (attrNor != -1 && d.bindNor()) {
+        context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 0, NULL);
+        context->glVertexAttribDivisor(attrNor, 0);
+        attribs |= 1u << attrNor;
     }
 
-    // Bind the index buffer and then draw shapes from it.
-    // This invokes the shader program, which accesses the vertex buffers.
-    d.bindIdx_sec();
-    context->glDrawElements(d.drawMode(), d.elemCount_sec(), GL_UNSIGNED_INT, 0);
-
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrUV  != -1) context->glDisableVertexAttribArray(attrUV);
-
-    // Draw secondary VBO
-    if (d.elemCount_sec() > 0) {
-        if (attrPos != -1 && d.bindPos_sec()) {
-            context->glEnableVertexAttribArray(attrPos);
-            context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*)0);
+    // All three instance attributes come from the same buffer. Starting
+    // the pointers at instance first draws a range without needing
+    // glDrawElementsInstancedBaseInstance.
+    if (d.bindOffsetBuf()) {
+        GLsizei stride = 3 * sizeof(glm::vec3);
+        size_t base = static_cast<size_t>(first) * stride;
+        int attrs[3] = {attrPosOffset, attrScale, attrCol};
+        for (int i = 0; i < 3; i++) {
+            if (attrs[i] == -1) {
+                continue;
+            }
+            context->glVertexAttribPointer(attrs[i], 3, GL_FLOAT, false, stride,
+                                           reinterpret_cast<void*>(base + i * sizeof(glm::vec3)));
+            context->glVertexAttribDivisor(attrs[i], 1);
+            attribs |= 1u << attrs[i];
         }
+    }
+    context->glState().setAttribArrays(attribs);
 
-        if (attrNor != -1 && d.bindNor_sec()) {
-            context->glEnableVertexAttribArray(attrNor);
-            context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*)sizeof(glm::vec4));
-        }
+    d.bindIdx();
+    context->glDrawElementsInstanced(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0, count);
+    context->printGLErrorLog();
 
-        if (attrUV != -1 && d.bindUV_sec()) {
-            context->glEnableVertexAttribArray(attrUV);
-            context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*) (2 * sizeof(glm::vec4)));
+    for (int attr : {attrPosOffset, attrScale, attrCol}) {
+        if (attr != -1) {
+            context->glVertexAttribDivisor(attr, 0);
         }
-
-        // Bind the index buffer and then draw shapes from it.
-        // This invokes the shader program, which accesses the vertex buffers.
-        d.bindIdx_sec();
-        context->glDrawElements(d.drawMode(), d.elemCount_sec(), GL_UNSIGNED_INT, 0);
-
-        if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-        if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-        if (attrUV  != -1) context->glDisableVertexAttribArray(attrUV);
     }
-    context->printGLErrorLog();
 }
 
-void ShaderProgram::setTime(int t)
+//This function, as its name implies, uses the passed in GL widget
+void ShaderProgram::drawInterleaved(Drawable &d, RenderHelpers renderElement)
 {
+
     useMe();
 
-    if(unifTime != -1)
-    {
-        context->glUniform1i(unifTime, t);
+    // The primary VBO holds the opaque faces and the secondary the
+    // transparent ones; both are drawn the same way
+    int count = renderElement == PRIMARY ? d.elemCount() : d.elemCount_sec();
+    if(count < 0) {
+        throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(count) + "!");
+    }
+    if(count == 0) {
+        return;
+    }
+
+    // Position, normal and UV are interleaved in one buffer, so a single
+    // bind serves all three attributes
+    bool bound = renderElement == PRIMARY ? d.bindPos() : d.bindPos_sec();
+    if (!bound) {
+        return;
+    }
+    GLsizei stride = 3 * sizeof(glm::vec4);
+    int attrs[3] = {attrPos, attrNor, attrUV};
+    unsigned int attribs = 0;
+    for (int i = 0; i < 3; i++) {
+        if (attrs[i] == -1) {
+            continue;
+        }
+        context->glVertexAttribPointer(attrs[i], 4, GL_FLOAT, false, stride,
+                                       reinterpret_cast<void*>(i * sizeof(glm::vec4)));
+        attribs |= 1u << attrs[i];
     }
+    context->glState().setAttribArrays(attribs);
+
+    // Bind the index buffer and then draw shapes from it.
+    // This invokes the shader program, which accesses the vertex buffers.
+    if (renderElement == PRIMARY) {
+        d.bindIdx();
+    } else {
+        d.bindIdx_sec();
+    }
+    context->glDrawElements(d.drawMode(), count, GL_UNSIGNED_INT, 0);
+    context->printGLErrorLog();
 }
 
 char* ShaderProgram::textFileRead(const char* fileName) {
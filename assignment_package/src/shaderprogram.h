@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 
 #include "drawable.h"
+#include "programbuilder.h"
 
 enum RenderHelpers {PRIMARY, SECONDARY};
 
@@ -20,35 +21,35 @@ public:
     int attrNor; // A handle for the "in" vec4 representing vertex normal in the vertex shader
     int attrCol; // A handle for the "in" vec4 representing vertex color in the vertex shader
     int attrPosOffset; // A handle for a vec3 used only in the instanced rendering shader
+    int attrScale; // A handle for the per-instance vec3 size in the instanced rendering shader
     int attrUV; // A handle for the "in" vec2 representing UVs in the vertex shader
 
     int unifModel; // A handle for the "uniform" mat4 representing model matrix in the vertex shader
     int unifModelInvTr; // A handle for the "uniform" mat4 representing inverse transpose of the model matrix in the vertex shader
-    int unifViewProj; // A handle for the "uniform" mat4 representing combined projection and view matrices in the vertex shader
     int unifColor; // A handle for the "uniform" vec4 representing color of geometry in the vertex shader
     int unifSampler2D; // A handle for the "uniform" texture
-    int unifTime; // A handle for the time variable
 
 public:
     ShaderProgram(OpenGLContext* context);
-    // Sets up the requisite GL data and shaders from the given .glsl files
+    // Sets up the requisite GL data and shaders from the given .glsl files.
+    // The driver may still be building them when this returns; the first
+    // useMe() waits for it.
     void create(const char *vertfile, const char *fragfile);
     // Tells our OpenGL context to use this shader to draw things
     void useMe();
     // Pass the given model matrix to this shader on the GPU
     void setModelMatrix(const glm::mat4 &model);
-    // Pass the given Projection * View matrix to this shader on the GPU
-    void setViewProjMatrix(const glm::mat4 &vp);
     // Pass the given color to this shader on the GPU
     void setGeometryColor(glm::vec4 color);
     // Draw the given object to our screen using this ShaderProgram's shaders
     void draw(Drawable &d);
     // Draw the given object to our screen multiple times using instanced rendering
     void drawInstanced(InstancedDrawable &d);
+    // Draw instances first to first + count - 1 of the data streamed
+    // with InstancedDrawable::streamInterleavedInstances
+    void drawInstancedInterleaved(InstancedDrawable &d, int first, int count);
     // Draw the given object using interleaved rendering
     void drawInterleaved(Drawable &d, RenderHelpers renderElement);
-    // Function to set time
-    void setTime(int t);
     // Utility function used in create()
     char* textFileRead(const char*);
     // Utility function that prints any shader compilation errors to the console
@@ -60,6 +61,15 @@ public:
     QString qTextFileRead(const char*);
 
 private:
+    // The linear part of the last model matrix, whose inverse transpose
+    // is what the shaders use for normals
+    glm::mat3 m_modelLinear;
+    bool m_modelInvTrSet;
+    ProgramBuilder m_builder;
+
+    // Waits for the program to be built and looks up its handles
+    void finishCreate();
+
     OpenGLContext* context;   // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                             // we need to pass our OpenGL context to the Drawable in order to call GL functions
                             // from within this class.
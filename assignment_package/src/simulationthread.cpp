@@ -0,0 +1,31 @@
+#include "simulationthread.h"
+#include <QElapsedTimer>
+
+SimulationThread::SimulationThread(function<void(float)> s, float length)
+    : step(s), stepLength(length)
+{
+}
+
+void SimulationThread::run()
+{
+    QElapsedTimer clock;
+    clock.start();
+    // dT units are 10 ms each
+    qint64 stepNs = static_cast<qint64>(stepLength * 1e7f);
+    qint64 nextStep = clock.nsecsElapsed();
+    while (!isInterruptionRequested()) {
+        int steps = 0;
+        while (clock.nsecsElapsed() >= nextStep && steps < MAX_CATCH_UP_STEPS) {
+            step(stepLength);
+            nextStep += stepNs;
+            steps++;
+        }
+        if (steps == MAX_CATCH_UP_STEPS) {
+            nextStep = clock.nsecsElapsed();
+        }
+        qint64 waitNs = nextStep - clock.nsecsElapsed();
+        if (waitNs > 0) {
+            QThread::usleep(static_cast<unsigned long>(waitNs / 1000));
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef SIMULATIONTHREAD_H
+#define SIMULATIONTHREAD_H
+
+#include <QThread>
+#include <functional>
+using namespace std;
+
+// Advances the world at a fixed rate on its own thread, however long
+// frames take to draw. Every call to step is given the same dT,
+// stepLength, in the units MyGL has always used (1 is 10 ms), so physics
+// behaves the same at any frame rate. Steps that fall behind are run
+// back to back to catch up, but never more than MAX_CATCH_UP_STEPS in a
+// row; past that the simulation slows down instead of falling further
+// behind.
+class SimulationThread : public QThread
+{
+protected:
+    function<void(float)> step;
+    float stepLength;
+public:
+    static const int MAX_CATCH_UP_STEPS = 5;
+
+    SimulationThread(function<void(float)> s, float length);
+    void run() override;
+};
+#endif // SIMULATIONTHREAD_H
@@ -0,0 +1,97 @@
+#include "snapshot.h"
+#include "raytracer.h"
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+
+// Parses "a,b,c" into out, returning false if it is not three numbers
+static bool parseVec3(const QString &s, glm::vec3 *out) {
+    QStringList parts = s.split(',');
+    if (parts.size() != 3) {
+        return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        bool ok;
+        (*out)[i] = parts[i].toFloat(&ok);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int runSnapshot(const QStringList &args) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders the world on the CPU and saves it as a PNG.");
+    parser.addHelpOption();
+    QCommandLineOption snapshotOption("snapshot", "Where to save the image.", "file");
+    QCommandLineOption sizeOption("size", "Image size (default 640x360).", "WxH", "640x360");
+    QCommandLineOption targetOption("target", "Point to look at (default the surface at 32,32).", "x,y,z");
+    QCommandLineOption cameraOption("camera", "Camera position (default above and behind the target).", "x,y,z");
+    QCommandLineOption fovOption("fov", "Vertical field of view in degrees (default 45).", "degrees", "45");
+    QCommandLineOption radiusOption("radius", "Terrain zones to generate around the target (default 1).", "zones", "1");
+    QCommandLineOption repeatOption("repeat", "Render this many times and report the average time.", "count", "1");
+    QCommandLineOption noShadowsOption("no-shadows", "Skip the shadow rays.");
+    parser.addOptions({snapshotOption, sizeOption, targetOption, cameraOption,
+                       fovOption, radiusOption, repeatOption, noShadowsOption});
+    parser.process(args);
+
+    QStringList size = parser.value(sizeOption).split('x');
+    int width = size.size() == 2 ? size[0].toInt() : 0;
+    int height = size.size() == 2 ? size[1].toInt() : 0;
+    if (width <= 0 || height <= 0) {
+        qCritical("--size must look like 640x360");
+        return 1;
+    }
+
+    glm::vec3 target(32.f, -1.f, 32.f);
+    if (parser.isSet(targetOption) && !parseVec3(parser.value(targetOption), &target)) {
+        qCritical("--target must look like x,y,z");
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    Terrain terrain(nullptr);
+    terrain.generateZonesNow(static_cast<int>(glm::floor(target.x)), static_cast<int>(glm::floor(target.z)),
+                             parser.value(radiusOption).toInt());
+    qInfo("Generated terrain in %lld ms", timer.elapsed());
+    if (!parser.isSet(targetOption)) {
+        target.y = terrain.getHeightAt(32, 32) + 1.f;
+    }
+
+    glm::vec3 position = target + glm::vec3(-24.f, 24.f, -24.f);
+    if (parser.isSet(cameraOption) && !parseVec3(parser.value(cameraOption), &position)) {
+        qCritical("--camera must look like x,y,z");
+        return 1;
+    }
+    if (position == target) {
+        qCritical("--camera and --target must differ");
+        return 1;
+    }
+    CameraPose camera;
+    camera.position = position;
+    camera.forward = glm::normalize(target - position);
+    glm::vec3 worldUp(0.f, 1.f, 0.f);
+    if (glm::abs(camera.forward.y) > 0.999f) {
+        worldUp = glm::vec3(0.f, 0.f, 1.f); // Looking straight up or down
+    }
+    camera.right = glm::normalize(glm::cross(camera.forward, worldUp));
+    camera.up = glm::cross(camera.right, camera.forward);
+
+    Raytracer raytracer(QImage(":/textures/minecraft_textures_all.png"));
+    raytracer.m_shadows = !parser.isSet(noShadowsOption);
+    int repeat = std::max(1, parser.value(repeatOption).toInt());
+    QImage image;
+    timer.restart();
+    for (int i = 0; i < repeat; i++) {
+        image = raytracer.render(terrain, camera, parser.value(fovOption).toFloat(), width, height);
+    }
+    qInfo("Rendered %dx%d in %.2f ms", width, height, timer.nsecsElapsed() / 1e6 / repeat);
+
+    QString file = parser.value(snapshotOption);
+    if (!image.save(file, "PNG")) {
+        qCritical("Could not write %s", qPrintable(file));
+        return 1;
+    }
+    return 0;
+}
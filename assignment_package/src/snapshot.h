@@ -0,0 +1,9 @@
+#pragma once
+#include <QStringList>
+
+// Renders one picture of the world with Raytracer and saves it as a
+// PNG, without opening a window or touching the GPU, so it runs on
+// machines with no display. args is the whole command line, including
+// --snapshot <file>; the other options are listed in snapshot.cpp.
+// Returns the process's exit code.
+int runSnapshot(const QStringList &args);
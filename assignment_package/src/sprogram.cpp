@@ -5,7 +5,7 @@
 
 SProgram::SProgram(OpenGLContext *context)
     : vertShader(), fragShader(), prog(), unifSampler2D(-1), unifTime(-1),
-      context(context)
+      m_builder(context), context(context)
 {}
 
 SProgram::~SProgram()
@@ -14,57 +14,20 @@ SProgram::~SProgram()
 void SProgram::create(const char *vertfile, const char *fragfile)
 {
     std::cout << "Setting up shader from " << vertfile << " and " << fragfile << std::endl;
-    // Allocate space on our GPU for a vertex shader and a fragment shader and a shader program to manage the two
-    vertShader = context->glCreateShader(GL_VERTEX_SHADER);
-    fragShader = context->glCreateShader(GL_FRAGMENT_SHADER);
     prog = context->glCreateProgram();
-    // Get the body of text stored in our two .glsl files
-    QString qVertSource = qTextFileRead(vertfile);
-    QString qFragSource = qTextFileRead(fragfile);
-
-    char* vertSource = new char[qVertSource.size()+1];
-    strcpy(vertSource, qVertSource.toStdString().c_str());
-    char* fragSource = new char[qFragSource.size()+1];
-    strcpy(fragSource, qFragSource.toStdString().c_str());
-
-    const char* vs = vertSource;
-    const char* fs = fragSource;
-
-    // Send the shader text to OpenGL and store it in the shaders specified by the handles vertShader and fragShader
-    context->glShaderSource(vertShader, 1, &vs, 0);
-    context->glShaderSource(fragShader, 1, &fs, 0);
-    // Tell OpenGL to compile the shader text stored above
-    context->glCompileShader(vertShader);
-    context->glCompileShader(fragShader);
-    // Check if everything compiled OK
-    GLint compiled;
-    context->glGetShaderiv(vertShader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        printShaderInfoLog(vertShader);
-    }
-    context->glGetShaderiv(fragShader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        printShaderInfoLog(fragShader);
-    }
-
-    // Tell prog that it manages these particular vertex and fragment shaders
-    context->glAttachShader(prog, vertShader);
-    context->glAttachShader(prog, fragShader);
-    context->glLinkProgram(prog);
-
-    // Check for linking success
-    GLint linked;
-    context->glGetProgramiv(prog, GL_LINK_STATUS, &linked);
-    if (!linked) {
-        printLinkInfoLog(prog);
-    }
-
-    setupMemberVars();
+    // Get the body of text stored in our two .glsl files, and hand it to
+    // the driver (or load last launch's binary). Nothing waits for the
+    // result until the program is first used.
+    m_builder.start(prog, qTextFileRead(vertfile).toUtf8(), qTextFileRead(fragfile).toUtf8());
 }
 
 void SProgram::useMe()
 {
-    context->glUseProgram(prog);
+    if (m_builder.pending()) {
+        m_builder.finish();
+        setupMemberVars();
+    }
+    context->glState().useProgram(prog);
 }
 
 void SProgram::setTime(int t)
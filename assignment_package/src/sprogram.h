@@ -7,6 +7,7 @@
 
 #include "drawable.h"
 #include "texture.h"
+#include "programbuilder.h"
 
 
 class SProgram
@@ -23,9 +24,11 @@ public:
 public:
     SProgram(OpenGLContext* context);
     virtual ~SProgram();
-    // Sets up the requisite GL data and shaders from the given .glsl files
+    // Sets up the requisite GL data and shaders from the given .glsl files.
+    // The driver may still be building them when this returns; the first
+    // useMe() waits for it.
     void create(const char *vertfile, const char *fragfile);
-    // Sets up shader-specific handles
+    // Sets up shader-specific handles, once the program is built
     virtual void setupMemberVars() = 0;
     // Tells our OpenGL context to use this shader to draw things
     void useMe();
@@ -41,6 +44,9 @@ public:
 
     void setTime(int t);
 
+private:
+    ProgramBuilder m_builder;
+
 protected:
     OpenGLContext* context;   // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                             // we need to pass our OpenGL context to the Drawable in order to call GL functions
@@ -9,6 +9,14 @@ SOURCES += \
     $$PWD/mygl.cpp \
     $$PWD/blocktypeworker.cpp \
     $$PWD/vboworker.cpp \
+    $$PWD/fluidworker.cpp \
+    $$PWD/blocktickworker.cpp \
+    $$PWD/navclusterworker.cpp \
+    $$PWD/pathworker.cpp \
+    $$PWD/simulationthread.cpp \
+    $$PWD/raytracer.cpp \
+    $$PWD/snapshot.cpp \
+    $$PWD/framecapture.cpp \
     $$PWD/ppshader.cpp \
     $$PWD/scene/quad.cpp \
     $$PWD/shaderprogram.cpp \
@@ -16,6 +24,7 @@ SOURCES += \
     $$PWD/cameracontrolshelp.cpp \
     $$PWD/scene/cube.cpp \
     $$PWD/openglcontext.cpp \
+    $$PWD/glstate.cpp \
     $$PWD/scene/terrain.cpp \
     $$PWD/scene/worldaxes.cpp \
     $$PWD/scene/entity.cpp \
@@ -24,7 +33,25 @@ SOURCES += \
     $$PWD/playerinfo.cpp \
     $$PWD/scene/chunk.cpp \
     $$PWD/sprogram.cpp \
-    $$PWD/texture.cpp
+    $$PWD/texture.cpp \
+    $$PWD/texturearray.cpp \
+    $$PWD/gputimer.cpp \
+    $$PWD/frameuniforms.cpp \
+    $$PWD/programbuilder.cpp \
+    $$PWD/rendertargetpool.cpp \
+    $$PWD/postprocessgraph.cpp \
+    $$PWD/renderdistancecontroller.cpp \
+    $$PWD/resolutionscalecontroller.cpp \
+    $$PWD/scene/zoneprefetcher.cpp \
+    $$PWD/scene/lightengine.cpp \
+    $$PWD/scene/fluidsimulator.cpp \
+    $$PWD/scene/blocktickscheduler.cpp \
+    $$PWD/scene/spatialhash.cpp \
+    $$PWD/scene/entitysystem.cpp \
+    $$PWD/scene/particlesystem.cpp \
+    $$PWD/scene/navgraph.cpp \
+    $$PWD/scene/collision.cpp \
+    $$PWD/scene/raycast.cpp
 
 HEADERS += \
     $$PWD/framebuffer.h \
@@ -34,6 +61,14 @@ HEADERS += \
     $$PWD/blocktypeworker.h \
     $$PWD/scene/chunkhelpers.h \
     $$PWD/vboworker.h \
+    $$PWD/fluidworker.h \
+    $$PWD/blocktickworker.h \
+    $$PWD/navclusterworker.h \
+    $$PWD/pathworker.h \
+    $$PWD/simulationthread.h \
+    $$PWD/raytracer.h \
+    $$PWD/snapshot.h \
+    $$PWD/framecapture.h \
     $$PWD/ppshader.h \
     $$PWD/scene/quad.h \
     $$PWD/shaderprogram.h \
@@ -41,6 +76,7 @@ HEADERS += \
     $$PWD/cameracontrolshelp.h \
     $$PWD/scene/cube.h \
     $$PWD/openglcontext.h \
+    $$PWD/glstate.h \
     $$PWD/scene/terrain.h \
     $$PWD/scene/worldaxes.h \
     $$PWD/smartpointerhelp.h \
@@ -51,4 +87,24 @@ HEADERS += \
     $$PWD/playerinfo.h \
     $$PWD/scene/chunk.h \
     $$PWD/sprogram.h \
-    $$PWD/texture.h
+    $$PWD/texture.h \
+    $$PWD/texturearray.h \
+    $$PWD/gputimer.h \
+    $$PWD/frameuniforms.h \
+    $$PWD/programbuilder.h \
+    $$PWD/rendertargetpool.h \
+    $$PWD/postprocessgraph.h \
+    $$PWD/renderdistancecontroller.h \
+    $$PWD/resolutionscalecontroller.h \
+    $$PWD/scene/zoneprefetcher.h \
+    $$PWD/scene/blockregistry.h \
+    $$PWD/scene/lightengine.h \
+    $$PWD/scene/fluidsimulator.h \
+    $$PWD/scene/blocktickscheduler.h \
+    $$PWD/scene/spatialhash.h \
+    $$PWD/scene/entitysystem.h \
+    $$PWD/scene/particlesystem.h \
+    $$PWD/scene/navgraph.h \
+    $$PWD/scene/collision.h \
+    $$PWD/scene/raycast.h \
+    $$PWD/parallelfor.h
@@ -0,0 +1,213 @@
+#include "texturearray.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+
+// Bump whenever the way levels are built or stored changes, so stale
+// caches are ignored
+static const quint32 CACHE_VERSION = 1;
+
+struct CacheHeader {
+    char magic[4];
+    quint32 version, tileSize, layers, levels;
+};
+
+TextureArray::TextureArray(OpenGLContext *context)
+    : context(context), m_textureHandle(0), m_tileSize(0), m_layers(0), m_levels()
+{}
+
+TextureArray::~TextureArray()
+{}
+
+int TextureArray::layerCount() const {
+    return m_layers;
+}
+
+// Levels in a full mip chain for tiles size texels across
+static int levelCount(int size) {
+    int levels = 1;
+    for (; size > 1; size /= 2) {
+        levels++;
+    }
+    return levels;
+}
+
+// Averages each 2x2 block of the level above, weighting colors by their
+// alpha so the transparent parts of a tile do not darken its edges
+static std::vector<unsigned char> downsample(const std::vector<unsigned char> &src, int size, int layers) {
+    int half = size / 2;
+    std::vector<unsigned char> dst(half * half * layers * 4);
+    for (int l = 0; l < layers; l++) {
+        const unsigned char *in = &src[l * size * size * 4];
+        unsigned char *out = &dst[l * half * half * 4];
+        for (int y = 0; y < half; y++) {
+            for (int x = 0; x < half; x++) {
+                float rgb[3] = {0.f, 0.f, 0.f}, plain[3] = {0.f, 0.f, 0.f};
+                float alpha = 0.f;
+                for (int i = 0; i < 4; i++) {
+                    const unsigned char *t = in + ((2 * y + i / 2) * size + 2 * x + i % 2) * 4;
+                    for (int c = 0; c < 3; c++) {
+                        rgb[c] += t[c] * t[3];
+                        plain[c] += t[c];
+                    }
+                    alpha += t[3];
+                }
+                unsigned char *t = out + (y * half + x) * 4;
+                for (int c = 0; c < 3; c++) {
+                    float v = alpha > 0.f ? rgb[c] / alpha : plain[c] / 4.f;
+                    t[c] = static_cast<unsigned char>(v + 0.5f);
+                }
+                t[3] = static_cast<unsigned char>(alpha / 4.f + 0.5f);
+            }
+        }
+    }
+    return dst;
+}
+
+void TextureArray::buildLevels(const QImage &atlas, int tilesPerSide) {
+    // Mirrored so row 0 is the bottom of the atlas, as in Texture
+    QImage img = atlas.convertToFormat(QImage::Format_RGBA8888).mirrored();
+    m_tileSize = img.width() / tilesPerSide;
+    m_layers = tilesPerSide * tilesPerSide;
+
+    std::vector<unsigned char> base(m_tileSize * m_tileSize * m_layers * 4);
+    for (int row = 0; row < tilesPerSide; row++) {
+        for (int col = 0; col < tilesPerSide; col++) {
+            unsigned char *layer = &base[(col + row * tilesPerSide) * m_tileSize * m_tileSize * 4];
+            for (int y = 0; y < m_tileSize; y++) {
+                const uchar *line = img.constScanLine(row * m_tileSize + y) + col * m_tileSize * 4;
+                std::memcpy(layer + y * m_tileSize * 4, line, m_tileSize * 4);
+            }
+        }
+    }
+    m_levels.clear();
+    m_levels.push_back(std::move(base));
+    for (int size = m_tileSize; size > 1; size /= 2) {
+        m_levels.push_back(downsample(m_levels.back(), size, m_layers));
+    }
+}
+
+bool TextureArray::readCache(const QString &file) {
+    QFile f(file);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QByteArray bytes = f.readAll();
+    CacheHeader header;
+    if (bytes.size() < static_cast<int>(sizeof(header))) {
+        return false;
+    }
+    std::memcpy(&header, bytes.constData(), sizeof(header));
+    if (std::memcmp(header.magic, "TXAR", 4) != 0 || header.version != CACHE_VERSION
+            || header.tileSize == 0 || header.layers == 0) {
+        return false;
+    }
+    if (static_cast<int>(header.levels) != levelCount(header.tileSize)) {
+        return false;
+    }
+    size_t expected = sizeof(header);
+    for (quint32 i = 0; i < header.levels; i++) {
+        size_t size = header.tileSize >> i;
+        expected += size * size * header.layers * 4;
+    }
+    if (size_t(bytes.size()) != expected) {
+        return false;
+    }
+
+    m_tileSize = header.tileSize;
+    m_layers = header.layers;
+    m_levels.clear();
+    const char *data = bytes.constData() + sizeof(header);
+    for (quint32 i = 0; i < header.levels; i++) {
+        int size = m_tileSize >> i;
+        m_levels.emplace_back(data, data + size * size * m_layers * 4);
+        data += size * size * m_layers * 4;
+    }
+    return true;
+}
+
+void TextureArray::writeCache(const QString &file) const {
+    QSaveFile f(file);
+    if (!f.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    CacheHeader header;
+    std::memcpy(header.magic, "TXAR", 4);
+    header.version = CACHE_VERSION;
+    header.tileSize = m_tileSize;
+    header.layers = m_layers;
+    header.levels = m_levels.size();
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const std::vector<unsigned char> &level : m_levels) {
+        f.write(reinterpret_cast<const char*>(level.data()), level.size());
+    }
+    // A cache that fails to save is simply rebuilt next time
+    f.commit();
+}
+
+void TextureArray::create(const char *atlasPath, int tilesPerSide)
+{
+    context->printGLErrorLog();
+
+    QFile source(atlasPath);
+    QByteArray sourceBytes;
+    if (source.open(QIODevice::ReadOnly)) {
+        sourceBytes = source.readAll();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(sourceBytes);
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QString cacheFile = QDir(cacheDir).filePath(QString("blocktextures-%1-%2.bin")
+                                                .arg(QString(hash.result().toHex()))
+                                                .arg(tilesPerSide));
+
+    if (cacheDir.isEmpty() || !readCache(cacheFile)) {
+        buildLevels(QImage(atlasPath), tilesPerSide);
+        if (!cacheDir.isEmpty() && QDir().mkpath(cacheDir)) {
+            writeCache(cacheFile);
+        }
+    }
+    context->glGenTextures(1, &m_textureHandle);
+
+    context->printGLErrorLog();
+}
+
+void TextureArray::load(int texSlot)
+{
+    context->printGLErrorLog();
+
+    context->glState().bindTexture(texSlot, GL_TEXTURE_2D_ARRAY, m_textureHandle);
+
+    // Blocks keep their crisp pixels up close but blend down through the
+    // mip chain with distance. Repeat wraps within a layer, never into
+    // the next tile.
+    context->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    context->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    context->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    context->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    context->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, m_levels.size() - 1);
+
+    for (size_t i = 0; i < m_levels.size(); i++) {
+        int size = m_tileSize >> i;
+        context->glTexImage3D(GL_TEXTURE_2D_ARRAY, i, GL_RGBA8, size, size, m_layers,
+                              0, GL_RGBA, GL_UNSIGNED_BYTE, m_levels[i].data());
+    }
+    // The GL keeps its own copy
+    std::vector<std::vector<unsigned char>>().swap(m_levels);
+    context->printGLErrorLog();
+}
+
+void TextureArray::bind(int texSlot)
+{
+    context->glState().bindTexture(texSlot, GL_TEXTURE_2D_ARRAY, m_textureHandle);
+}
+
+void TextureArray::destroy()
+{
+    context->glState().deleteTextures(1, &m_textureHandle);
+    m_textureHandle = 0;
+}
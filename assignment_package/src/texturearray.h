@@ -0,0 +1,43 @@
+#pragma once
+
+#include <openglcontext.h>
+#include <la.h>
+#include <vector>
+
+// The block texture atlas split into one GL_TEXTURE_2D_ARRAY layer per
+// tile, each with its own full mip chain, so distant faces are filtered
+// down without bleeding into their neighbours and a face's UVs can run
+// past 1 to repeat its tile. Tile (col, row) of the atlas, counted from
+// the bottom left as atlasUV does, becomes layer col + row * tilesPerSide.
+//
+// Cutting the atlas up and filtering it takes longer than the rest of
+// startup, so the finished levels are kept in the user's cache directory
+// keyed on a hash of the atlas file, and later runs just read them back.
+class TextureArray
+{
+public:
+    TextureArray(OpenGLContext* context);
+    ~TextureArray();
+
+    // Builds the layers and mip levels from the atlas at atlasPath, or
+    // reads them from the cache if this atlas was processed before
+    void create(const char *atlasPath, int tilesPerSide = 16);
+    // Uploads every level and frees the CPU copy
+    void load(int texSlot);
+    void bind(int texSlot);
+    void destroy();
+
+    int layerCount() const;
+
+private:
+    bool readCache(const QString &file);
+    void writeCache(const QString &file) const;
+    void buildLevels(const QImage &atlas, int tilesPerSide);
+
+    OpenGLContext* context;
+    GLuint m_textureHandle;
+    int m_tileSize, m_layers;
+    // RGBA8 texels of each mip level, level 0 first. Level i holds every
+    // layer in order, each (m_tileSize >> i) texels square.
+    std::vector<std::vector<unsigned char>> m_levels;
+};